@@ -0,0 +1,136 @@
+/* ======================================================================== */
+/* barrier_builder.cpp                                                      */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "barrier_builder.h"
+
+static VkImageAspectFlags _barrier_aspect_mask(RenderDevice::Texture2D *texture)
+{
+    // layout transitions of combined depth/stencil images cover both aspects.
+    if (is_stencil_format(texture->format))
+        return texture->aspect_mask | VK_IMAGE_ASPECT_STENCIL_BIT;
+    return texture->aspect_mask;
+}
+
+bool BarrierBuilder::is_write_access(VkAccessFlags2 access_mask)
+{
+    const VkAccessFlags2 write_access_mask = VK_ACCESS_2_SHADER_WRITE_BIT |
+                                             VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+                                             VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+                                             VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                             VK_ACCESS_2_TRANSFER_WRITE_BIT |
+                                             VK_ACCESS_2_HOST_WRITE_BIT |
+                                             VK_ACCESS_2_MEMORY_WRITE_BIT;
+    return (access_mask & write_access_mask) != 0;
+}
+
+void BarrierBuilder::image(RenderDevice::Texture2D *texture, VkImageLayout new_layout,
+                           VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+                           VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask)
+{
+    if (texture->image_layout == new_layout && !is_write_access(src_access_mask) && !is_write_access(dst_access_mask)) {
+        skipped_count++;
+        return;
+    }
+
+    image_range(texture, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS, texture->image_layout, new_layout,
+                src_stage_mask, src_access_mask, dst_stage_mask, dst_access_mask);
+    texture->image_layout = new_layout;
+}
+
+void BarrierBuilder::image_range(RenderDevice::Texture2D *texture, uint32_t base_level, uint32_t level_count, uint32_t base_layer, uint32_t layer_count,
+                                 VkImageLayout old_layout, VkImageLayout new_layout,
+                                 VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+                                 VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask)
+{
+    external_image(texture->image, { _barrier_aspect_mask(texture), base_level, level_count, base_layer, layer_count }, old_layout, new_layout,
+                   src_stage_mask, src_access_mask, dst_stage_mask, dst_access_mask);
+}
+
+void BarrierBuilder::external_image(VkImage image, VkImageSubresourceRange subresource_range,
+                                    VkImageLayout old_layout, VkImageLayout new_layout,
+                                    VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+                                    VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask)
+{
+    VkImageMemoryBarrier2 barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = src_stage_mask;
+    barrier.srcAccessMask = src_access_mask;
+    barrier.dstStageMask = dst_stage_mask;
+    barrier.dstAccessMask = dst_access_mask;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = subresource_range;
+    image_barriers.push_back(barrier);
+}
+
+void BarrierBuilder::buffer(RenderDevice::Buffer *buffer, VkDeviceSize offset, VkDeviceSize size,
+                            VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+                            VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask)
+{
+    VkBufferMemoryBarrier2 barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    barrier.srcStageMask = src_stage_mask;
+    barrier.srcAccessMask = src_access_mask;
+    barrier.dstStageMask = dst_stage_mask;
+    barrier.dstAccessMask = dst_access_mask;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer->vk_buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    buffer_barriers.push_back(barrier);
+}
+
+void BarrierBuilder::memory(VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+                            VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask)
+{
+    VkMemoryBarrier2 barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = src_stage_mask;
+    barrier.srcAccessMask = src_access_mask;
+    barrier.dstStageMask = dst_stage_mask;
+    barrier.dstAccessMask = dst_access_mask;
+    memory_barriers.push_back(barrier);
+}
+
+void BarrierBuilder::flush(VkCommandBuffer cmd_buffer)
+{
+    if (empty())
+        return;
+
+    VkDependencyInfo dependency_info = {};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.memoryBarrierCount = (uint32_t) memory_barriers.size();
+    dependency_info.pMemoryBarriers = memory_barriers.data();
+    dependency_info.bufferMemoryBarrierCount = (uint32_t) buffer_barriers.size();
+    dependency_info.pBufferMemoryBarriers = buffer_barriers.data();
+    dependency_info.imageMemoryBarrierCount = (uint32_t) image_barriers.size();
+    dependency_info.pImageMemoryBarriers = image_barriers.data();
+    vkCmdPipelineBarrier2(cmd_buffer, &dependency_info);
+
+    memory_barriers.clear();
+    buffer_barriers.clear();
+    image_barriers.clear();
+}
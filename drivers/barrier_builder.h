@@ -0,0 +1,68 @@
+/* ======================================================================== */
+/* barrier_builder.h                                                        */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _BARRIER_BUILDER_H_
+#define _BARRIER_BUILDER_H_
+
+#include "render_device.h"
+#include <vector>
+
+// collects buffer and image barriers with exact stage and access masks and records
+// them with a single vkCmdPipelineBarrier2 on flush. whole image transitions go
+// through the layout tracked in Texture2D::image_layout and are dropped when the
+// texture already is in the requested layout and neither side writes.
+class BarrierBuilder {
+public:
+    void image(RenderDevice::Texture2D *texture, VkImageLayout new_layout,
+               VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+               VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask);
+    // sub-range transition from an explicit layout, e.g. while mip levels are
+    // generated. the tracked layout is left to the caller.
+    void image_range(RenderDevice::Texture2D *texture, uint32_t base_level, uint32_t level_count, uint32_t base_layer, uint32_t layer_count,
+                     VkImageLayout old_layout, VkImageLayout new_layout,
+                     VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+                     VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask);
+    // images the device does not own, e.g. swap chain images, nothing is tracked.
+    void external_image(VkImage image, VkImageSubresourceRange subresource_range,
+                        VkImageLayout old_layout, VkImageLayout new_layout,
+                        VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+                        VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask);
+    void buffer(RenderDevice::Buffer *buffer, VkDeviceSize offset, VkDeviceSize size,
+                VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+                VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask);
+    void memory(VkPipelineStageFlags2 src_stage_mask, VkAccessFlags2 src_access_mask,
+                VkPipelineStageFlags2 dst_stage_mask, VkAccessFlags2 dst_access_mask);
+
+    bool empty() { return image_barriers.empty() && buffer_barriers.empty() && memory_barriers.empty(); }
+    uint32_t get_skipped_count() { return skipped_count; }
+    void flush(VkCommandBuffer cmd_buffer);
+
+    static bool is_write_access(VkAccessFlags2 access_mask);
+
+private:
+    std::vector<VkImageMemoryBarrier2> image_barriers;
+    std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+    std::vector<VkMemoryBarrier2> memory_barriers;
+    uint32_t skipped_count = 0;
+};
+
+#endif /* _BARRIER_BUILDER_H_ */
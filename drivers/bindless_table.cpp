@@ -0,0 +1,228 @@
+/* ======================================================================== */
+/* bindless_table.cpp                                                       */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "bindless_table.h"
+#include <algorithm>
+
+BindlessTable::BindlessTable(RenderDeviceContext *p_rdc)
+    : device(p_rdc->get_device())
+{
+    VkResult U_ASSERT_ONLY err;
+
+    VkPhysicalDeviceVulkan12Properties vulkan12_properties = {};
+    vulkan12_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &vulkan12_properties;
+    vkGetPhysicalDeviceProperties2(p_rdc->get_physical_device(), &properties);
+
+    // both arrays are visible to every stage and count against the per stage limits.
+    textures.capacity = std::min({ (uint32_t) BINDLESS_MAX_TEXTURES,
+                                   vulkan12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                   vulkan12_properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                   vulkan12_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                   vulkan12_properties.maxDescriptorSetUpdateAfterBindSamplers });
+    buffers.capacity = std::min({ (uint32_t) BINDLESS_MAX_BUFFERS,
+                                  vulkan12_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                                  vulkan12_properties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+
+    VkDescriptorPoolSize pool_size[] = {
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textures.capacity },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers.capacity },
+    };
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            /* pNext */ nextptr,
+            /* flags */ VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+            /* maxSets */ 1,
+            /* poolSizeCount */ ARRAY_SIZE(pool_size),
+            /* pPoolSizes */ pool_size,
+    };
+
+    err = vkCreateDescriptorPool(device, &descriptor_pool_create_info, allocation_callbacks, &descriptor_pool);
+    assert(!err);
+
+    VkDescriptorSetLayoutBinding bindings[] = {
+            { BINDING_TEXTURES, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textures.capacity, VK_SHADER_STAGE_ALL, nullptr },
+            { BINDING_BUFFERS, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers.capacity, VK_SHADER_STAGE_ALL, nullptr },
+    };
+
+    VkDescriptorBindingFlags binding_flags[] = {
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            /* pNext */ nextptr,
+            /* bindingCount */ ARRAY_SIZE(binding_flags),
+            /* pBindingFlags */ binding_flags,
+    };
+
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            /* pNext */ &binding_flags_create_info,
+            /* flags */ VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+            /* bindingCount */ ARRAY_SIZE(bindings),
+            /* pBindings */ bindings,
+    };
+
+    err = vkCreateDescriptorSetLayout(device, &descriptor_set_layout_create_info, allocation_callbacks, &descriptor_set_layout);
+    assert(!err);
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+            /* sType */ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            /* pNext */ nextptr,
+            /* descriptorPool */ descriptor_pool,
+            /* descriptorSetCount */ 1,
+            /* pSetLayouts */ &descriptor_set_layout,
+    };
+
+    err = vkAllocateDescriptorSets(device, &descriptor_set_allocate_info, &descriptor_set);
+    assert(!err);
+}
+
+BindlessTable::~BindlessTable()
+{
+    vkDestroyDescriptorSetLayout(device, descriptor_set_layout, allocation_callbacks);
+    vkDestroyDescriptorPool(device, descriptor_pool, allocation_callbacks);
+}
+
+uint32_t BindlessTable::add_texture(VkSampler sampler, VkImageView image_view, VkImageLayout image_layout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    uint32_t index = _acquire(&textures);
+    if (index != BINDLESS_INVALID_INDEX)
+        _write_texture(index, sampler, image_view, image_layout);
+
+    return index;
+}
+
+void BindlessTable::update_texture(uint32_t index, VkSampler sampler, VkImageView image_view, VkImageLayout image_layout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    _write_texture(index, sampler, image_view, image_layout);
+}
+
+void BindlessTable::remove_texture(uint32_t index)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    _release(&textures, index);
+}
+
+uint32_t BindlessTable::add_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    uint32_t index = _acquire(&buffers);
+    if (index != BINDLESS_INVALID_INDEX)
+        _write_buffer(index, buffer, offset, range);
+
+    return index;
+}
+
+void BindlessTable::update_buffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    _write_buffer(index, buffer, offset, range);
+}
+
+void BindlessTable::remove_buffer(uint32_t index)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    _release(&buffers, index);
+}
+
+void BindlessTable::_write_texture(uint32_t index, VkSampler sampler, VkImageView image_view, VkImageLayout image_layout)
+{
+    VkDescriptorImageInfo image_info = {
+            /* sampler */ sampler,
+            /* imageView */ image_view,
+            /* imageLayout */ image_layout,
+    };
+
+    VkWriteDescriptorSet write = {
+            /* sType */ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            /* pNext */ nextptr,
+            /* dstSet */ descriptor_set,
+            /* dstBinding */ BINDING_TEXTURES,
+            /* dstArrayElement */ index,
+            /* descriptorCount */ 1,
+            /* descriptorType */ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            /* pImageInfo */ &image_info,
+            /* pBufferInfo */ VK_NULL_HANDLE,
+            /* pTexelBufferView */ VK_NULL_HANDLE,
+    };
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, VK_NULL_HANDLE);
+}
+
+void BindlessTable::_write_buffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    VkDescriptorBufferInfo buffer_info = {
+            /* buffer */ buffer,
+            /* offset */ offset,
+            /* range */ range,
+    };
+
+    VkWriteDescriptorSet write = {
+            /* sType */ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            /* pNext */ nextptr,
+            /* dstSet */ descriptor_set,
+            /* dstBinding */ BINDING_BUFFERS,
+            /* dstArrayElement */ index,
+            /* descriptorCount */ 1,
+            /* descriptorType */ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            /* pImageInfo */ VK_NULL_HANDLE,
+            /* pBufferInfo */ &buffer_info,
+            /* pTexelBufferView */ VK_NULL_HANDLE,
+    };
+
+    vkUpdateDescriptorSets(device, 1, &write, 0, VK_NULL_HANDLE);
+}
+
+uint32_t BindlessTable::_acquire(_Slots *slots)
+{
+    uint32_t index;
+    if (!slots->free.empty()) {
+        index = slots->free.back();
+        slots->free.pop_back();
+    } else if (slots->next < slots->capacity) {
+        index = slots->next++;
+    } else {
+        return BINDLESS_INVALID_INDEX;
+    }
+
+    slots->count++;
+    return index;
+}
+
+void BindlessTable::_release(_Slots *slots, uint32_t index)
+{
+    // the stale descriptor stays in the slot, partially bound arrays allow it
+    // as long as no shader reads it before the slot is written again.
+    slots->free.push_back(index);
+    slots->count--;
+}
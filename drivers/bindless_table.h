@@ -0,0 +1,88 @@
+/* ======================================================================== */
+/* bindless_table.h                                                         */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _BINDLESS_TABLE_H_
+#define _BINDLESS_TABLE_H_
+
+#include "render_device_context.h"
+#include <mutex>
+#include <vector>
+
+// slots of the table, clamped to the update after bind limits of the device.
+#define BINDLESS_MAX_TEXTURES 4096
+#define BINDLESS_MAX_BUFFERS 1024
+#define BINDLESS_INVALID_INDEX UINT32_MAX
+
+/*
+ * one descriptor set holding every sampled texture and storage buffer in runtime
+ * sized arrays, shaders address the resources by index instead of binding a set
+ * per draw. the arrays are partially bound and update after bind, a slot may be
+ * written while the set is bound as long as no pending draw reads it. whoever
+ * removes a slot has to wait until the frames using it have retired.
+ */
+class BindlessTable {
+public:
+    U_MEMNEW_ONLY BindlessTable(RenderDeviceContext *p_rdc);
+   ~BindlessTable();
+
+    enum Binding {
+        BINDING_TEXTURES = 0,
+        BINDING_BUFFERS = 1,
+    };
+
+    uint32_t add_texture(VkSampler sampler, VkImageView image_view, VkImageLayout image_layout);
+    // rewrites a slot in place, e.g. after the resource behind it has moved.
+    void update_texture(uint32_t index, VkSampler sampler, VkImageView image_view, VkImageLayout image_layout);
+    void remove_texture(uint32_t index);
+    uint32_t add_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    void update_buffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    void remove_buffer(uint32_t index);
+
+    VkDescriptorSetLayout get_descriptor_set_layout() { return descriptor_set_layout; }
+    VkDescriptorSet get_descriptor_set() { return descriptor_set; }
+    uint32_t get_texture_count() { return textures.count; }
+    uint32_t get_buffer_count() { return buffers.count; }
+
+private:
+    // indices below next have been handed out, released ones are reused first.
+    struct _Slots {
+        uint32_t capacity;
+        uint32_t next = 0;
+        uint32_t count = 0;
+        std::vector<uint32_t> free;
+    };
+
+    void _write_texture(uint32_t index, VkSampler sampler, VkImageView image_view, VkImageLayout image_layout);
+    void _write_buffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    static uint32_t _acquire(_Slots *slots);
+    static void _release(_Slots *slots, uint32_t index);
+
+    VkDevice device;
+    std::mutex mutex;
+    _Slots textures;
+    _Slots buffers;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorSet descriptor_set;
+};
+
+#endif /* _BINDLESS_TABLE_H_ */
@@ -0,0 +1,263 @@
+/* ======================================================================== */
+/* descriptor_allocator.cpp                                                 */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "descriptor_allocator.h"
+
+// descriptors per set of a pool, covers the uniform buffer and sampler heavy sets we have.
+static const struct {
+    VkDescriptorType type;
+    float ratio;
+} _descriptor_ratios[] = {
+        { VK_DESCRIPTOR_TYPE_SAMPLER,                0.5f },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          4.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1.0f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   0.5f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   0.5f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         2.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         2.0f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+        { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       0.5f },
+};
+
+DescriptorAllocator::DescriptorAllocator(VkDevice v_device, uint32_t v_frame_count)
+    : device(v_device), frames(v_frame_count)
+{
+    /* do nothing... */
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    for (const auto &pool: pools)
+        vkDestroyDescriptorPool(device, pool.descriptor_pool, allocation_callbacks);
+
+    for (const auto &frame: frames) {
+        for (const auto &pool: frame.pools)
+            vkDestroyDescriptorPool(device, pool.descriptor_pool, allocation_callbacks);
+    }
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // the newest pool has the most room left, older ones only regain it by frees.
+    VkDescriptorSet descriptor_set;
+    for (auto it = pools.rbegin(); it != pools.rend(); it++) {
+        if (_try_allocate(it->descriptor_pool, layout, &descriptor_set)) {
+            owners[descriptor_set] = it->descriptor_pool;
+            return descriptor_set;
+        }
+    }
+
+    uint32_t max_sets = pools.empty() ? DESCRIPTOR_POOL_INITIAL_SETS : std::min(pools.back().max_sets * 2, (uint32_t) DESCRIPTOR_POOL_MAX_SETS);
+    pools.push_back(_create_pool(max_sets, true));
+
+    bool U_ASSERT_ONLY allocated = _try_allocate(pools.back().descriptor_pool, layout, &descriptor_set);
+    assert(allocated);
+    owners[descriptor_set] = pools.back().descriptor_pool;
+
+    return descriptor_set;
+}
+
+void DescriptorAllocator::free(VkDescriptorSet descriptor_set)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto it = owners.find(descriptor_set);
+    assert(it != owners.end());
+
+    vkFreeDescriptorSets(device, it->second, 1, &descriptor_set);
+    owners.erase(it);
+}
+
+VkDescriptorSet DescriptorAllocator::get_frame_descriptor_set(uint32_t frame, VkDescriptorSetLayout layout, uint32_t binding_count, const Binding *p_bindings)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    _Frame *p_frame = &frames[frame];
+
+    uint64_t hash = _hash(layout, binding_count, p_bindings);
+    std::vector<_CachedSet> &bucket = p_frame->cache[hash];
+    for (const auto &cached: bucket) {
+        if (_is_same(cached, layout, binding_count, p_bindings))
+            return cached.descriptor_set;
+    }
+
+    VkDescriptorSet descriptor_set = _allocate_frame(p_frame, layout);
+    _write(descriptor_set, binding_count, p_bindings);
+    bucket.push_back({ layout, std::vector<Binding>(p_bindings, p_bindings + binding_count), descriptor_set });
+
+    return descriptor_set;
+}
+
+void DescriptorAllocator::reset_frame(uint32_t frame)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    _Frame *p_frame = &frames[frame];
+
+    for (uint32_t i = 0; i <= p_frame->current && i < p_frame->pools.size(); i++)
+        vkResetDescriptorPool(device, p_frame->pools[i].descriptor_pool, no_flag_bits);
+
+    p_frame->current = 0;
+    p_frame->cache.clear();
+}
+
+uint32_t DescriptorAllocator::get_pool_count()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    size_t count = pools.size();
+    for (const auto &frame: frames)
+        count += frame.pools.size();
+
+    return (uint32_t) count;
+}
+
+DescriptorAllocator::_Pool DescriptorAllocator::_create_pool(uint32_t max_sets, bool free_descriptor_set)
+{
+    VkResult U_ASSERT_ONLY err;
+
+    VkDescriptorPoolSize pool_sizes[ARRAY_SIZE(_descriptor_ratios)];
+    for (uint32_t i = 0; i < ARRAY_SIZE(_descriptor_ratios); i++) {
+        pool_sizes[i].type = _descriptor_ratios[i].type;
+        pool_sizes[i].descriptorCount = std::max(1u, (uint32_t) (_descriptor_ratios[i].ratio * (float) max_sets));
+    }
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            /* pNext */ nextptr,
+            /* flags */ free_descriptor_set ? (VkDescriptorPoolCreateFlags) VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : (VkDescriptorPoolCreateFlags) no_flag_bits,
+            /* maxSets */ max_sets,
+            /* poolSizeCount */ ARRAY_SIZE(pool_sizes),
+            /* pPoolSizes */ pool_sizes,
+    };
+
+    _Pool pool;
+    pool.max_sets = max_sets;
+    err = vkCreateDescriptorPool(device, &descriptor_pool_create_info, allocation_callbacks, &pool.descriptor_pool);
+    assert(!err);
+
+    return pool;
+}
+
+bool DescriptorAllocator::_try_allocate(VkDescriptorPool descriptor_pool, VkDescriptorSetLayout layout, VkDescriptorSet *p_descriptor_set)
+{
+    VkDescriptorSetAllocateInfo descriptor_allocate_info = {
+            /* sType */ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            /* pNext */ nextptr,
+            /* descriptorPool */ descriptor_pool,
+            /* descriptorSetCount */ 1,
+            /* pSetLayouts */ &layout,
+    };
+
+    // out of pool memory and fragmentation both mean: try the next pool.
+    return vkAllocateDescriptorSets(device, &descriptor_allocate_info, p_descriptor_set) == VK_SUCCESS;
+}
+
+VkDescriptorSet DescriptorAllocator::_allocate_frame(_Frame *frame, VkDescriptorSetLayout layout)
+{
+    VkDescriptorSet descriptor_set;
+
+    while (frame->current < frame->pools.size()) {
+        if (_try_allocate(frame->pools[frame->current].descriptor_pool, layout, &descriptor_set))
+            return descriptor_set;
+        frame->current++;
+    }
+
+    uint32_t max_sets = frame->pools.empty() ? DESCRIPTOR_POOL_INITIAL_SETS : std::min(frame->pools.back().max_sets * 2, (uint32_t) DESCRIPTOR_POOL_MAX_SETS);
+    frame->pools.push_back(_create_pool(max_sets, false));
+
+    bool U_ASSERT_ONLY allocated = _try_allocate(frame->pools.back().descriptor_pool, layout, &descriptor_set);
+    assert(allocated);
+
+    return descriptor_set;
+}
+
+void DescriptorAllocator::_write(VkDescriptorSet descriptor_set, uint32_t binding_count, const Binding *p_bindings)
+{
+    std::vector<VkDescriptorBufferInfo> buffer_infos(binding_count);
+    std::vector<VkDescriptorImageInfo> image_infos(binding_count);
+    std::vector<VkWriteDescriptorSet> writes(binding_count);
+
+    for (uint32_t i = 0; i < binding_count; i++) {
+        const Binding &binding = p_bindings[i];
+        buffer_infos[i] = { binding.buffer, binding.offset, binding.range };
+        image_infos[i] = { binding.sampler, binding.image_view, binding.image_layout };
+
+        bool is_buffer = binding.buffer != VK_NULL_HANDLE;
+        writes[i] = {
+                /* sType */ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                /* pNext */ nextptr,
+                /* dstSet */ descriptor_set,
+                /* dstBinding */ binding.binding,
+                /* dstArrayElement */ 0,
+                /* descriptorCount */ 1,
+                /* descriptorType */ binding.type,
+                /* pImageInfo */ is_buffer ? VK_NULL_HANDLE : &image_infos[i],
+                /* pBufferInfo */ is_buffer ? &buffer_infos[i] : VK_NULL_HANDLE,
+                /* pTexelBufferView */ VK_NULL_HANDLE,
+        };
+    }
+
+    vkUpdateDescriptorSets(device, binding_count, std::data(writes), 0, nullptr);
+}
+
+static V_FORCEINLINE uint64_t _hash_combine(uint64_t hash, uint64_t value)
+{
+    // fnv-1a over the 64 bit words.
+    return (hash ^ value) * 0x100000001b3ull;
+}
+
+uint64_t DescriptorAllocator::_hash(VkDescriptorSetLayout layout, uint32_t binding_count, const Binding *p_bindings)
+{
+    uint64_t hash = _hash_combine(0xcbf29ce484222325ull, (uint64_t) layout);
+
+    for (uint32_t i = 0; i < binding_count; i++) {
+        const Binding &binding = p_bindings[i];
+        hash = _hash_combine(hash, ((uint64_t) binding.binding << 32) | (uint64_t) binding.type);
+        hash = _hash_combine(hash, (uint64_t) binding.buffer);
+        hash = _hash_combine(hash, binding.offset);
+        hash = _hash_combine(hash, binding.range);
+        hash = _hash_combine(hash, (uint64_t) binding.sampler);
+        hash = _hash_combine(hash, (uint64_t) binding.image_view);
+        hash = _hash_combine(hash, (uint64_t) binding.image_layout);
+    }
+
+    return hash;
+}
+
+bool DescriptorAllocator::_is_same(const _CachedSet &cached, VkDescriptorSetLayout layout, uint32_t binding_count, const Binding *p_bindings)
+{
+    if (cached.layout != layout || cached.bindings.size() != binding_count)
+        return false;
+
+    for (uint32_t i = 0; i < binding_count; i++) {
+        const Binding &a = cached.bindings[i];
+        const Binding &b = p_bindings[i];
+        if (a.binding != b.binding || a.type != b.type || a.buffer != b.buffer || a.offset != b.offset || a.range != b.range ||
+            a.sampler != b.sampler || a.image_view != b.image_view || a.image_layout != b.image_layout)
+            return false;
+    }
+
+    return true;
+}
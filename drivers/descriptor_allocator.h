@@ -0,0 +1,100 @@
+/* ======================================================================== */
+/* descriptor_allocator.h                                                   */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _DESCRIPTOR_ALLOCATOR_H_
+#define _DESCRIPTOR_ALLOCATOR_H_
+
+#include "render_device_context.h"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// sets of the first pool, every further pool doubles up to the maximum.
+#define DESCRIPTOR_POOL_INITIAL_SETS 64
+#define DESCRIPTOR_POOL_MAX_SETS 4096
+
+/*
+ * descriptor sets from chunks of pools that grow on demand instead of one fixed
+ * pool. persistent sets are freed one by one, frame sets are allocated linearly
+ * from pools that are reset together once their frame has retired. frame sets
+ * written with the same content are handed out once per frame.
+ */
+class DescriptorAllocator {
+public:
+    U_MEMNEW_ONLY DescriptorAllocator(VkDevice v_device, uint32_t v_frame_count);
+   ~DescriptorAllocator();
+
+    // one descriptor of a frame set, either a buffer or an image.
+    struct Binding {
+        uint32_t binding;
+        VkDescriptorType type;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize range = VK_WHOLE_SIZE;
+        VkSampler sampler = VK_NULL_HANDLE;
+        VkImageView image_view = VK_NULL_HANDLE;
+        VkImageLayout image_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+    void free(VkDescriptorSet descriptor_set);
+
+    // written frame set, valid until the frame retires.
+    VkDescriptorSet get_frame_descriptor_set(uint32_t frame, VkDescriptorSetLayout layout, uint32_t binding_count, const Binding *p_bindings);
+    void reset_frame(uint32_t frame);
+
+    uint32_t get_pool_count();
+
+private:
+    struct _Pool {
+        VkDescriptorPool descriptor_pool;
+        uint32_t max_sets;
+    };
+
+    struct _CachedSet {
+        VkDescriptorSetLayout layout;
+        std::vector<Binding> bindings;
+        VkDescriptorSet descriptor_set;
+    };
+
+    struct _Frame {
+        std::vector<_Pool> pools;
+        uint32_t current = 0; /* pool allocated from, the ones before are full */
+        std::unordered_map<uint64_t, std::vector<_CachedSet>> cache;
+    };
+
+    _Pool _create_pool(uint32_t max_sets, bool free_descriptor_set);
+    bool _try_allocate(VkDescriptorPool descriptor_pool, VkDescriptorSetLayout layout, VkDescriptorSet *p_descriptor_set);
+    VkDescriptorSet _allocate_frame(_Frame *frame, VkDescriptorSetLayout layout);
+    void _write(VkDescriptorSet descriptor_set, uint32_t binding_count, const Binding *p_bindings);
+
+    static uint64_t _hash(VkDescriptorSetLayout layout, uint32_t binding_count, const Binding *p_bindings);
+    static bool _is_same(const _CachedSet &cached, VkDescriptorSetLayout layout, uint32_t binding_count, const Binding *p_bindings);
+
+    VkDevice device;
+    std::mutex mutex;
+    std::vector<_Pool> pools;
+    std::unordered_map<VkDescriptorSet, VkDescriptorPool> owners;
+    std::vector<_Frame> frames;
+};
+
+#endif /* _DESCRIPTOR_ALLOCATOR_H_ */
@@ -21,6 +21,10 @@
 /*                                                                          */
 /* ======================================================================== */
 #include "render_device.h"
+#include "barrier_builder.h"
+#include <chrono>
+
+thread_local RenderDevice::_CmdState RenderDevice::cmd_state;
 
 RenderDevice::RenderDevice(RenderDeviceContext *driver_context)
     : vk_rdc(driver_context)
@@ -28,44 +32,247 @@ RenderDevice::RenderDevice(RenderDeviceContext *driver_context)
     vk_device = vk_rdc->get_device();
     allocator = vk_rdc->get_allocator();
 
-    _initialize_descriptor_pool();
+    _initialize_descriptor_pools();
 
     msaa_sample_counts = vk_rdc->get_max_msaa_sample_counts();
 
     // if sample counts > 4x，that default msaa samples set 4x otherwise 2x
     msaa_sample_counts = msaa_sample_counts >= 4 ? VK_SAMPLE_COUNT_4_BIT : VK_SAMPLE_COUNT_2_BIT;
+
+    const VkPhysicalDeviceMemoryProperties *memory_properties;
+    vmaGetMemoryProperties(allocator, &memory_properties);
+    for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++) {
+        if (memory_properties->memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+            lazily_allocated_memory = true;
+    }
+
+    for (auto &slot: frame_slots)
+        slot.frame = UINT64_MAX;
+
+    queue_families[0] = vk_rdc->get_graph_queue_family();
+    queue_families[1] = vk_rdc->get_compute_queue_family();
+
+    VkCommandPoolCreateInfo compute_cmd_pool_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            /* pNext */ nextptr,
+            /* flags */ VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            /* queueFamilyIndex */ vk_rdc->get_compute_queue_family()
+    };
+
+    for (auto &frame: compute_frames) {
+        VkResult U_ASSERT_ONLY err = vkCreateCommandPool(vk_device, &compute_cmd_pool_create_info, allocation_callbacks, &frame.cmd_pool);
+        assert(!err);
+        frame.used = 0;
+    }
 }
 
 RenderDevice::~RenderDevice()
 {
-    vkDestroyDescriptorPool(vk_device, descriptor_pool, allocation_callbacks);
+    for (const auto &upload: texture_uploads)
+        destroy_buffer(upload.staging_buffer);
+
+    for (const auto &upload: buffer_uploads)
+        destroy_buffer(upload.staging_buffer);
+
+    wait_idle();
+
+    if (defragmentation_context != VK_NULL_HANDLE)
+        vmaEndDefragmentation(allocator, defragmentation_context, NULL);
+
+    for (auto &[thread, pools]: thread_cmd_pools) {
+        for (auto &frame: pools->frames)
+            vkDestroyCommandPool(vk_device, frame.cmd_pool, allocation_callbacks);
+        memdel(pools);
+    }
+
+    for (auto &frame: compute_frames)
+        vkDestroyCommandPool(vk_device, frame.cmd_pool, allocation_callbacks);
+
+    for (auto &[sampler, cached]: sampler_cache) {
+        vkDestroySampler(vk_device, sampler, allocation_callbacks);
+        memdel(cached);
+    }
+
+    memdel(bindless_table);
+    memdel(descriptor_allocator);
+    vkDestroyDescriptorSetLayout(vk_device, texture_descriptor_set_layout, allocation_callbacks);
+    vkDestroyDescriptorPool(vk_device, external_descriptor_pool, allocation_callbacks);
+}
+
+void RenderDevice::begin_frame()
+{
+    _retire_frames(false);
+    _reset_frame_cmd_pools();
+    descriptor_allocator->reset_frame(frame_index % RENDER_DEVICE_FRAMES_IN_FLIGHT);
+    _defragment();
+
+    std::unique_lock<std::mutex> lock(cmd_state_mutex);
+    skipped_cmd_stats = frame_skipped_cmd_stats;
+    frame_skipped_cmd_stats = {};
+}
+
+void RenderDevice::end_frame()
+{
+    flush_submissions();
+
+    // the frame has completed once every queue has reached what was submitted so far.
+    _FrameSlot *slot = &frame_slots[frame_index % RENDER_DEVICE_FRAMES_IN_FLIGHT];
+    for (uint32_t i = 0; i < RenderDeviceContext::QUEUE_TYPE_MAX; i++)
+        slot->timeline_values[i] = vk_rdc->get_submitted_timeline_value((RenderDeviceContext::QueueType) i);
+
+    slot->frame = frame_index;
+    frame_index++;
+}
+
+void RenderDevice::wait_idle()
+{
+    vkDeviceWaitIdle(vk_device);
+    _retire_frames(true);
+
+    // deletions queued after the last end_frame have no fence, the device is idle anyway.
+    std::unique_lock<std::mutex> lock(deletion_mutex);
+    while (!deletion_queue.empty()) {
+        deletion_queue.front().deletion();
+        deletion_queue.pop_front();
+    }
+}
+
+void RenderDevice::defer_deletion(std::function<void()> v_deletion)
+{
+    std::unique_lock<std::mutex> lock(deletion_mutex);
+    deletion_queue.push_back({ frame_index, std::move(v_deletion) });
+}
+
+// the slot of the frame about to be recorded is waited for, the others are polled.
+void RenderDevice::_retire_frames(bool wait_all)
+{
+    for (uint32_t i = 0; i < RENDER_DEVICE_FRAMES_IN_FLIGHT; i++) {
+        _FrameSlot *slot = &frame_slots[i];
+        if (slot->frame == UINT64_MAX)
+            continue;
+
+        bool wait = wait_all || i == frame_index % RENDER_DEVICE_FRAMES_IN_FLIGHT;
+        bool completed = true;
+        for (uint32_t type = 0; type < RenderDeviceContext::QUEUE_TYPE_MAX; type++) {
+            RenderDeviceContext::QueueType queue_type = (RenderDeviceContext::QueueType) type;
+            if (wait)
+                vk_rdc->wait_timeline_value(queue_type, slot->timeline_values[type]);
+            else if (vk_rdc->get_completed_timeline_value(queue_type) < slot->timeline_values[type])
+                completed = false;
+        }
+
+        if (!completed)
+            continue;
+
+        retired_frame_count = std::max(retired_frame_count, slot->frame + 1);
+        slot->frame = UINT64_MAX;
+    }
+
+    // frames retire in order, so the queue is sorted by frame.
+    std::vector<std::function<void()>> deletions;
+
+    {
+        std::unique_lock<std::mutex> lock(deletion_mutex);
+        while (!deletion_queue.empty() && deletion_queue.front().frame < retired_frame_count) {
+            deletions.push_back(std::move(deletion_queue.front().deletion));
+            deletion_queue.pop_front();
+        }
+    }
+
+    for (const auto &deletion: deletions)
+        deletion();
+}
+
+bool RenderDevice::is_format_sampled_filterable(VkFormat format)
+{
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(vk_rdc->get_physical_device(), format, &properties);
+
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & features) == features;
+}
+
+bool RenderDevice::is_format_blit_filterable(VkFormat format)
+{
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(vk_rdc->get_physical_device(), format, &properties);
+
+    VkFormatFeatureFlags features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & features) == features;
 }
 
 RenderDevice::Buffer *RenderDevice::create_buffer(VkBufferUsageFlags usage, VkDeviceSize size)
+{
+    return _create_buffer(usage, size, VMA_MEMORY_USAGE_CPU_TO_GPU, false);
+}
+
+RenderDevice::Buffer *RenderDevice::create_storage_buffer(VkBufferUsageFlags usage, VkDeviceSize size)
+{
+    return _create_buffer(usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, size, VMA_MEMORY_USAGE_GPU_ONLY, is_async_compute_supported());
+}
+
+RenderDevice::Buffer *RenderDevice::create_device_buffer(VkBufferUsageFlags usage, VkDeviceSize size)
+{
+    // the source usage lets defragmentation copy it to a new place.
+    return _create_buffer(usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, size, VMA_MEMORY_USAGE_GPU_ONLY, false);
+}
+
+RenderDevice::Buffer *RenderDevice::_create_buffer(VkBufferUsageFlags usage, VkDeviceSize size, VmaMemoryUsage memory_usage, bool concurrent)
 {
     VkResult U_ASSERT_ONLY err;
 
+    EXIT_FAIL_COND_V(size > 0, "-engine error: create of a buffer with size 0!\n");
+
     VkBufferCreateInfo buffer_create_info = {};
     buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     buffer_create_info.usage = usage;
     buffer_create_info.size = size;
 
+    if (concurrent) {
+        buffer_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_create_info.queueFamilyIndexCount = ARRAY_SIZE(queue_families);
+        buffer_create_info.pQueueFamilyIndices = queue_families;
+    }
+
     VmaAllocationCreateInfo allocation_create_info = {};
-    allocation_create_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocation_create_info.usage = memory_usage;
 
-    Buffer *buffer = (Buffer *) imalloc(sizeof(Buffer));
+    BufferHandle handle;
+    Buffer *buffer = buffer_pool.allocate(&handle);
+    buffer->handle = handle;
     buffer->size = size;
+    buffer->usage = usage;
 
     err = vmaCreateBuffer(allocator, &buffer_create_info, &allocation_create_info, &buffer->vk_buffer, &buffer->allocation, &buffer->allocation_info);
     assert(!err);
 
+    MemoryCategory category = MEMORY_CATEGORY_OTHER;
+    if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+        category = MEMORY_CATEGORY_GEOMETRY;
+    else if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+        category = MEMORY_CATEGORY_UNIFORM;
+    else if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT || usage == VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+        category = MEMORY_CATEGORY_STAGING;
+
+    _track_allocation(buffer->allocation, category, buffer, NULL);
+
     return buffer;
 }
 
 void RenderDevice::destroy_buffer(Buffer *p_buffer)
 {
-    vmaDestroyBuffer(allocator, p_buffer->vk_buffer, p_buffer->allocation);
-    free(p_buffer);
+#ifndef NDEBUG
+    // a destroy after the deferred release, caught until the slot is reused.
+    EXIT_FAIL_COND_V(buffer_pool.is_valid(p_buffer->handle), "-engine error: destroy of a released buffer 0x%08x!\n", p_buffer->handle.value);
+#endif
+
+    defer_deletion([this, p_buffer, handle = p_buffer->handle, bindless_index = p_buffer->bindless_index] {
+        if (bindless_index != BINDLESS_INVALID_INDEX)
+            bindless_table->remove_buffer(bindless_index);
+        _untrack_allocation(p_buffer->allocation);
+        vmaDestroyBuffer(allocator, p_buffer->vk_buffer, p_buffer->allocation);
+        buffer_pool.free(handle);
+    });
 }
 
 void RenderDevice::write_buffer(Buffer *buffer, VkDeviceSize offset, VkDeviceSize size, void *buf)
@@ -85,27 +292,234 @@ RenderDevice::read_buffer(Buffer *buffer, VkDeviceSize offset, VkDeviceSize size
     vmaUnmapMemory(allocator, buffer->allocation);
 }
 
-void RenderDevice::create_render_pass(uint32_t attachment_count, VkAttachmentDescription *p_attachments, uint32_t subpass_count, VkSubpassDescription *p_subpass, uint32_t dependency_count, VkSubpassDependency *p_dependencies, VkRenderPass *p_render_pass)
+// bytes of a texel as copied to a buffer, 0 for formats readbacks do not handle.
+static uint32_t _get_texel_size(VkFormat format)
 {
-    VkResult U_ASSERT_ONLY err;
+    switch (format) {
+        case VK_FORMAT_R8_UNORM:
+            return 1;
+        case VK_FORMAT_R16_SFLOAT:
+        case VK_FORMAT_D16_UNORM:
+            return 2;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+        case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+        case VK_FORMAT_R32_UINT:
+        case VK_FORMAT_R32_SFLOAT:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT: /* depth aspect only */
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32_SFLOAT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 0;
+    }
+}
 
-    // create render pass
-    VkRenderPassCreateInfo render_pass_create_info = {};
-    render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    render_pass_create_info.attachmentCount = attachment_count;
-    render_pass_create_info.pAttachments = p_attachments;
-    render_pass_create_info.subpassCount = subpass_count;
-    render_pass_create_info.pSubpasses = p_subpass;
-    render_pass_create_info.dependencyCount = dependency_count;
-    render_pass_create_info.pDependencies = p_dependencies;
-
-    err = vkCreateRenderPass(vk_device, &render_pass_create_info, allocation_callbacks, p_render_pass);
-    assert(!err);
+std::future<RenderDevice::ReadbackResult> RenderDevice::cmd_readback_buffer(VkCommandBuffer cmd_buffer, Buffer *p_buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    Buffer *staging_buffer = _create_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, size, VMA_MEMORY_USAGE_GPU_TO_CPU, false);
+
+    BarrierBuilder barriers;
+    barriers.buffer(p_buffer, offset, size,
+                    VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+    barriers.flush(cmd_buffer);
+
+    VkBufferCopy region = { offset, 0, size };
+    vkCmdCopyBuffer(cmd_buffer, p_buffer->vk_buffer, staging_buffer->vk_buffer, 1, &region);
+
+    barriers.buffer(staging_buffer, 0, size,
+                    VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+    barriers.flush(cmd_buffer);
+
+    return _defer_readback(staging_buffer, {});
+}
+
+std::future<RenderDevice::ReadbackResult> RenderDevice::cmd_readback_texture(VkCommandBuffer cmd_buffer, Texture2D *p_texture, const VkRect2D *p_rect, uint32_t mip_level, uint32_t array_layer)
+{
+    uint32_t texel_size = _get_texel_size(p_texture->format);
+    EXIT_FAIL_COND_V(texel_size > 0, "-engine error: readback of unsupported texture format %d!\n", p_texture->format);
+
+    VkRect2D rect = { { 0, 0 }, { std::max(p_texture->width >> mip_level, 1u), std::max(p_texture->height >> mip_level, 1u) } };
+    if (p_rect != NULL)
+        rect = *p_rect;
+
+    VkDeviceSize size = (VkDeviceSize) rect.extent.width * rect.extent.height * texel_size;
+    Buffer *staging_buffer = _create_buffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, size, VMA_MEMORY_USAGE_GPU_TO_CPU, false);
+
+    // the texture goes back to the layout it was in, later passes of the frame
+    // still find it where the render graph left it.
+    VkImageLayout layout = p_texture->image_layout;
+
+    BarrierBuilder barriers;
+    barriers.image(p_texture, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+    barriers.flush(cmd_buffer);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = (p_texture->aspect_mask & VK_IMAGE_ASPECT_DEPTH_BIT) ? (VkImageAspectFlags) VK_IMAGE_ASPECT_DEPTH_BIT : p_texture->aspect_mask;
+    region.imageSubresource.mipLevel = mip_level;
+    region.imageSubresource.baseArrayLayer = array_layer;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { rect.offset.x, rect.offset.y, 0 };
+    region.imageExtent = { rect.extent.width, rect.extent.height, 1 };
+
+    vkCmdCopyImageToBuffer(cmd_buffer, p_texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging_buffer->vk_buffer, 1, &region);
+
+    if (layout != VK_IMAGE_LAYOUT_UNDEFINED)
+        barriers.image(p_texture, layout,
+                       VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_NONE,
+                       VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+    barriers.buffer(staging_buffer, 0, size,
+                    VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+    barriers.flush(cmd_buffer);
+
+    ReadbackResult result;
+    result.width = rect.extent.width;
+    result.height = rect.extent.height;
+    result.format = p_texture->format;
+
+    return _defer_readback(staging_buffer, std::move(result));
+}
+
+std::future<RenderDevice::ReadbackResult> RenderDevice::_defer_readback(Buffer *p_staging_buffer, ReadbackResult v_result)
+{
+    auto promise = std::make_shared<std::promise<ReadbackResult>>();
+    std::future<ReadbackResult> future = promise->get_future();
+
+    // the frame has retired when this runs, the staging buffer is released right
+    // away instead of going through another deferred destroy.
+    defer_deletion([this, p_staging_buffer, promise, result = std::move(v_result)]() mutable {
+        vmaInvalidateAllocation(allocator, p_staging_buffer->allocation, 0, VK_WHOLE_SIZE);
+        result.data.resize(p_staging_buffer->size);
+        read_buffer(p_staging_buffer, 0, p_staging_buffer->size, std::data(result.data));
+        promise->set_value(std::move(result));
+
+        _untrack_allocation(p_staging_buffer->allocation);
+        vmaDestroyBuffer(allocator, p_staging_buffer->vk_buffer, p_staging_buffer->allocation);
+        buffer_pool.free(p_staging_buffer->handle);
+    });
+
+    return future;
+}
+
+VkCommandBuffer RenderDevice::allocate_frame_cmd_buffer(VkCommandBufferLevel level)
+{
+    _ThreadCmdPools *pools;
+
+    {
+        std::unique_lock<std::mutex> lock(cmd_pool_mutex);
+        auto it = thread_cmd_pools.find(std::this_thread::get_id());
+        if (it != thread_cmd_pools.end()) {
+            pools = it->second;
+        } else {
+            pools = memnew(_ThreadCmdPools);
+
+            VkCommandPoolCreateInfo cmd_pool_create_info = {
+                    /* sType */ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                    /* pNext */ nextptr,
+                    /* flags */ VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                    /* queueFamilyIndex */ vk_rdc->get_graph_queue_family()
+            };
+
+            for (auto &frame: pools->frames) {
+                VkResult U_ASSERT_ONLY err = vkCreateCommandPool(vk_device, &cmd_pool_create_info, allocation_callbacks, &frame.cmd_pool);
+                assert(!err);
+                frame.used[0] = frame.used[1] = 0;
+            }
+
+            thread_cmd_pools[std::this_thread::get_id()] = pools;
+        }
+    }
+
+    // only the owning thread touches its pools while the frame is recorded.
+    _FrameCmdPool *frame = &pools->frames[frame_index % RENDER_DEVICE_FRAMES_IN_FLIGHT];
+    std::vector<VkCommandBuffer> &cmd_buffers = frame->cmd_buffers[level];
+
+    if (frame->used[level] == cmd_buffers.size()) {
+        VkCommandBufferAllocateInfo allocate_info = {
+                /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                /* pNext */ nextptr,
+                /* commandPool */ frame->cmd_pool,
+                /* level */ level,
+                /* commandBufferCount */ 1
+        };
+
+        VkCommandBuffer cmd_buffer;
+        VkResult U_ASSERT_ONLY err = vkAllocateCommandBuffers(vk_device, &allocate_info, &cmd_buffer);
+        assert(!err);
+        cmd_buffers.push_back(cmd_buffer);
+    }
+
+    return cmd_buffers[frame->used[level]++];
 }
 
-void RenderDevice::destroy_render_pass(VkRenderPass render_pass)
+// runs after the slot of the new frame has retired, resetting a pool resets every
+// command buffer allocated from it.
+void RenderDevice::_reset_frame_cmd_pools()
 {
-    vkDestroyRenderPass(vk_device, render_pass, allocation_callbacks);
+    std::unique_lock<std::mutex> lock(cmd_pool_mutex);
+
+    for (auto &[thread, pools]: thread_cmd_pools) {
+        _FrameCmdPool *frame = &pools->frames[frame_index % RENDER_DEVICE_FRAMES_IN_FLIGHT];
+        if (frame->used[0] == 0 && frame->used[1] == 0)
+            continue;
+
+        vkResetCommandPool(vk_device, frame->cmd_pool, no_flag_bits);
+        frame->used[0] = frame->used[1] = 0;
+    }
+
+    std::unique_lock<std::mutex> compute_lock(compute_mutex);
+    _ComputeFrame *compute_frame = &compute_frames[frame_index % RENDER_DEVICE_FRAMES_IN_FLIGHT];
+    if (compute_frame->used > 0)
+        vkResetCommandPool(vk_device, compute_frame->cmd_pool, no_flag_bits);
+    compute_frame->used = 0;
+}
+
+VkCommandBuffer RenderDevice::allocate_frame_compute_cmd_buffer()
+{
+    std::unique_lock<std::mutex> lock(compute_mutex);
+    _ComputeFrame *frame = &compute_frames[frame_index % RENDER_DEVICE_FRAMES_IN_FLIGHT];
+
+    if (frame->used == frame->cmd_buffers.size()) {
+        VkCommandBufferAllocateInfo allocate_info = {
+                /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                /* pNext */ nextptr,
+                /* commandPool */ frame->cmd_pool,
+                /* level */ VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                /* commandBufferCount */ 1
+        };
+
+        VkCommandBuffer cmd_buffer;
+        VkResult U_ASSERT_ONLY err = vkAllocateCommandBuffers(vk_device, &allocate_info, &cmd_buffer);
+        assert(!err);
+        frame->cmd_buffers.push_back(cmd_buffer);
+    }
+
+    return frame->cmd_buffers[frame->used++];
+}
+
+uint64_t RenderDevice::submit_async_compute(VkCommandBuffer cmd_buffer)
+{
+    return cmd_buffer_submit(cmd_buffer, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, VK_NULL_HANDLE, vk_rdc->get_compute_queue());
+}
+
+RenderDeviceContext::QueueType RenderDevice::_get_queue_type(VkQueue queue)
+{
+    return queue == vk_rdc->get_compute_queue() && is_async_compute_supported() ? RenderDeviceContext::QUEUE_TYPE_COMPUTE : RenderDeviceContext::QUEUE_TYPE_GRAPHICS;
 }
 
 void RenderDevice::allocate_cmd_buffer(VkCommandBuffer *p_cmd_buffer)
@@ -115,50 +529,155 @@ void RenderDevice::allocate_cmd_buffer(VkCommandBuffer *p_cmd_buffer)
 
 void RenderDevice::free_cmd_buffer(VkCommandBuffer cmd_buffer)
 {
-    vk_rdc->free_cmd_buffer(cmd_buffer);
+    defer_deletion([this, cmd_buffer] {
+        vk_rdc->free_cmd_buffer(cmd_buffer);
+    });
 }
 
-RenderDevice::Texture2D *RenderDevice::create_texture(TextureCreateInfo *p_create_info)
+// storage images are shared between the queues in p_queue_families, NULL when both
+// are the same queue.
+static VkImageCreateInfo _texture_image_create_info(RenderDevice::TextureCreateInfo *p_create_info, const uint32_t *p_queue_families)
 {
-    VkResult U_ASSERT_ONLY err;
-    Texture2D *texture = VK_NULL_HANDLE;
+    bool concurrent = p_queue_families != NULL && (p_create_info->usage & VK_IMAGE_USAGE_STORAGE_BIT);
 
-    texture = (Texture2D *) imalloc(sizeof(Texture2D));
-    texture->format = p_create_info->format;
-    texture->width = p_create_info->width;
-    texture->height = p_create_info->height;
-    texture->aspect_mask = p_create_info->aspect_mask;
+    uint32_t mip_levels = std::max(p_create_info->mip_levels, 1u);
+
+    // mip levels are generated by blitting from the level above, sampled textures
+    // are copied to their new place when defragmentation moves them.
+    VkImageUsageFlags usage = p_create_info->usage;
+    if (mip_levels > 1 || (usage & VK_IMAGE_USAGE_SAMPLED_BIT))
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
     VkImageCreateInfo image_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
             /* pNext */ nextptr,
             /* flags */ no_flag_bits,
             /* imageType */ p_create_info->image_type,
-            /* format */ texture->format,
+            /* format */ p_create_info->format,
             /* extent */ { p_create_info->width, p_create_info->height, 1 },
-            /* mipLevels */ 1,
-            /* arrayLayers */ 1,
+            /* mipLevels */ mip_levels,
+            /* arrayLayers */ std::max(p_create_info->array_layers, 1u),
             /* samples */ p_create_info->samples,
             /* tiling */ VK_IMAGE_TILING_OPTIMAL,
-            /* usage */ p_create_info->usage,
-            /* sharingMode */ VK_SHARING_MODE_EXCLUSIVE,
-            /* queueFamilyIndexCount */ 0,
-            /* pQueueFamilyIndices */ nullptr,
+            /* usage */ usage,
+            /* sharingMode */ concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            /* queueFamilyIndexCount */ concurrent ? 2u : 0u,
+            /* pQueueFamilyIndices */ concurrent ? p_queue_families : nullptr,
             /* initialLayout */ VK_IMAGE_LAYOUT_UNDEFINED,
     };
 
+    return image_create_info;
+}
+
+RenderDevice::Texture2D *RenderDevice::create_texture(TextureCreateInfo *p_create_info)
+{
+    return _create_texture(p_create_info, VK_NULL_HANDLE);
+}
+
+RenderDevice::Texture2D *RenderDevice::create_aliasing_texture(TextureCreateInfo *p_create_info, VmaAllocation allocation)
+{
+    return _create_texture(p_create_info, allocation);
+}
+
+void RenderDevice::get_texture_memory_requirements(TextureCreateInfo *p_create_info, VkMemoryRequirements *p_requirements)
+{
+    VkImageCreateInfo image_create_info = _texture_image_create_info(p_create_info, is_async_compute_supported() ? queue_families : NULL);
+
+    VkDeviceImageMemoryRequirements device_image_memory_requirements = {};
+    device_image_memory_requirements.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+    device_image_memory_requirements.pCreateInfo = &image_create_info;
+
+    VkMemoryRequirements2 memory_requirements = {};
+    memory_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    vkGetDeviceImageMemoryRequirements(vk_device, &device_image_memory_requirements, &memory_requirements);
+
+    *p_requirements = memory_requirements.memoryRequirements;
+}
+
+VmaAllocation RenderDevice::allocate_memory(const VkMemoryRequirements *p_requirements)
+{
+    VkResult U_ASSERT_ONLY err;
+    VmaAllocation allocation;
+
     VmaAllocationCreateInfo allocation_create_info = {};
-    allocation_create_info.usage = VMA_MEMORY_USAGE_AUTO;
-    err = vmaCreateImage(allocator, &image_create_info, &allocation_create_info, &texture->image, &texture->allocation, &texture->allocation_info);
+    allocation_create_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    // the requirements of transient attachments allow lazily allocated types, memory
+    // shared by transient attachments only then stays in tile memory as well.
+    if (lazily_allocated_memory)
+        allocation_create_info.preferredFlags = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+    err = vmaAllocateMemory(allocator, p_requirements, &allocation_create_info, &allocation, VK_NULL_HANDLE);
     assert(!err);
 
+    // only attachments alias their memory so far.
+    _track_allocation(allocation, MEMORY_CATEGORY_RENDER_TARGET, NULL, NULL);
+
+    return allocation;
+}
+
+void RenderDevice::free_memory(VmaAllocation allocation)
+{
+    defer_deletion([this, allocation] {
+        _untrack_allocation(allocation);
+        vmaFreeMemory(allocator, allocation);
+    });
+}
+
+RenderDevice::Texture2D *RenderDevice::_create_texture(TextureCreateInfo *p_create_info, VmaAllocation aliasing_allocation)
+{
+    VkResult U_ASSERT_ONLY err;
+    TextureHandle handle;
+
+    Texture2D *texture = texture_pool.allocate(&handle);
+    texture->handle = handle;
+    texture->format = p_create_info->format;
+    texture->width = p_create_info->width;
+    texture->height = p_create_info->height;
+    texture->aspect_mask = p_create_info->aspect_mask;
+    texture->mip_levels = std::max(p_create_info->mip_levels, 1u);
+    texture->array_layers = std::max(p_create_info->array_layers, 1u);
+    texture->usage = p_create_info->usage;
+    texture->samples = p_create_info->samples;
+    texture->image_type = p_create_info->image_type;
+    texture->image_view_type = p_create_info->image_view_type;
+
+    VkImageCreateInfo image_create_info = _texture_image_create_info(p_create_info, is_async_compute_supported() ? queue_families : NULL);
+
+    if (aliasing_allocation != VK_NULL_HANDLE) {
+        texture->allocation = aliasing_allocation;
+        texture->aliasing = true;
+        err = vmaCreateAliasingImage(allocator, aliasing_allocation, &image_create_info, &texture->image);
+        assert(!err);
+        vmaGetAllocationInfo(allocator, aliasing_allocation, &texture->allocation_info);
+    } else {
+        VmaAllocationCreateInfo allocation_create_info = {};
+        allocation_create_info.usage = VMA_MEMORY_USAGE_AUTO;
+        // transient attachments never leave tile memory on gpus that expose lazily
+        // allocated heaps, elsewhere they fall back to ordinary device memory.
+        if ((image_create_info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) && lazily_allocated_memory)
+            allocation_create_info.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+        err = vmaCreateImage(allocator, &image_create_info, &allocation_create_info, &texture->image, &texture->allocation, &texture->allocation_info);
+        assert(!err);
+
+        VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        MemoryCategory category = (image_create_info.usage & attachment_usage) ? MEMORY_CATEGORY_RENDER_TARGET : MEMORY_CATEGORY_TEXTURE;
+        _track_allocation(texture->allocation, category, NULL, texture);
+    }
+
+    _create_texture_image_view(texture);
+
+    return texture;
+}
+
+void RenderDevice::_create_texture_image_view(Texture2D *p_texture)
+{
     VkImageViewCreateInfo image_view_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             /* pNext */ nextptr,
             /* flags */ no_flag_bits,
-            /* image */ texture->image,
-            /* viewType */ p_create_info->image_view_type,
-            /* format */ texture->format,
+            /* image */ p_texture->image,
+            /* viewType */ p_texture->image_view_type,
+            /* format */ p_texture->format,
             /* components */
                 {
                     .r = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -168,133 +687,697 @@ RenderDevice::Texture2D *RenderDevice::create_texture(TextureCreateInfo *p_creat
                 },
             /* subresourceRange */
                 {
-                    .aspectMask = p_create_info->aspect_mask,
+                    .aspectMask = p_texture->aspect_mask,
                     .baseMipLevel = 0,
-                    .levelCount = 1,
+                    .levelCount = p_texture->mip_levels,
                     .baseArrayLayer = 0,
-                    .layerCount = 1,
+                    .layerCount = p_texture->array_layers,
                 },
     };
 
-    err = vkCreateImageView(vk_device, &image_view_create_info, allocation_callbacks, &texture->image_view);
+    VkResult U_ASSERT_ONLY err = vkCreateImageView(vk_device, &image_view_create_info, allocation_callbacks, &p_texture->image_view);
     assert(!err);
-
-    return texture;
 }
 
 void RenderDevice::destroy_texture(Texture2D *p_texture)
 {
-    vmaDestroyImage(allocator, p_texture->image, p_texture->allocation);
-    vkDestroyImageView(vk_device, p_texture->image_view, allocation_callbacks);
+#ifndef NDEBUG
+    // a destroy after the deferred release, caught until the slot is reused.
+    EXIT_FAIL_COND_V(texture_pool.is_valid(p_texture->handle), "-engine error: destroy of a released texture 0x%08x!\n", p_texture->handle.value);
+#endif
+
     if (p_texture->descriptor_set)
         free_descriptor_set(p_texture->descriptor_set);
+
+    defer_deletion([this, p_texture, handle = p_texture->handle, bindless_index = p_texture->bindless_index] {
+        if (bindless_index != BINDLESS_INVALID_INDEX)
+            bindless_table->remove_texture(bindless_index);
+        vkDestroyImageView(vk_device, p_texture->image_view, allocation_callbacks);
+        if (p_texture->aliasing)
+            vkDestroyImage(vk_device, p_texture->image, allocation_callbacks);
+        else {
+            _untrack_allocation(p_texture->allocation);
+            vmaDestroyImage(allocator, p_texture->image, p_texture->allocation);
+        }
+        texture_pool.free(handle);
+    });
 }
 
-void RenderDevice::write_texture(Texture2D *texture, size_t size, void *pixels)
+void RenderDevice::get_memory_stats(MemoryStats *p_stats, uint32_t largest_count)
 {
-    Buffer *buffer = create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
-    write_buffer(buffer, 0, size, pixels);
+    const VkPhysicalDeviceMemoryProperties *memory_properties;
+    vmaGetMemoryProperties(allocator, &memory_properties);
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(allocator, budgets);
+
+    VmaTotalStatistics statistics;
+    vmaCalculateStatistics(allocator, &statistics);
+
+    p_stats->heaps.resize(memory_properties->memoryHeapCount);
+    for (uint32_t i = 0; i < memory_properties->memoryHeapCount; i++) {
+        const VmaDetailedStatistics &detailed = statistics.memoryHeap[i];
+        MemoryHeapStats *heap = &p_stats->heaps[i];
+        heap->budget = budgets[i].budget;
+        heap->usage = budgets[i].usage;
+        heap->block_bytes = detailed.statistics.blockBytes;
+        heap->allocation_bytes = detailed.statistics.allocationBytes;
+        heap->block_count = detailed.statistics.blockCount;
+        heap->allocation_count = detailed.statistics.allocationCount;
+        heap->device_local = memory_properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+
+        VkDeviceSize unused_bytes = heap->block_bytes - heap->allocation_bytes;
+        heap->fragmentation = 0.0f;
+        if (detailed.unusedRangeCount > 0 && unused_bytes > 0)
+            heap->fragmentation = 1.0f - (float) detailed.unusedRangeSizeMax / (float) unused_bytes;
+    }
+
+    memset(p_stats->category_bytes, 0, sizeof(p_stats->category_bytes));
+    memset(p_stats->category_counts, 0, sizeof(p_stats->category_counts));
+    p_stats->largest.clear();
+
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    for (const auto &[allocation, tracked] : tracked_allocations) {
+        p_stats->category_bytes[tracked.stats.category] += tracked.stats.size;
+        p_stats->category_counts[tracked.stats.category]++;
+        p_stats->largest.push_back(tracked.stats);
+    }
+
+    auto larger = [](const MemoryAllocationStats &a, const MemoryAllocationStats &b) { return a.size > b.size; };
+    uint32_t count = std::min<size_t>(largest_count, p_stats->largest.size());
+    std::partial_sort(p_stats->largest.begin(), p_stats->largest.begin() + count, p_stats->largest.end(), larger);
+    p_stats->largest.resize(count);
+}
 
-    texture->size = size;
+const char *RenderDevice::get_memory_category_name(MemoryCategory category)
+{
+    switch (category) {
+        case MEMORY_CATEGORY_GEOMETRY: return "geometry";
+        case MEMORY_CATEGORY_TEXTURE: return "texture";
+        case MEMORY_CATEGORY_RENDER_TARGET: return "render target";
+        case MEMORY_CATEGORY_STAGING: return "staging";
+        case MEMORY_CATEGORY_UNIFORM: return "uniform";
+        default: return "other";
+    }
+}
 
-    VkCommandBuffer cmd_buffer;
-    cmd_buffer_one_time_begin(&cmd_buffer);
+void RenderDevice::_track_allocation(VmaAllocation allocation, MemoryCategory category, Buffer *p_buffer, Texture2D *p_texture)
+{
+    VmaAllocationInfo allocation_info;
+    vmaGetAllocationInfo(allocator, allocation, &allocation_info);
 
-    PipelineMemoryBarrier barrier;
-    barrier.image.texture = texture;
-    barrier.image.old_image_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-    barrier.image.new_image_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.image.src_access_mask = 0;
-    barrier.image.dst_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    cmd_pipeline_barrier(cmd_buffer, &barrier);
+    _TrackedAllocation tracked = {};
+    tracked.stats = { category, allocation_info.size, p_texture ? p_texture->width : 0, p_texture ? p_texture->height : 0 };
+    tracked.buffer = p_buffer;
+    tracked.texture = p_texture;
 
-    VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = { texture->width, texture->height, 1 };
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    tracked_allocations[allocation] = tracked;
+}
+
+void RenderDevice::_untrack_allocation(VmaAllocation allocation)
+{
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    tracked_allocations.erase(allocation);
+}
 
-    vkCmdCopyBufferToImage(
-        cmd_buffer,
-        buffer->vk_buffer,
-        texture->image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-    );
+void RenderDevice::_defragment()
+{
+    if (defragmentation_budget_ms <= 0.0f || defragmentation_pass_open)
+        return;
+
+    // descriptors read by pending work must not be rewritten and the deletions of
+    // earlier frames must have run, only move resources once every frame has retired
+    // and the gpu has caught up with everything submitted or queued.
+    if (retired_frame_count < frame_index)
+        return;
+
+    for (uint32_t i = 0; i < RenderDeviceContext::QUEUE_TYPE_MAX; i++) {
+        RenderDeviceContext::QueueType queue_type = (RenderDeviceContext::QueueType) i;
+        if (vk_rdc->get_completed_timeline_value(queue_type) < vk_rdc->get_submitted_timeline_value(queue_type))
+            return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(submission_mutex);
+        for (const auto &submissions: pending_submissions) {
+            if (!submissions.empty())
+                return;
+        }
+    }
+
+    if (defragmentation_context == VK_NULL_HANDLE) {
+        if (frame_index < next_defragmentation_frame)
+            return;
+
+        VmaDefragmentationInfo defragmentation_info = {};
+        defragmentation_info.maxBytesPerPass = RENDER_DEVICE_DEFRAGMENTATION_BYTES_PER_PASS;
+        defragmentation_info.maxAllocationsPerPass = RENDER_DEVICE_DEFRAGMENTATION_ALLOCATIONS_PER_PASS;
+
+        VkResult U_ASSERT_ONLY err = vmaBeginDefragmentation(allocator, &defragmentation_info, &defragmentation_context);
+        assert(!err);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<float, std::milli> budget(defragmentation_budget_ms);
+
+    while (std::chrono::steady_clock::now() - start < budget) {
+        if (_defragment_pass()) {
+            if (defragmentation_pass_open)
+                break;
+            continue;
+        }
+
+        VmaDefragmentationStats stats;
+        vmaEndDefragmentation(allocator, defragmentation_context, &stats);
+        defragmentation_context = VK_NULL_HANDLE;
+        defragmentation_stats.freed_blocks += stats.deviceMemoryBlocksFreed;
+        next_defragmentation_frame = frame_index + RENDER_DEVICE_DEFRAGMENTATION_INTERVAL;
+        break;
+    }
+}
 
-    barrier.image.old_image_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.image.new_image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.image.src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.image.dst_access_mask = VK_ACCESS_SHADER_READ_BIT;
-    cmd_pipeline_barrier(cmd_buffer, &barrier);
+bool RenderDevice::_defragment_pass()
+{
+    VmaDefragmentationPassMoveInfo pass;
+    if (vmaBeginDefragmentationPass(allocator, defragmentation_context, &pass) == VK_SUCCESS)
+        return false;
+
+    _MovedObjects moved;
+    VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+
+    for (uint32_t i = 0; i < pass.moveCount; i++) {
+        VmaDefragmentationMove *move = &pass.pMoves[i];
+
+        _TrackedAllocation tracked = {};
+        {
+            std::lock_guard<std::mutex> lock(memory_mutex);
+            auto it = tracked_allocations.find(move->srcAllocation);
+            if (it != tracked_allocations.end())
+                tracked = it->second;
+        }
+
+        if (!_is_movable(tracked.buffer, tracked.texture)) {
+            move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        if (cmd_buffer == VK_NULL_HANDLE) {
+            cmd_buffer = allocate_frame_cmd_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+            cmd_buffer_begin(cmd_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        }
+
+        if (tracked.buffer != NULL)
+            _move_buffer(tracked.buffer, move->dstTmpAllocation, cmd_buffer, &moved);
+        else
+            _move_texture(tracked.texture, move->dstTmpAllocation, cmd_buffer, &moved);
+
+        defragmentation_stats.moved_allocations++;
+        defragmentation_stats.moved_bytes += tracked.stats.size;
+    }
+
+    // every move was refused, there is nothing to wait for.
+    if (cmd_buffer == VK_NULL_HANDLE)
+        return _end_defragmentation_pass(&pass, &moved);
+
+    // the moved buffers are read by whatever the frame records after the copies.
+    if (!moved.moved_buffers.empty()) {
+        BarrierBuilder barriers;
+        barriers.memory(VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT);
+        barriers.flush(cmd_buffer);
+    }
 
-    cmd_buffer_one_time_end(cmd_buffer);
-    destroy_buffer(buffer);
+    cmd_buffer_end(cmd_buffer);
+
+    // goes out first with the frame submission, later submits on the graph queue
+    // are ordered after the copies.
+    enqueue_submission(cmd_buffer, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, VK_NULL_HANDLE, vk_rdc->get_graph_queue());
+
+    // replay the descriptor writes that reference a moved resource.
+    std::vector<std::pair<std::pair<VkDescriptorSet, uint32_t>, _DescriptorWrite>> writes;
+    {
+        std::unique_lock<std::mutex> lock(descriptor_write_mutex);
+        for (const auto &write: descriptor_writes) {
+            bool buffer_moved = std::find(moved.moved_buffers.begin(), moved.moved_buffers.end(), write.second.buffer) != moved.moved_buffers.end();
+            bool texture_moved = std::find(moved.moved_textures.begin(), moved.moved_textures.end(), write.second.texture) != moved.moved_textures.end();
+            if (buffer_moved || texture_moved)
+                writes.push_back(write);
+        }
+    }
+
+    for (const auto &[key, write]: writes) {
+        auto [descriptor_set, binding] = key;
+        switch (write.type) {
+            case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: update_descriptor_set_buffer(buffer_pool.get(write.buffer), binding, descriptor_set); break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: update_descriptor_set_storage_buffer(buffer_pool.get(write.buffer), binding, descriptor_set); break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: update_descriptor_set_storage_image(texture_pool.get(write.texture), binding, descriptor_set); break;
+            default: update_descriptor_set_image(texture_pool.get(write.texture), binding, descriptor_set); break;
+        }
+    }
+
+    // the old objects and the memory they leave are released once the frame has
+    // retired. queued ahead of the deletions of the frame, so the pass has ended
+    // before a resource destroyed meanwhile frees an allocation it moves.
+    defragmentation_pass_open = true;
+    defer_deletion([this, pass, moved] () mutable {
+        _end_defragmentation_pass(&pass, &moved);
+        defragmentation_pass_open = false;
+    });
+
+    return true;
 }
 
-void
-RenderDevice::create_framebuffer(uint32_t width, uint32_t height, uint32_t image_view_count, VkImageView *p_image_view, VkRenderPass render_pass, VkFramebuffer *p_framebuffer)
+// runs from the deletion queue as well, it must not defer anything itself.
+bool RenderDevice::_end_defragmentation_pass(VmaDefragmentationPassMoveInfo *p_pass, const _MovedObjects *p_moved)
+{
+    for (VkImageView image_view: p_moved->image_views)
+        vkDestroyImageView(vk_device, image_view, allocation_callbacks);
+    for (VkImage image: p_moved->images)
+        vkDestroyImage(vk_device, image, allocation_callbacks);
+    for (VkBuffer buffer: p_moved->buffers)
+        vkDestroyBuffer(vk_device, buffer, allocation_callbacks);
+
+    VkResult result = vmaEndDefragmentationPass(allocator, defragmentation_context, p_pass);
+
+    // the source allocations describe the new place from here on.
+    for (BufferHandle handle: p_moved->moved_buffers) {
+        Buffer *buffer = buffer_pool.get(handle);
+        vmaGetAllocationInfo(allocator, buffer->allocation, &buffer->allocation_info);
+    }
+
+    for (TextureHandle handle: p_moved->moved_textures) {
+        Texture2D *texture = texture_pool.get(handle);
+        vmaGetAllocationInfo(allocator, texture->allocation, &texture->allocation_info);
+    }
+
+    defragmentation_stats.passes++;
+
+    return result == VK_INCOMPLETE;
+}
+
+bool RenderDevice::_is_movable(Buffer *p_buffer, Texture2D *p_texture)
+{
+    // only buffers the upload has handed over to the render thread are unpinned,
+    // storage resources may be written by the compute queue.
+    if (p_buffer != NULL)
+        return !p_buffer->pinned && !(p_buffer->usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    // attachments are referenced by framebuffers and rendering infos, textures still
+    // waiting for their upload have nothing to copy yet.
+    if (p_texture != NULL) {
+        VkImageUsageFlags unmovable_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                            VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+        return !p_texture->pinned && !p_texture->aliasing && !(p_texture->usage & unmovable_usage) &&
+               (p_texture->usage & VK_IMAGE_USAGE_SAMPLED_BIT) && p_texture->image_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    return false;
+}
+
+void RenderDevice::_move_buffer(Buffer *p_buffer, VmaAllocation dst_allocation, VkCommandBuffer cmd_buffer, _MovedObjects *p_moved)
 {
     VkResult U_ASSERT_ONLY err;
 
-    VkFramebufferCreateInfo framebuffer_create_info = {
-            /* sType */ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            /* pNext */ nextptr,
-            /* flags */ no_flag_bits,
-            /* renderPass */ render_pass,
-            /* attachmentCount */ image_view_count,
-            /* pAttachments */ p_image_view,
-            /* width */ width,
-            /* height */ height,
-            /* layers */ 1,
-    };
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.usage = p_buffer->usage;
+    buffer_create_info.size = p_buffer->size;
+
+    VkBuffer vk_buffer;
+    err = vkCreateBuffer(vk_device, &buffer_create_info, allocation_callbacks, &vk_buffer);
+    assert(!err);
 
-    err = vkCreateFramebuffer(vk_device, &framebuffer_create_info, allocation_callbacks, p_framebuffer);
+    err = vmaBindBufferMemory(allocator, dst_allocation, vk_buffer);
     assert(!err);
+
+    // nothing is in flight, the copy needs no barrier ahead of it.
+    VkBufferCopy region = { 0, 0, p_buffer->size };
+    vkCmdCopyBuffer(cmd_buffer, p_buffer->vk_buffer, vk_buffer, 1, &region);
+
+    std::unique_lock<std::mutex> lock(binding_mutex);
+    p_moved->buffers.push_back(p_buffer->vk_buffer);
+    p_moved->moved_buffers.push_back(p_buffer->handle);
+    p_buffer->vk_buffer = vk_buffer;
+
+    if (p_buffer->bindless_index != BINDLESS_INVALID_INDEX)
+        bindless_table->update_buffer(p_buffer->bindless_index, p_buffer->vk_buffer, 0, p_buffer->size);
 }
 
-void RenderDevice::destroy_framebuffer(VkFramebuffer framebuffer)
+void RenderDevice::_move_texture(Texture2D *p_texture, VmaAllocation dst_allocation, VkCommandBuffer cmd_buffer, _MovedObjects *p_moved)
 {
-    vkDestroyFramebuffer(vk_device, framebuffer, allocation_callbacks);
+    VkResult U_ASSERT_ONLY err;
+
+    TextureCreateInfo texture_create_info = {};
+    texture_create_info.width = p_texture->width;
+    texture_create_info.height = p_texture->height;
+    texture_create_info.samples = p_texture->samples;
+    texture_create_info.format = p_texture->format;
+    texture_create_info.aspect_mask = p_texture->aspect_mask;
+    texture_create_info.image_type = p_texture->image_type;
+    texture_create_info.image_view_type = p_texture->image_view_type;
+    texture_create_info.usage = p_texture->usage;
+    texture_create_info.mip_levels = p_texture->mip_levels;
+    texture_create_info.array_layers = p_texture->array_layers;
+
+    VkImageCreateInfo image_create_info = _texture_image_create_info(&texture_create_info, is_async_compute_supported() ? queue_families : NULL);
+
+    VkImage image;
+    err = vkCreateImage(vk_device, &image_create_info, allocation_callbacks, &image);
+    assert(!err);
+
+    err = vmaBindImageMemory(allocator, dst_allocation, image);
+    assert(!err);
+
+    VkImageSubresourceRange subresource_range = { p_texture->aspect_mask, 0, p_texture->mip_levels, 0, p_texture->array_layers };
+    VkImageLayout layout = p_texture->image_layout;
+
+    BarrierBuilder barriers;
+    barriers.external_image(p_texture->image, subresource_range, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+                            VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+    barriers.external_image(image, subresource_range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+                            VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    barriers.flush(cmd_buffer);
+
+    VkImageCopy regions[TEXTURE_MAX_MIP_LEVELS];
+    for (uint32_t level = 0; level < p_texture->mip_levels; level++) {
+        VkImageSubresourceLayers subresource = { p_texture->aspect_mask, level, 0, p_texture->array_layers };
+        regions[level].srcSubresource = subresource;
+        regions[level].srcOffset = { 0, 0, 0 };
+        regions[level].dstSubresource = subresource;
+        regions[level].dstOffset = { 0, 0, 0 };
+        regions[level].extent = { std::max(p_texture->width >> level, 1u), std::max(p_texture->height >> level, 1u), 1 };
+    }
+
+    vkCmdCopyImage(cmd_buffer, p_texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   p_texture->mip_levels, regions);
+
+    barriers.external_image(image, subresource_range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout,
+                            VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT);
+    barriers.flush(cmd_buffer);
+
+    std::unique_lock<std::mutex> lock(binding_mutex);
+    p_moved->images.push_back(p_texture->image);
+    p_moved->image_views.push_back(p_texture->image_view);
+    p_moved->moved_textures.push_back(p_texture->handle);
+    p_texture->image = image;
+    _create_texture_image_view(p_texture);
+
+    if (p_texture->bindless_index != BINDLESS_INVALID_INDEX)
+        bindless_table->update_texture(p_texture->bindless_index, p_texture->sampler, p_texture->image_view, RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT);
+    if (p_texture->descriptor_set)
+        _write_texture_descriptor_set(p_texture);
+}
+
+void RenderDevice::enqueue_texture_upload(Texture2D *texture, Buffer *staging_buffer, uint32_t level_count, const VkDeviceSize *p_level_offsets)
+{
+    _TextureUpload upload = {};
+    upload.texture = texture;
+    upload.staging_buffer = staging_buffer;
+    upload.level_count = std::clamp(level_count, 1u, texture->mip_levels);
+
+    for (uint32_t i = 0; i < upload.level_count; i++)
+        upload.level_offsets[i] = p_level_offsets ? p_level_offsets[i] : 0;
+
+    texture->size = staging_buffer->size;
+    texture_uploads.push_back(upload);
+}
+
+void RenderDevice::enqueue_buffer_upload(Buffer *buffer, Buffer *staging_buffer)
+{
+    buffer_uploads.push_back({ buffer, staging_buffer });
+}
+
+void RenderDevice::flush_upload_queue()
+{
+    if (texture_uploads.empty() && buffer_uploads.empty())
+        return;
+
+    VkCommandBuffer cmd_buffer;
+    cmd_buffer_one_time_begin(&cmd_buffer);
+
+    // buffers need no layout transition, copy them first and release them together
+    // with the textures at the end.
+    for (const auto &upload: buffer_uploads) {
+        VkBufferCopy region = { 0, 0, upload.staging_buffer->size };
+        vkCmdCopyBuffer(cmd_buffer, upload.staging_buffer->vk_buffer, upload.buffer->vk_buffer, 1, &region);
+    }
+
+    // one barrier batch per step for all textures instead of a few per texture.
+    BarrierBuilder barriers;
+    uint32_t max_levels = 0;
+
+    for (const auto &upload: texture_uploads) {
+        barriers.image_range(upload.texture, 0, upload.texture->mip_levels, 0, upload.texture->array_layers,
+                             VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+                             VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+        max_levels = std::max(max_levels, upload.texture->mip_levels);
+    }
+
+    barriers.flush(cmd_buffer);
+
+    VkBufferImageCopy regions[TEXTURE_MAX_MIP_LEVELS];
+    for (const auto &upload: texture_uploads) {
+        for (uint32_t level = 0; level < upload.level_count; level++) {
+            VkBufferImageCopy *region = &regions[level];
+            *region = {};
+            region->bufferOffset = upload.level_offsets[level];
+            region->imageSubresource = { upload.texture->aspect_mask, level, 0, upload.texture->array_layers };
+            region->imageExtent = { std::max(upload.texture->width >> level, 1u), std::max(upload.texture->height >> level, 1u), 1 };
+        }
+
+        vkCmdCopyBufferToImage(cmd_buffer, upload.staging_buffer->vk_buffer, upload.texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, upload.level_count, regions);
+    }
+
+    // generate the missing levels, level by level across all textures.
+    for (uint32_t level = 1; level < max_levels; level++) {
+        for (const auto &upload: texture_uploads) {
+            if (level >= upload.level_count && level < upload.texture->mip_levels)
+                barriers.image_range(upload.texture, level - 1, 1, 0, upload.texture->array_layers,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                     VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                     VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+        }
+
+        if (barriers.empty())
+            continue;
+
+        barriers.flush(cmd_buffer);
+
+        for (const auto &upload: texture_uploads) {
+            if (level < upload.level_count || level >= upload.texture->mip_levels)
+                continue;
+
+            Texture2D *texture = upload.texture;
+
+            VkImageBlit blit = {};
+            blit.srcSubresource = { texture->aspect_mask, level - 1, 0, texture->array_layers };
+            blit.srcOffsets[1] = { (int32_t) std::max(texture->width >> (level - 1), 1u), (int32_t) std::max(texture->height >> (level - 1), 1u), 1 };
+            blit.dstSubresource = { texture->aspect_mask, level, 0, texture->array_layers };
+            blit.dstOffsets[1] = { (int32_t) std::max(texture->width >> level, 1u), (int32_t) std::max(texture->height >> level, 1u), 1 };
+
+            vkCmdBlitImage(cmd_buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+        }
+    }
+
+    // blit sources are in transfer src, everything else is still in transfer dst.
+    const VkPipelineStageFlags2 sampled_stage_mask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    const VkPipelineStageFlags2 transfer_stage_mask = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT;
+
+    for (const auto &upload: texture_uploads) {
+        Texture2D *texture = upload.texture;
+        uint32_t src_begin = upload.level_count < texture->mip_levels ? upload.level_count - 1 : texture->mip_levels;
+        uint32_t src_end = texture->mip_levels - 1;
+
+        if (src_begin > 0)
+            barriers.image_range(texture, 0, src_begin, 0, texture->array_layers,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT,
+                                 transfer_stage_mask, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                 sampled_stage_mask, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+        if (src_begin < src_end) {
+            barriers.image_range(texture, src_begin, src_end - src_begin, 0, texture->array_layers,
+                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT,
+                                 VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_NONE,
+                                 sampled_stage_mask, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+            barriers.image_range(texture, src_end, 1, 0, texture->array_layers,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT,
+                                 VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                 sampled_stage_mask, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+        }
+
+        texture->image_layout = RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT;
+    }
+
+    for (const auto &upload: buffer_uploads)
+        barriers.buffer(upload.buffer, 0, VK_WHOLE_SIZE,
+                        VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+
+    barriers.flush(cmd_buffer);
+
+    cmd_buffer_end(cmd_buffer);
+
+    // goes out with the frame submission ahead of the scene, later submits on the
+    // graph queue are ordered after the barriers above. the staging buffers and
+    // the command buffer are released once the frame has retired.
+    enqueue_submission(cmd_buffer, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, VK_NULL_HANDLE, vk_rdc->get_graph_queue());
+
+    for (const auto &upload: texture_uploads)
+        destroy_buffer(upload.staging_buffer);
+
+    // the render thread owns the uploaded buffers from here on, they may move.
+    for (const auto &upload: buffer_uploads) {
+        upload.buffer->pinned = false;
+        destroy_buffer(upload.staging_buffer);
+    }
+
+    free_cmd_buffer(cmd_buffer);
+    texture_uploads.clear();
+    buffer_uploads.clear();
+}
+
+static uint64_t _hash_sampler_info(const RenderDevice::SamplerCreateInfo *p_create_info)
+{
+    uint32_t lod[4];
+    memcpy(&lod[0], &p_create_info->min_lod, sizeof(float));
+    memcpy(&lod[1], &p_create_info->max_lod, sizeof(float));
+    memcpy(&lod[2], &p_create_info->mip_lod_bias, sizeof(float));
+    memcpy(&lod[3], &p_create_info->max_anisotropy, sizeof(float));
+
+    uint64_t words[] = {
+            ((uint64_t) p_create_info->u << 32) | (uint64_t) p_create_info->v,
+            ((uint64_t) p_create_info->w << 32) | (uint64_t) p_create_info->border_color,
+            ((uint64_t) p_create_info->mag_filter << 32) | (uint64_t) p_create_info->min_filter,
+            ((uint64_t) p_create_info->mipmap_mode << 32) | (uint64_t) p_create_info->compare_op,
+            ((uint64_t) lod[0] << 32) | (uint64_t) lod[1],
+            ((uint64_t) lod[2] << 32) | (uint64_t) lod[3],
+            (uint64_t) p_create_info->compare_enable,
+    };
+
+    // fnv-1a over the 64 bit words.
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint64_t word: words)
+        hash = (hash ^ word) * 0x100000001b3ull;
+
+    return hash;
+}
+
+static bool _is_same_sampler_info(const RenderDevice::SamplerCreateInfo *a, const RenderDevice::SamplerCreateInfo *b)
+{
+    return a->u == b->u && a->v == b->v && a->w == b->w && a->border_color == b->border_color &&
+           a->mag_filter == b->mag_filter && a->min_filter == b->min_filter && a->mipmap_mode == b->mipmap_mode &&
+           a->min_lod == b->min_lod && a->max_lod == b->max_lod && a->mip_lod_bias == b->mip_lod_bias &&
+           a->max_anisotropy == b->max_anisotropy && a->compare_enable == b->compare_enable && a->compare_op == b->compare_op;
 }
 
 void RenderDevice::create_sampler(SamplerCreateInfo* p_create_info, VkSampler* p_sampler)
+{
+    std::unique_lock<std::mutex> lock(sampler_mutex);
+
+    std::vector<_CachedSampler *> &bucket = sampler_buckets[_hash_sampler_info(p_create_info)];
+    for (_CachedSampler *cached: bucket) {
+        if (_is_same_sampler_info(&cached->info, p_create_info)) {
+            cached->ref_count++;
+            *p_sampler = cached->sampler;
+            return;
+        }
+    }
+
+    _CachedSampler *cached = memnew(_CachedSampler);
+    cached->info = *p_create_info;
+    cached->sampler = _create_sampler(p_create_info);
+    cached->ref_count = 1;
+
+    bucket.push_back(cached);
+    sampler_cache[cached->sampler] = cached;
+    *p_sampler = cached->sampler;
+}
+
+void RenderDevice::destroy_sampler(VkSampler sampler)
+{
+    std::unique_lock<std::mutex> lock(sampler_mutex);
+
+    auto it = sampler_cache.find(sampler);
+    assert(it != sampler_cache.end());
+
+    _CachedSampler *cached = it->second;
+    if (--cached->ref_count > 0)
+        return;
+
+    std::vector<_CachedSampler *> &bucket = sampler_buckets[_hash_sampler_info(&cached->info)];
+    bucket.erase(std::find(bucket.begin(), bucket.end(), cached));
+    sampler_cache.erase(it);
+    memdel(cached);
+
+    defer_deletion([this, sampler] {
+        vkDestroySampler(vk_device, sampler, allocation_callbacks);
+    });
+}
+
+const VkSampler *RenderDevice::get_immutable_sampler(SamplerCreateInfo *p_create_info)
+{
+    // the extra reference is never released, the destructor takes the sampler.
+    VkSampler sampler;
+    create_sampler(p_create_info, &sampler);
+
+    std::unique_lock<std::mutex> lock(sampler_mutex);
+    return &sampler_cache[sampler]->sampler;
+}
+
+VkSampler RenderDevice::_create_sampler(const SamplerCreateInfo *p_create_info)
 {
     VkSamplerCreateInfo sampler_create_info = {};
     sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    sampler_create_info.magFilter = VK_FILTER_LINEAR;
-    sampler_create_info.minFilter = VK_FILTER_LINEAR;
+    sampler_create_info.magFilter = p_create_info->mag_filter;
+    sampler_create_info.minFilter = p_create_info->min_filter;
     sampler_create_info.addressModeU = p_create_info->u;
     sampler_create_info.addressModeV = p_create_info->v;
     sampler_create_info.addressModeW = p_create_info->w;
-    sampler_create_info.anisotropyEnable = VK_FALSE;
-    sampler_create_info.maxAnisotropy = 16;
     sampler_create_info.borderColor = p_create_info->border_color;
     sampler_create_info.unnormalizedCoordinates = VK_FALSE;
-    sampler_create_info.compareEnable = VK_FALSE;
-    sampler_create_info.compareOp = VK_COMPARE_OP_ALWAYS;
-    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    sampler_create_info.mipLodBias = 0.0f;
-    sampler_create_info.minLod = 0.0f;
-    sampler_create_info.maxLod = 0.0f;
-
-    vkCreateSampler(vk_device, &sampler_create_info, allocation_callbacks, p_sampler);
-}
+    sampler_create_info.compareEnable = p_create_info->compare_enable;
+    sampler_create_info.compareOp = p_create_info->compare_op;
+    sampler_create_info.mipmapMode = p_create_info->mipmap_mode;
+    sampler_create_info.mipLodBias = p_create_info->mip_lod_bias;
+    sampler_create_info.minLod = p_create_info->min_lod;
+    sampler_create_info.maxLod = p_create_info->max_lod;
+
+    // anisotropy needs the device feature, otherwise fall back to plain trilinear.
+    float max_anisotropy = std::min(p_create_info->max_anisotropy, vk_rdc->get_device_limits().maxSamplerAnisotropy);
+    sampler_create_info.anisotropyEnable = vk_rdc->get_enabled_features().samplerAnisotropy && max_anisotropy > 1.0f;
+    sampler_create_info.maxAnisotropy = sampler_create_info.anisotropyEnable ? max_anisotropy : 1.0f;
+
+    VkSampler sampler;
+    VkResult U_ASSERT_ONLY err = vkCreateSampler(vk_device, &sampler_create_info, allocation_callbacks, &sampler);
+    assert(!err);
 
-void RenderDevice::destroy_sampler(VkSampler sampler)
-{
-    vkDestroySampler(vk_device, sampler, allocation_callbacks);
+    return sampler;
 }
 
 void RenderDevice::bind_texture_sampler(RenderDevice::Texture2D *texture, VkSampler sampler)
 {
+    std::unique_lock<std::mutex> lock(binding_mutex);
     texture->sampler = sampler;
+
+    // frames in flight may still sample the old set and slot, the texture takes
+    // new ones with the new sampler on its next use.
+    if (texture->descriptor_set) {
+        free_descriptor_set(texture->descriptor_set);
+        texture->descriptor_set = VK_NULL_HANDLE;
+    }
+
+    if (texture->bindless_index != BINDLESS_INVALID_INDEX) {
+        defer_deletion([this, index = texture->bindless_index] {
+            bindless_table->remove_texture(index);
+        });
+        texture->bindless_index = BINDLESS_INVALID_INDEX;
+    }
 }
 
 void RenderDevice::create_descriptor_set_layout(uint32_t bind_count, VkDescriptorSetLayoutBinding *p_bind, VkDescriptorSetLayout *p_descriptor_set_layout)
@@ -315,25 +1398,102 @@ void RenderDevice::create_descriptor_set_layout(uint32_t bind_count, VkDescripto
 
 void RenderDevice::destroy_descriptor_set_layout(VkDescriptorSetLayout descriptor_set_layout)
 {
-    vkDestroyDescriptorSetLayout(vk_device, descriptor_set_layout, allocation_callbacks);
+    defer_deletion([this, descriptor_set_layout] {
+        vkDestroyDescriptorSetLayout(vk_device, descriptor_set_layout, allocation_callbacks);
+    });
 }
 
 void RenderDevice::allocate_descriptor_set(VkDescriptorSetLayout descriptor_set_layout, VkDescriptorSet *p_descriptor_set)
 {
-    VkDescriptorSetAllocateInfo descriptor_allocate_info = {
-            /* sType */ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    *p_descriptor_set = descriptor_allocator->allocate(descriptor_set_layout);
+}
+
+void RenderDevice::free_descriptor_set(VkDescriptorSet descriptor_set)
+{
+    defer_deletion([this, descriptor_set] {
+        {
+            std::unique_lock<std::mutex> lock(descriptor_write_mutex);
+            auto first = descriptor_writes.lower_bound({ descriptor_set, 0 });
+            auto last = descriptor_writes.upper_bound({ descriptor_set, UINT32_MAX });
+            descriptor_writes.erase(first, last);
+        }
+        descriptor_allocator->free(descriptor_set);
+    });
+}
+
+VkDescriptorSet RenderDevice::get_frame_descriptor_set(VkDescriptorSetLayout descriptor_set_layout, uint32_t binding_count, const DescriptorAllocator::Binding *p_bindings)
+{
+    return descriptor_allocator->get_frame_descriptor_set(frame_index % RENDER_DEVICE_FRAMES_IN_FLIGHT, descriptor_set_layout, binding_count, p_bindings);
+}
+
+VkDescriptorSet RenderDevice::get_frame_texture_descriptor_set(Texture2D *p_texture)
+{
+    DescriptorAllocator::Binding binding = {};
+    binding.binding = 0;
+    binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.sampler = p_texture->sampler;
+    binding.image_view = p_texture->image_view;
+    binding.image_layout = p_texture->image_layout;
+
+    return get_frame_descriptor_set(texture_descriptor_set_layout, 1, &binding);
+}
+
+VkDescriptorSet RenderDevice::get_texture_descriptor_set(Texture2D *p_texture)
+{
+    std::unique_lock<std::mutex> lock(binding_mutex);
+
+    if (!p_texture->descriptor_set) {
+        p_texture->descriptor_set = descriptor_allocator->allocate(texture_descriptor_set_layout);
+        _write_texture_descriptor_set(p_texture);
+    }
+
+    return p_texture->descriptor_set;
+}
+
+void RenderDevice::_write_texture_descriptor_set(Texture2D *p_texture)
+{
+    VkDescriptorImageInfo image_info = {
+            /* sampler= */ p_texture->sampler,
+            /* imageView= */ p_texture->image_view,
+            /* imageLayout= */ RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT,
+    };
+
+    VkWriteDescriptorSet write_info = {
+            /* sType */ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
             /* pNext */ nextptr,
-            /* descriptorPool */ descriptor_pool,
-            /* descriptorSetCount */ 1,
-            /* pSetLayouts */ &descriptor_set_layout,
+            /* dstSet */ p_texture->descriptor_set,
+            /* dstBinding */ 0,
+            /* dstArrayElement */ 0,
+            /* descriptorCount */ 1,
+            /* descriptorType */ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            /* pImageInfo */ &image_info,
+            /* pBufferInfo */ VK_NULL_HANDLE,
+            /* pTexelBufferView */ VK_NULL_HANDLE,
     };
 
-    vkAllocateDescriptorSets(vk_device, &descriptor_allocate_info, p_descriptor_set);
+    vkUpdateDescriptorSets(vk_device, 1, &write_info, 0, nullptr);
 }
 
-void RenderDevice::free_descriptor_set(VkDescriptorSet descriptor_set)
+uint32_t RenderDevice::get_bindless_texture_index(Texture2D *p_texture)
+{
+    std::unique_lock<std::mutex> lock(binding_mutex);
+
+    // textures handed to shaders have finished their upload, the slot is written
+    // with the layout they are sampled in rather than whatever they are in now.
+    if (p_texture->bindless_index == BINDLESS_INVALID_INDEX)
+        p_texture->bindless_index = bindless_table->add_texture(p_texture->sampler, p_texture->image_view, RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT);
+
+    return p_texture->bindless_index;
+}
+
+uint32_t RenderDevice::get_bindless_buffer_index(Buffer *p_buffer)
 {
-    vkFreeDescriptorSets(vk_device, descriptor_pool, 1, &descriptor_set);
+    std::unique_lock<std::mutex> lock(binding_mutex);
+
+    if (p_buffer->bindless_index == BINDLESS_INVALID_INDEX)
+        p_buffer->bindless_index = bindless_table->add_buffer(p_buffer->vk_buffer, 0, p_buffer->size);
+
+    return p_buffer->bindless_index;
 }
 
 void RenderDevice::update_descriptor_set_buffer(Buffer *p_buffer, uint32_t binding, VkDescriptorSet descriptor_set)
@@ -358,6 +1518,57 @@ void RenderDevice::update_descriptor_set_buffer(Buffer *p_buffer, uint32_t bindi
     };
 
     vkUpdateDescriptorSets(vk_device, 1, &write_info, 0, nullptr);
+    _record_descriptor_write(descriptor_set, binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, p_buffer, NULL);
+}
+
+void RenderDevice::update_descriptor_set_storage_buffer(Buffer *p_buffer, uint32_t binding, VkDescriptorSet descriptor_set)
+{
+    VkDescriptorBufferInfo buffer_info = {
+            /* buffer */ p_buffer->vk_buffer,
+            /* offset */ 0,
+            /* range */ p_buffer->size,
+    };
+
+    VkWriteDescriptorSet write_info = {
+            /* sType */ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            /* pNext */ nextptr,
+            /* dstSet */ descriptor_set,
+            /* dstBinding */ binding,
+            /* dstArrayElement */ 0,
+            /* descriptorCount */ 1,
+            /* descriptorType */ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            /* pImageInfo */ VK_NULL_HANDLE,
+            /* pBufferInfo */ &buffer_info,
+            /* pTexelBufferView */ VK_NULL_HANDLE,
+    };
+
+    vkUpdateDescriptorSets(vk_device, 1, &write_info, 0, nullptr);
+    _record_descriptor_write(descriptor_set, binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, p_buffer, NULL);
+}
+
+void RenderDevice::update_descriptor_set_storage_image(Texture2D *p_texture, uint32_t binding, VkDescriptorSet descriptor_set)
+{
+    VkDescriptorImageInfo image_info = {
+            /* sampler= */ VK_NULL_HANDLE,
+            /* imageView= */ p_texture->image_view,
+            /* imageLayout= */ VK_IMAGE_LAYOUT_GENERAL,
+    };
+
+    VkWriteDescriptorSet write_info = {
+            /* sType */ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            /* pNext */ nextptr,
+            /* dstSet */ descriptor_set,
+            /* dstBinding */ binding,
+            /* dstArrayElement */ 0,
+            /* descriptorCount */ 1,
+            /* descriptorType */ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            /* pImageInfo */ &image_info,
+            /* pBufferInfo */ VK_NULL_HANDLE,
+            /* pTexelBufferView */ VK_NULL_HANDLE,
+    };
+
+    vkUpdateDescriptorSets(vk_device, 1, &write_info, 0, nullptr);
+    _record_descriptor_write(descriptor_set, binding, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, NULL, p_texture);
 }
 
 void RenderDevice::update_descriptor_set_image(Texture2D *p_texture, uint32_t binding, VkDescriptorSet descriptor_set)
@@ -382,6 +1593,20 @@ void RenderDevice::update_descriptor_set_image(Texture2D *p_texture, uint32_t bi
     };
 
     vkUpdateDescriptorSets(vk_device, 1, &write_info, 0, nullptr);
+    _record_descriptor_write(descriptor_set, binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, NULL, p_texture);
+}
+
+void RenderDevice::_record_descriptor_write(VkDescriptorSet descriptor_set, uint32_t binding, VkDescriptorType type, Buffer *p_buffer, Texture2D *p_texture)
+{
+    _DescriptorWrite write = {};
+    write.type = type;
+    if (p_buffer != NULL)
+        write.buffer = p_buffer->handle;
+    if (p_texture != NULL)
+        write.texture = p_texture->handle;
+
+    std::unique_lock<std::mutex> lock(descriptor_write_mutex);
+    descriptor_writes[{ descriptor_set, binding }] = write;
 }
 
 RenderDevice::Pipeline *RenderDevice::create_graphics_pipeline(PipelineCreateInfo *p_create_info, ShaderInfo *p_shader_info)
@@ -541,9 +1766,21 @@ RenderDevice::Pipeline *RenderDevice::create_graphics_pipeline(PipelineCreateInf
             /* pDynamicStates= */ std::data(dynamics),
     };
 
+    const FramebufferFormat *framebuffer_format = &p_create_info->framebuffer_format;
+
+    VkPipelineRenderingCreateInfo rendering_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+            /* pNext */ nextptr,
+            /* viewMask */ 0,
+            /* colorAttachmentCount */ framebuffer_format->color_format != VK_FORMAT_UNDEFINED ? 1u : 0u,
+            /* pColorAttachmentFormats */ &framebuffer_format->color_format,
+            /* depthAttachmentFormat */ framebuffer_format->depth_format,
+            /* stencilAttachmentFormat */ framebuffer_format->stencil_format,
+    };
+
     VkGraphicsPipelineCreateInfo pipeline_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-            /* pNext */ nextptr,
+            /* pNext */ &rendering_create_info,
             /* flags */ no_flag_bits,
             /* stageCount */ ARRAY_SIZE(shader_stages_info),
             /* pStages */ shader_stages_info,
@@ -557,7 +1794,7 @@ RenderDevice::Pipeline *RenderDevice::create_graphics_pipeline(PipelineCreateInf
             /* pColorBlendState */ &color_blend_state_create_info,
             /* pDynamicState */ &dynamic_state_crate_info,
             /* layout */ vk_pipeline_layout,
-            /* renderPass */ p_create_info->render_pass,
+            /* renderPass */ VK_NULL_HANDLE,
             /* subpass */ 0,
             /* basePipelineHandle */ VK_NULL_HANDLE,
             /* basePipelineIndex */ -1,
@@ -567,7 +1804,9 @@ RenderDevice::Pipeline *RenderDevice::create_graphics_pipeline(PipelineCreateInf
     err = vkCreateGraphicsPipelines(vk_device, nullptr, 1, &pipeline_create_info, allocation_callbacks, &vk_pipeline);
     assert(!err);
 
-    Pipeline *p_pipeline = (Pipeline*) imalloc(sizeof(Pipeline));
+    PipelineHandle handle;
+    Pipeline *p_pipeline = pipeline_pool.allocate(&handle);
+    p_pipeline->handle = handle;
     p_pipeline->pipeline = vk_pipeline;
     p_pipeline->layout = vk_pipeline_layout;
     p_pipeline->bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
@@ -578,40 +1817,47 @@ RenderDevice::Pipeline *RenderDevice::create_graphics_pipeline(PipelineCreateInf
     return p_pipeline;
 }
 
-void RenderDevice::_initialize_descriptor_pool()
+void RenderDevice::_initialize_descriptor_pools()
 {
     VkResult U_ASSERT_ONLY err;
 
+    descriptor_allocator = memnew(DescriptorAllocator, vk_device, RENDER_DEVICE_FRAMES_IN_FLIGHT);
+    bindless_table = memnew(BindlessTable, vk_rdc);
+
+    // the imgui backend only allocates combined image samplers for its font and
+    // the editor icons.
     VkDescriptorPoolSize pool_size[] = {
-            { VK_DESCRIPTOR_TYPE_SAMPLER,                256 },
             { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 256 },
-            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          256 },
-            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          256 },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   256 },
-            { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   256 },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         256 },
-            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         256 },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 256 },
-            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 256 },
-            { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       256 },
     };
 
     VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
             /* pNext */ nextptr,
             /* flags */ VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
-            /* maxSets */ 1024,
+            /* maxSets */ 256,
             /* poolSizeCount */ ARRAY_SIZE(pool_size),
             /* pPoolSizes */ pool_size,
     };
 
-    err = vkCreateDescriptorPool(vk_device, &descriptor_pool_create_info, allocation_callbacks, &descriptor_pool);
+    err = vkCreateDescriptorPool(vk_device, &descriptor_pool_create_info, allocation_callbacks, &external_descriptor_pool);
     assert(!err);
+
+    VkDescriptorSetLayoutBinding texture_binding = {
+            /* binding */ 0,
+            /* descriptorType */ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            /* descriptorCount */ 1,
+            /* stageFlags */ VK_SHADER_STAGE_FRAGMENT_BIT,
+            /* pImmutableSamplers */ nullptr,
+    };
+
+    create_descriptor_set_layout(1, &texture_binding, &texture_descriptor_set_layout);
 }
 
 RenderDevice::Pipeline *RenderDevice::create_compute_pipeline(RenderDevice::ComputeShaderInfo *p_shader_info)
 {
-    Pipeline *pipeline = (Pipeline *) imalloc(sizeof(Pipeline));
+    PipelineHandle handle;
+    Pipeline *pipeline = pipeline_pool.allocate(&handle);
+    pipeline->handle = handle;
     pipeline->bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
 
     VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
@@ -626,7 +1872,7 @@ RenderDevice::Pipeline *RenderDevice::create_compute_pipeline(RenderDevice::Comp
     vkCreatePipelineLayout(vk_device, &pipeline_layout_create_info, allocation_callbacks, &pipeline->layout);
 
     VkShaderModule compute_shader_module;
-    compute_shader_module = load_shader_module(vk_device, p_shader_info->compute, "vert");
+    compute_shader_module = load_shader_module(vk_device, p_shader_info->compute, "comp");
 
     VkPipelineShaderStageCreateInfo shader_stage_create_info = {};
     shader_stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -647,8 +1893,16 @@ RenderDevice::Pipeline *RenderDevice::create_compute_pipeline(RenderDevice::Comp
 
 void RenderDevice::destroy_pipeline(Pipeline *p_pipeline)
 {
-    vkDestroyPipelineLayout(vk_device, p_pipeline->layout, allocation_callbacks);
-    vkDestroyPipeline(vk_device, p_pipeline->pipeline, allocation_callbacks);
+#ifndef NDEBUG
+    // a destroy after the deferred release, caught until the slot is reused.
+    EXIT_FAIL_COND_V(pipeline_pool.is_valid(p_pipeline->handle), "-engine error: destroy of a released pipeline 0x%08x!\n", p_pipeline->handle.value);
+#endif
+
+    defer_deletion([this, p_pipeline, handle = p_pipeline->handle] {
+        vkDestroyPipeline(vk_device, p_pipeline->pipeline, allocation_callbacks);
+        vkDestroyPipelineLayout(vk_device, p_pipeline->layout, allocation_callbacks);
+        pipeline_pool.free(handle);
+    });
 }
 
 void RenderDevice::cmd_buffer_begin(VkCommandBuffer cmd_buffer, VkCommandBufferUsageFlags usage)
@@ -660,11 +1914,52 @@ void RenderDevice::cmd_buffer_begin(VkCommandBuffer cmd_buffer, VkCommandBufferU
             /* pInheritanceInfo */ nullptr,
     };
     vkBeginCommandBuffer(cmd_buffer, &cmd_buffer_begin_info);
+    cmd_invalidate_state(cmd_buffer);
+}
+
+void RenderDevice::cmd_buffer_begin_secondary(VkCommandBuffer cmd_buffer, FramebufferFormat *p_framebuffer_format, VkSampleCountFlagBits samples)
+{
+    VkCommandBufferInheritanceRenderingInfo inheritance_rendering_info = {
+            /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+            /* pNext */ nextptr,
+            /* flags */ no_flag_bits,
+            /* viewMask */ 0,
+            /* colorAttachmentCount */ p_framebuffer_format->color_format != VK_FORMAT_UNDEFINED ? 1u : 0u,
+            /* pColorAttachmentFormats */ &p_framebuffer_format->color_format,
+            /* depthAttachmentFormat */ p_framebuffer_format->depth_format,
+            /* stencilAttachmentFormat */ p_framebuffer_format->stencil_format,
+            /* rasterizationSamples */ samples,
+    };
+
+    VkCommandBufferInheritanceInfo inheritance_info = {
+            /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            /* pNext */ &inheritance_rendering_info,
+            /* renderPass */ VK_NULL_HANDLE,
+            /* subpass */ 0,
+            /* framebuffer */ VK_NULL_HANDLE,
+            /* occlusionQueryEnable */ VK_FALSE,
+            /* queryFlags */ no_flag_bits,
+            /* pipelineStatistics */ no_flag_bits,
+    };
+
+    VkCommandBufferBeginInfo cmd_buffer_begin_info = {
+            /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            /* pNext */ nextptr,
+            /* flags */ VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+            /* pInheritanceInfo */ &inheritance_info,
+    };
+    vkBeginCommandBuffer(cmd_buffer, &cmd_buffer_begin_info);
+    cmd_invalidate_state(cmd_buffer);
 }
 
 void RenderDevice::cmd_buffer_end(VkCommandBuffer cmd_buffer)
 {
     vkEndCommandBuffer(cmd_buffer);
+
+    if (cmd_state.cmd_buffer == cmd_buffer) {
+        _flush_cmd_state_stats(&cmd_state);
+        cmd_state = {};
+    }
 }
 
 void RenderDevice::cmd_buffer_one_time_begin(VkCommandBuffer *p_cmd_buffer)
@@ -675,74 +1970,119 @@ void RenderDevice::cmd_buffer_one_time_begin(VkCommandBuffer *p_cmd_buffer)
     *p_cmd_buffer = cmd_buffer;
 }
 
-void RenderDevice::cmd_buffer_one_time_end(VkCommandBuffer cmd_buffer)
+void RenderDevice::cmd_pipeline_barrier(VkCommandBuffer cmd_buffer, const PipelineMemoryBarrier *p_pipeline_memory_barrier)
 {
-    cmd_buffer_end(cmd_buffer);
+    BarrierBuilder barriers;
+    Texture2D *texture = p_pipeline_memory_barrier->image.texture;
 
-    VkQueue graph_queue = vk_rdc->get_graph_queue();
-    cmd_buffer_submit(cmd_buffer,
-        0, VK_NULL_HANDLE,
-        0, VK_NULL_HANDLE,
-        VK_NULL_HANDLE,
-        graph_queue,
-        VK_NULL_HANDLE);
-    vkQueueWaitIdle(graph_queue);
+    barriers.image_range(texture, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS,
+                         p_pipeline_memory_barrier->image.old_image_layout, p_pipeline_memory_barrier->image.new_image_layout,
+                         p_pipeline_memory_barrier->image.src_stage_mask, p_pipeline_memory_barrier->image.src_access_mask,
+                         p_pipeline_memory_barrier->image.dst_stage_mask, p_pipeline_memory_barrier->image.dst_access_mask);
+    barriers.flush(cmd_buffer);
 
-    free_cmd_buffer(cmd_buffer);
+    texture->image_layout = p_pipeline_memory_barrier->image.new_image_layout;
 }
 
-void RenderDevice::cmd_begin_render_pass(VkCommandBuffer cmd_buffer, VkRenderPass render_pass, uint32_t clear_value_count, VkClearValue *p_clear_values, VkFramebuffer framebuffer, VkRect2D *p_rect)
+static void _rendering_attachment_info(const RenderDevice::RenderingAttachment *p_attachment, VkRenderingAttachmentInfo *p_info)
 {
-    VkRenderPassBeginInfo render_pass_begin_info = {
-            /* sType */ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+    *p_info = {
+            /* sType */ VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
             /* pNext */ nextptr,
-            /* renderPass */ render_pass,
-            /* framebuffer */ framebuffer,
+            /* imageView */ p_attachment->image_view,
+            /* imageLayout */ p_attachment->image_layout,
+            /* resolveMode */ p_attachment->resolve_mode,
+            /* resolveImageView */ p_attachment->resolve_image_view,
+            /* resolveImageLayout */ p_attachment->resolve_image_layout,
+            /* loadOp */ p_attachment->load_op,
+            /* storeOp */ p_attachment->store_op,
+            /* clearValue */ p_attachment->clear_value,
+    };
+}
+
+void RenderDevice::cmd_begin_rendering(VkCommandBuffer cmd_buffer, VkRect2D *p_rect, uint32_t color_attachment_count, RenderingAttachment *p_color_attachments, RenderingAttachment *p_depth_attachment, RenderingAttachment *p_stencil_attachment, VkRenderingFlags flags)
+{
+    std::vector<VkRenderingAttachmentInfo> color_attachments(color_attachment_count);
+    for (uint32_t i = 0; i < color_attachment_count; i++)
+        _rendering_attachment_info(&p_color_attachments[i], &color_attachments[i]);
+
+    VkRenderingAttachmentInfo depth_attachment;
+    if (p_depth_attachment != NULL)
+        _rendering_attachment_info(p_depth_attachment, &depth_attachment);
+
+    VkRenderingAttachmentInfo stencil_attachment;
+    if (p_stencil_attachment != NULL)
+        _rendering_attachment_info(p_stencil_attachment, &stencil_attachment);
+
+    VkRenderingInfo rendering_info = {
+            /* sType */ VK_STRUCTURE_TYPE_RENDERING_INFO,
+            /* pNext */ nextptr,
+            /* flags */ flags,
             /* renderArea */ *p_rect,
-            /* clearValueCount */ clear_value_count,
-            /* pClearValues */ p_clear_values,
+            /* layerCount */ 1,
+            /* viewMask */ 0,
+            /* colorAttachmentCount */ color_attachment_count,
+            /* pColorAttachments */ std::data(color_attachments),
+            /* pDepthAttachment */ p_depth_attachment != NULL ? &depth_attachment : nullptr,
+            /* pStencilAttachment */ p_stencil_attachment != NULL ? &stencil_attachment : nullptr,
     };
 
-    vkCmdBeginRenderPass(cmd_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRendering(cmd_buffer, &rendering_info);
 }
 
-void RenderDevice::cmd_pipeline_barrier(VkCommandBuffer cmd_buffer, const PipelineMemoryBarrier *p_pipeline_memory_barrier)
+void RenderDevice::cmd_end_rendering(VkCommandBuffer cmd_buffer)
+{
+    vkCmdEndRendering(cmd_buffer);
+}
+
+void RenderDevice::cmd_execute_commands(VkCommandBuffer cmd_buffer, uint32_t cmd_buffer_count, VkCommandBuffer *p_cmd_buffers)
 {
-    VkImageMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.srcAccessMask = p_pipeline_memory_barrier->image.src_access_mask;
-    barrier.dstAccessMask = p_pipeline_memory_barrier->image.dst_access_mask;
-    barrier.oldLayout = p_pipeline_memory_barrier->image.old_image_layout;
-    barrier.newLayout = p_pipeline_memory_barrier->image.new_image_layout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = p_pipeline_memory_barrier->image.texture->image;
-    barrier.subresourceRange.aspectMask = p_pipeline_memory_barrier->image.texture->aspect_mask;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    vkCmdExecuteCommands(cmd_buffer, cmd_buffer_count, p_cmd_buffers);
 
-    vkCmdPipelineBarrier(
-            cmd_buffer,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-            0,
-            0, VK_NULL_HANDLE,
-            0, VK_NULL_HANDLE,
-            1, &barrier
-    );
+    // the primary state is undefined after secondary buffers ran.
+    cmd_invalidate_state(cmd_buffer);
+}
 
-    p_pipeline_memory_barrier->image.texture->image_layout = barrier.newLayout;
+void RenderDevice::cmd_invalidate_state(VkCommandBuffer cmd_buffer)
+{
+    _flush_cmd_state_stats(&cmd_state);
+    cmd_state = {};
+    cmd_state.cmd_buffer = cmd_buffer;
 }
 
-void RenderDevice::cmd_end_render_pass(VkCommandBuffer cmd_buffer)
+RenderDevice::_CmdState *RenderDevice::_get_cmd_state(VkCommandBuffer cmd_buffer)
 {
-    vkCmdEndRenderPass(cmd_buffer);
+    if (cmd_state.cmd_buffer != cmd_buffer)
+        cmd_invalidate_state(cmd_buffer);
+    return &cmd_state;
+}
+
+void RenderDevice::_flush_cmd_state_stats(_CmdState *state)
+{
+    const CmdStateStats &skipped = state->skipped;
+    if (skipped.pipeline + skipped.descriptor_set + skipped.vertex_buffer + skipped.index_buffer + skipped.viewport + skipped.push_const == 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(cmd_state_mutex);
+    frame_skipped_cmd_stats.pipeline += skipped.pipeline;
+    frame_skipped_cmd_stats.descriptor_set += skipped.descriptor_set;
+    frame_skipped_cmd_stats.vertex_buffer += skipped.vertex_buffer;
+    frame_skipped_cmd_stats.index_buffer += skipped.index_buffer;
+    frame_skipped_cmd_stats.viewport += skipped.viewport;
+    frame_skipped_cmd_stats.push_const += skipped.push_const;
+    state->skipped = {};
 }
 
 void RenderDevice::cmd_bind_vertex_buffer(VkCommandBuffer cmd_buffer, RenderDevice::Buffer *p_buffer)
 {
+    _CmdState *state = _get_cmd_state(cmd_buffer);
+    if (state->vertex_buffer == p_buffer->vk_buffer) {
+        state->skipped.vertex_buffer++;
+        return;
+    }
+
+    state->vertex_buffer = p_buffer->vk_buffer;
+
     VkBuffer buffers[] = { p_buffer->vk_buffer };
     VkDeviceSize offsets[] = { 0 };
     vkCmdBindVertexBuffers(cmd_buffer, 0, ARRAY_SIZE(buffers), buffers, offsets);
@@ -750,6 +2090,14 @@ void RenderDevice::cmd_bind_vertex_buffer(VkCommandBuffer cmd_buffer, RenderDevi
 
 void RenderDevice::cmd_bind_index_buffer(VkCommandBuffer cmd_buffer, VkIndexType type, RenderDevice::Buffer *p_buffer)
 {
+    _CmdState *state = _get_cmd_state(cmd_buffer);
+    if (state->index_buffer == p_buffer->vk_buffer && state->index_type == type) {
+        state->skipped.index_buffer++;
+        return;
+    }
+
+    state->index_buffer = p_buffer->vk_buffer;
+    state->index_type = type;
     vkCmdBindIndexBuffer(cmd_buffer, p_buffer->vk_buffer, 0, type);
 }
 
@@ -763,42 +2111,182 @@ void RenderDevice::cmd_draw_indexed(VkCommandBuffer cmd_buffer, uint32_t index_c
     vkCmdDrawIndexed(cmd_buffer, index_count, 1, 0, 0, 0);
 }
 
+void RenderDevice::cmd_dispatch(VkCommandBuffer cmd_buffer, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z)
+{
+    vkCmdDispatch(cmd_buffer, group_count_x, group_count_y, group_count_z);
+}
+
+void RenderDevice::cmd_dispatch_indirect(VkCommandBuffer cmd_buffer, Buffer *p_buffer, VkDeviceSize offset)
+{
+    vkCmdDispatchIndirect(cmd_buffer, p_buffer->vk_buffer, offset);
+}
+
 void RenderDevice::cmd_bind_pipeline(VkCommandBuffer cmd_buffer, Pipeline *p_pipeline)
 {
+    _CmdState *state = _get_cmd_state(cmd_buffer);
+    VkPipeline *bound = &state->pipelines[p_pipeline->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE];
+    if (*bound == p_pipeline->pipeline) {
+        state->skipped.pipeline++;
+        return;
+    }
+
+    *bound = p_pipeline->pipeline;
+
+    // push constants do not survive a pipeline of another layout.
+    if (state->push_const_layout != p_pipeline->layout)
+        state->push_const_layout = VK_NULL_HANDLE;
+
     vkCmdBindPipeline(cmd_buffer, p_pipeline->bind_point, p_pipeline->pipeline);
 }
 
-void RenderDevice::cmd_buffer_submit(VkCommandBuffer cmd_buffer, uint32_t wait_semaphore_count, VkSemaphore *p_wait_semaphore, uint32_t signal_semaphore_count, VkSemaphore *p_signal_semaphore, VkPipelineStageFlags *p_mask, VkQueue queue, VkFence fence)
+uint64_t RenderDevice::cmd_buffer_submit(VkCommandBuffer cmd_buffer, uint32_t wait_semaphore_count, VkSemaphore *p_wait_semaphore, uint32_t signal_semaphore_count, VkSemaphore *p_signal_semaphore, VkPipelineStageFlags *p_mask, VkQueue queue, const uint64_t *p_wait_values)
 {
-    VkResult U_ASSERT_ONLY err;
+    _Submission submission;
+    _fill_submission(&submission, cmd_buffer, wait_semaphore_count, p_wait_semaphore, signal_semaphore_count, p_signal_semaphore, p_mask, p_wait_values);
+
+    VkSubmitInfo2 submit_info = _submit_info(&submission);
+    return vk_rdc->queue_submit(_get_queue_type(queue), 1, &submit_info);
+}
+
+void RenderDevice::enqueue_submission(VkCommandBuffer cmd_buffer, uint32_t wait_semaphore_count, VkSemaphore *p_wait_semaphore, uint32_t signal_semaphore_count, VkSemaphore *p_signal_semaphore, VkPipelineStageFlags *p_mask, VkQueue queue, const uint64_t *p_wait_values)
+{
+    std::unique_lock<std::mutex> lock(submission_mutex);
+    std::vector<_Submission> &submissions = pending_submissions[_get_queue_type(queue)];
+
+    // without semaphores in between the command buffer joins the previous submit
+    // info, it executes after that one either way.
+    if (!submissions.empty() && submissions.back().signals.empty() && wait_semaphore_count == 0 && signal_semaphore_count == 0) {
+        VkCommandBufferSubmitInfo cmd_buffer_info = {
+                /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+                /* pNext */ nextptr,
+                /* commandBuffer */ cmd_buffer,
+                /* deviceMask */ 0,
+        };
+
+        submissions.back().cmd_buffers.push_back(cmd_buffer_info);
+        return;
+    }
+
+    submissions.emplace_back();
+    _fill_submission(&submissions.back(), cmd_buffer, wait_semaphore_count, p_wait_semaphore, signal_semaphore_count, p_signal_semaphore, p_mask, p_wait_values);
+}
+
+void RenderDevice::flush_submissions()
+{
+    std::unique_lock<std::mutex> lock(submission_mutex);
+
+    // compute goes first, graphics work of the frame may wait for its values.
+    RenderDeviceContext::QueueType order[] = { RenderDeviceContext::QUEUE_TYPE_COMPUTE, RenderDeviceContext::QUEUE_TYPE_GRAPHICS };
+    for (RenderDeviceContext::QueueType type: order) {
+        std::vector<_Submission> &submissions = pending_submissions[type];
+        if (submissions.empty())
+            continue;
+
+        std::vector<VkSubmitInfo2> submit_infos;
+        for (const auto &submission: submissions)
+            submit_infos.push_back(_submit_info(&submission));
+
+        vk_rdc->queue_submit(type, (uint32_t) std::size(submit_infos), std::data(submit_infos));
+        submissions.clear();
+    }
+}
 
-    uint32_t cmd_buffer_count;
-    VkCommandBuffer cmd_buffers[] = { cmd_buffer };
-    cmd_buffer_count = cmd_buffer ? ARRAY_SIZE(cmd_buffers) : 0;
+void RenderDevice::_fill_submission(_Submission *p_submission, VkCommandBuffer cmd_buffer, uint32_t wait_semaphore_count, VkSemaphore *p_wait_semaphore, uint32_t signal_semaphore_count, VkSemaphore *p_signal_semaphore, VkPipelineStageFlags *p_mask, const uint64_t *p_wait_values)
+{
+    if (cmd_buffer) {
+        p_submission->cmd_buffers.push_back({
+                /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+                /* pNext */ nextptr,
+                /* commandBuffer */ cmd_buffer,
+                /* deviceMask */ 0,
+        });
+    }
+
+    // the legacy stage bits keep their values in the 2 variant.
+    for (uint32_t i = 0; i < wait_semaphore_count; i++) {
+        p_submission->waits.push_back({
+                /* sType */ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                /* pNext */ nextptr,
+                /* semaphore */ p_wait_semaphore[i],
+                /* value */ p_wait_values != NULL ? p_wait_values[i] : 0,
+                /* stageMask */ p_mask != NULL ? (VkPipelineStageFlags2) p_mask[i] : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                /* deviceIndex */ 0,
+        });
+    }
+
+    for (uint32_t i = 0; i < signal_semaphore_count; i++) {
+        p_submission->signals.push_back({
+                /* sType */ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+                /* pNext */ nextptr,
+                /* semaphore */ p_signal_semaphore[i],
+                /* value */ 0,
+                /* stageMask */ VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                /* deviceIndex */ 0,
+        });
+    }
+}
 
-    VkSubmitInfo submit_info = {
-            /* sType */ VK_STRUCTURE_TYPE_SUBMIT_INFO,
+VkSubmitInfo2 RenderDevice::_submit_info(const _Submission *p_submission)
+{
+    VkSubmitInfo2 submit_info = {
+            /* sType */ VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
             /* pNext */ nextptr,
-            /* waitSemaphoreCount */ wait_semaphore_count,
-            /* pWaitSemaphores */ p_wait_semaphore,
-            /* pWaitDstStageMask */ p_mask,
-            /* commandBufferCount */ cmd_buffer_count,
-            /* pCommandBuffers */ cmd_buffers,
-            /* signalSemaphoreCount */ signal_semaphore_count,
-            /* pSignalSemaphores */ p_signal_semaphore,
+            /* flags */ no_flag_bits,
+            /* waitSemaphoreInfoCount */ (uint32_t) std::size(p_submission->waits),
+            /* pWaitSemaphoreInfos */ std::data(p_submission->waits),
+            /* commandBufferInfoCount */ (uint32_t) std::size(p_submission->cmd_buffers),
+            /* pCommandBufferInfos */ std::data(p_submission->cmd_buffers),
+            /* signalSemaphoreInfoCount */ (uint32_t) std::size(p_submission->signals),
+            /* pSignalSemaphoreInfos */ std::data(p_submission->signals),
     };
 
-    err = vkQueueSubmit(queue, 1, &submit_info, fence);
-    assert(!err);
+    return submit_info;
 }
 
 void RenderDevice::cmd_bind_descriptor_set(VkCommandBuffer cmd_buffer, Pipeline *p_pipeline, VkDescriptorSet descriptor)
 {
+    _CmdState *state = _get_cmd_state(cmd_buffer);
+    uint32_t index = p_pipeline->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE;
+    if (state->descriptor_sets[index] == descriptor && state->descriptor_set_layouts[index] == p_pipeline->layout) {
+        state->skipped.descriptor_set++;
+        return;
+    }
+
+    // binding set 0 with another layout may disturb the sets above it.
+    if (state->descriptor_set_layouts[index] != p_pipeline->layout)
+        state->bindless_layouts[index] = VK_NULL_HANDLE;
+
+    state->descriptor_sets[index] = descriptor;
+    state->descriptor_set_layouts[index] = p_pipeline->layout;
     vkCmdBindDescriptorSets(cmd_buffer, p_pipeline->bind_point, p_pipeline->layout, 0, 1, &descriptor, 0, VK_NULL_HANDLE);
 }
 
+void RenderDevice::cmd_bind_bindless_descriptor_set(VkCommandBuffer cmd_buffer, Pipeline *p_pipeline)
+{
+    _CmdState *state = _get_cmd_state(cmd_buffer);
+    uint32_t index = p_pipeline->bind_point == VK_PIPELINE_BIND_POINT_COMPUTE;
+    if (state->bindless_layouts[index] == p_pipeline->layout) {
+        state->skipped.descriptor_set++;
+        return;
+    }
+
+    state->bindless_layouts[index] = p_pipeline->layout;
+
+    VkDescriptorSet descriptor = bindless_table->get_descriptor_set();
+    vkCmdBindDescriptorSets(cmd_buffer, p_pipeline->bind_point, p_pipeline->layout, RENDER_DEVICE_BINDLESS_SET, 1, &descriptor, 0, VK_NULL_HANDLE);
+}
+
 void RenderDevice::cmd_setval_viewport(VkCommandBuffer cmd_buffer, uint32_t w, uint32_t h)
 {
+    _CmdState *state = _get_cmd_state(cmd_buffer);
+    if (state->viewport_width == w && state->viewport_height == h) {
+        state->skipped.viewport++;
+        return;
+    }
+
+    state->viewport_width = w;
+    state->viewport_height = h;
+
     VkViewport viewport = {};
     viewport.x = 0;
     viewport.y = 0;
@@ -816,10 +2304,27 @@ void RenderDevice::cmd_setval_viewport(VkCommandBuffer cmd_buffer, uint32_t w, u
 
 void RenderDevice::cmd_push_const(VkCommandBuffer cmd_buffer, RenderDevice::Pipeline *pipeline, VkShaderStageFlags shader_stage_flags, uint32_t offset, uint32_t size, void *p_values)
 {
+    _CmdState *state = _get_cmd_state(cmd_buffer);
+    if (state->push_const_layout == pipeline->layout && state->push_const_stages == shader_stage_flags &&
+        state->push_const_offset == offset && state->push_const_size == size && memcmp(state->push_const, p_values, size) == 0) {
+        state->skipped.push_const++;
+        return;
+    }
+
+    if (size <= RENDER_DEVICE_MAX_PUSH_CONST_SIZE) {
+        state->push_const_layout = pipeline->layout;
+        state->push_const_stages = shader_stage_flags;
+        state->push_const_offset = offset;
+        state->push_const_size = size;
+        memcpy(state->push_const, p_values, size);
+    } else {
+        state->push_const_layout = VK_NULL_HANDLE;
+    }
+
     vkCmdPushConstants(cmd_buffer, pipeline->layout, shader_stage_flags, offset, size, p_values);
 }
 
-void RenderDevice::present(VkQueue queue, VkSwapchainKHR swap_chain, uint32_t index, VkSemaphore wait_semaphore)
+void RenderDevice::present(VkSwapchainKHR swap_chain, uint32_t index, VkSemaphore wait_semaphore)
 {
     VkPresentInfoKHR present_info = {
             /* sType */ VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -832,6 +2337,5 @@ void RenderDevice::present(VkQueue queue, VkSwapchainKHR swap_chain, uint32_t in
             /* pResults */ VK_NULL_HANDLE,
     };
 
-    vkQueuePresentKHR(queue, &present_info);
-    vkQueueWaitIdle(queue);
+    vk_rdc->queue_present(&present_info);
 }
\ No newline at end of file
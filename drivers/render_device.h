@@ -24,34 +24,115 @@
 #define _RENDERING_DEVICE_DRIVER_VULKAN_H
 
 #include "render_device_context.h"
+#include "descriptor_allocator.h"
+#include "bindless_table.h"
+#include "resource_pool.h"
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+// enough for a 32768 x 32768 texture.
+#define TEXTURE_MAX_MIP_LEVELS 16
+
+// largest push constant block the state tracker compares, the guaranteed minimum
+// of maxPushConstantsSize.
+#define RENDER_DEVICE_MAX_PUSH_CONST_SIZE 128
+
+// frames the cpu may record ahead of the gpu. the command pools, frame descriptor
+// sets and timeline values are already kept per slot, but the uniform buffers the
+// renderers write every frame are not. with 1 begin_frame waits for the previous
+// frame to finish, so the cpu and gpu do not overlap yet. raise it once those
+// buffers are ringed per slot.
+#define RENDER_DEVICE_FRAMES_IN_FLIGHT 1
+
+// layout of every sampled image, the descriptors and the bindless table are written
+// with it and the render graph leaves sampled reads in it.
+#define RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+
+// set index of the bindless table in pipeline layouts that use it.
+#define RENDER_DEVICE_BINDLESS_SET 1
+
+// limits of one defragmentation pass. at most one pass per frame copies, it ends once
+// that frame has retired. a finished defragmentation starts over after the interval.
+#define RENDER_DEVICE_DEFRAGMENTATION_BYTES_PER_PASS (16ull * 1024 * 1024)
+#define RENDER_DEVICE_DEFRAGMENTATION_ALLOCATIONS_PER_PASS 64
+#define RENDER_DEVICE_DEFRAGMENTATION_INTERVAL 600
+
 class RenderDevice {
 public:
     RenderDevice(RenderDeviceContext *driver_context);
     ~RenderDevice();
 
     RenderDeviceContext *get_device_context() { return vk_rdc; }
-    VkDescriptorPool get_descriptor_pool() { return descriptor_pool; }
+    // fixed pool for libraries that allocate their own sets, e.g. the imgui backend.
+    VkDescriptorPool get_external_descriptor_pool() { return external_descriptor_pool; }
     VkFormat get_surface_format() { return vk_rdc->get_window_format(); }
     VkSampleCountFlagBits get_msaa_samples() { return msaa_sample_counts; }
+    // transient attachments are placed in lazily allocated memory when the device has it.
+    bool has_lazily_allocated_memory() { return lazily_allocated_memory; }
+    bool is_format_sampled_filterable(VkFormat format);
+    bool is_format_blit_filterable(VkFormat format);
+
+    // frame pacing. begin_frame blocks until the frame slot is free again and releases
+    // every deferred deletion of a retired frame, end_frame records the timeline
+    // values of all queues the frame has to reach.
+    void begin_frame();
+    void end_frame();
+    uint64_t get_frame_index() { return frame_index; }
+    // waits for the device and releases every deferred deletion, e.g. before shutdown.
+    void wait_idle();
+    // runs v_deletion once the frame being recorded has retired on the gpu, every
+    // destroy_xxx() goes through here.
+    void defer_deletion(std::function<void()> v_deletion);
 
+    // resources live in pooled storage owned by the device, the pointers stay valid
+    // until the deferred destroy has run. only the handles detect use after that, a
+    // pointer kept longer silently aliases whatever reuses the slot. code that can
+    // outlive a resource keeps its handle and resolves it through get_xxx().
     struct Buffer {
         VkBuffer vk_buffer;
         VkDeviceSize size;
+        VkBufferUsageFlags usage;
         VmaAllocation allocation;
         VmaAllocationInfo allocation_info;
+        bool pinned = true; /* never moved by defragmentation, cleared once the upload hands a device buffer over */
+        uint32_t bindless_index = BINDLESS_INVALID_INDEX;
+        ResourceHandle<Buffer> handle;
     };
 
+    typedef ResourceHandle<Buffer> BufferHandle;
+
     Buffer *create_buffer(VkBufferUsageFlags usage, VkDeviceSize size);
+    // device local storage buffer, shared by the graphics and compute queues without
+    // ownership transfers. the cpu can not map it.
+    Buffer *create_storage_buffer(VkBufferUsageFlags usage, VkDeviceSize size);
+    // device local buffer for static data, e.g. vertices and indices. the cpu can not
+    // map it, fill it through enqueue_buffer_upload.
+    Buffer *create_device_buffer(VkBufferUsageFlags usage, VkDeviceSize size);
     void destroy_buffer(Buffer *p_buffer);
+    void destroy_buffer(BufferHandle handle) { if (Buffer *buffer = buffer_pool.get(handle)) destroy_buffer(buffer); }
     void write_buffer(Buffer *buffer, VkDeviceSize offset, VkDeviceSize size, void *buf);
     void read_buffer(Buffer *buffer, VkDeviceSize offset, VkDeviceSize size, void *buf);
 
-    void create_render_pass(uint32_t attachment_count, VkAttachmentDescription *p_attachments, uint32_t subpass_count, VkSubpassDescription *p_subpass, uint32_t dependency_count, VkSubpassDependency *p_dependencies, VkRenderPass *p_render_pass);
-    void destroy_render_pass(VkRenderPass render_pass);
     void allocate_cmd_buffer(VkCommandBuffer *p_cmd_buffer);
     void free_cmd_buffer(VkCommandBuffer cmd_buffer);
+    // command buffers of the frame being recorded, every thread records into pools
+    // of its own. the pools of a frame are reset together in begin_frame once the
+    // frame has retired, the buffers are never freed one by one.
+    VkCommandBuffer allocate_frame_cmd_buffer(VkCommandBufferLevel level);
+    // primary command buffer of the frame for the compute queue, which is the
+    // graphics queue when the device has no dedicated compute family.
+    VkCommandBuffer allocate_frame_compute_cmd_buffer();
+    // submits to the compute queue and returns its compute timeline value, graphics
+    // work depending on it waits for the value on get_timeline_semaphore(QUEUE_TYPE_COMPUTE).
+    uint64_t submit_async_compute(VkCommandBuffer cmd_buffer);
+    bool is_async_compute_supported() { return vk_rdc->is_async_compute_supported(); }
 
     struct Texture2D {
         VkImage image;
@@ -66,8 +147,20 @@ public:
         VkSampler sampler = VK_NULL_HANDLE;
         VkImageAspectFlags aspect_mask;
         size_t size = 0;
+        uint32_t mip_levels;
+        uint32_t array_layers;
+        VkImageUsageFlags usage;
+        VkSampleCountFlagBits samples;
+        VkImageType image_type;
+        VkImageViewType image_view_type;
+        bool aliasing = false; /* memory is owned by whoever passed the allocation */
+        bool pinned = false; /* never moved by defragmentation, e.g. views handed to imgui */
+        uint32_t bindless_index = BINDLESS_INVALID_INDEX;
+        ResourceHandle<Texture2D> handle;
     };
 
+    typedef ResourceHandle<Texture2D> TextureHandle;
+
     struct TextureCreateInfo {
         uint32_t width;
         uint32_t height;
@@ -77,31 +170,167 @@ public:
         VkImageType image_type;
         VkImageViewType image_view_type;
         VkImageUsageFlags usage;
+        uint32_t mip_levels = 1;
+        uint32_t array_layers = 1;
     };
 
+    static uint32_t get_mip_level_count(uint32_t width, uint32_t height)
+      {
+        uint32_t levels = 1;
+        for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+            levels++;
+        return levels;
+      }
+
     Texture2D *create_texture(TextureCreateInfo *p_create_info);
+    // aliasing textures are bound to memory shared with other textures whose
+    // lifetimes do not overlap, destroy_texture leaves the allocation alone.
+    Texture2D *create_aliasing_texture(TextureCreateInfo *p_create_info, VmaAllocation allocation);
+    void get_texture_memory_requirements(TextureCreateInfo *p_create_info, VkMemoryRequirements *p_requirements);
+    VmaAllocation allocate_memory(const VkMemoryRequirements *p_requirements);
+    void free_memory(VmaAllocation allocation);
     void destroy_texture(Texture2D *p_texture);
-    void write_texture(Texture2D *texture, size_t size, void *pixels);
-    void create_framebuffer(uint32_t width, uint32_t height, uint32_t image_view_count, VkImageView *p_image_view, VkRenderPass render_pass, VkFramebuffer *p_framebuffer);
-    void destroy_framebuffer(VkFramebuffer framebuffer);
+    void destroy_texture(TextureHandle handle) { if (Texture2D *texture = texture_pool.get(handle)) destroy_texture(texture); }
+
+    struct ReadbackResult {
+        std::vector<uint8_t> data;
+        uint32_t width = 0; /* extent of a texture readback, rows are tightly packed */
+        uint32_t height = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+    };
+
+    // asynchronous readback. the copy into host cached memory is recorded into
+    // cmd_buffer, which has to be submitted in the frame being recorded, and the
+    // future is resolved once that frame has retired. nothing waits on the gpu.
+    std::future<ReadbackResult> cmd_readback_buffer(VkCommandBuffer cmd_buffer, Buffer *p_buffer, VkDeviceSize offset, VkDeviceSize size);
+    // one mip level and layer, p_rect NULL for all of it. depth/stencil formats read
+    // the depth aspect, d24 comes back in 32 bits per texel.
+    std::future<ReadbackResult> cmd_readback_texture(VkCommandBuffer cmd_buffer, Texture2D *p_texture, const VkRect2D *p_rect = NULL, uint32_t mip_level = 0, uint32_t array_layer = 0);
+
+    // batched uploads, the queue owns the staging buffer and releases it once the
+    // gpu has consumed it. flush records every queued copy into a single command
+    // buffer that goes out with the frame submission.
+    // the staging buffer holds the first level_count mip levels at p_level_offsets,
+    // every level with all array layers back to back. the remaining levels are
+    // generated by blits and need a blit filterable format.
+    void enqueue_texture_upload(Texture2D *texture, Buffer *staging_buffer, uint32_t level_count = 1, const VkDeviceSize *p_level_offsets = NULL);
+    // copies the whole staging buffer to the start of a buffer from create_device_buffer.
+    void enqueue_buffer_upload(Buffer *buffer, Buffer *staging_buffer);
+    void flush_upload_queue();
 
     struct SamplerCreateInfo {
         VkSamplerAddressMode u = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         VkSamplerAddressMode v = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         VkSamplerAddressMode w = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         VkBorderColor border_color = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        VkFilter mag_filter = VK_FILTER_LINEAR;
+        VkFilter min_filter = VK_FILTER_LINEAR;
+        VkSamplerMipmapMode mipmap_mode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        float min_lod = 0.0f;
+        float max_lod = VK_LOD_CLAMP_NONE;
+        float mip_lod_bias = 0.0f;
+        float max_anisotropy = 1.0f; /* <= 1 disables, clamped to the device limit */
+        bool compare_enable = false;
+        VkCompareOp compare_op = VK_COMPARE_OP_ALWAYS;
     };
 
+    // samplers are shared between every caller asking for the same state, each
+    // create_sampler has to be paired with a destroy_sampler.
     void create_sampler(SamplerCreateInfo* p_create_info, VkSampler *p_sampler);
     void destroy_sampler(VkSampler sampler);
+    // for pImmutableSamplers of descriptor set layouts, the sampler and the address
+    // stay valid until the device is destroyed.
+    const VkSampler *get_immutable_sampler(SamplerCreateInfo *p_create_info);
+    uint32_t get_sampler_count() { return sampler_cache.size(); }
     void bind_texture_sampler(Texture2D *texture, VkSampler sampler);
 
+    // every allocation the device makes is accounted to one category, buffers by
+    // their usage and textures by whether they are attachments.
+    enum MemoryCategory {
+        MEMORY_CATEGORY_GEOMETRY,
+        MEMORY_CATEGORY_TEXTURE,
+        MEMORY_CATEGORY_RENDER_TARGET,
+        MEMORY_CATEGORY_STAGING,
+        MEMORY_CATEGORY_UNIFORM,
+        MEMORY_CATEGORY_OTHER,
+        MEMORY_CATEGORY_MAX,
+    };
+
+    struct MemoryHeapStats {
+        VkDeviceSize budget; /* what the driver lets the process use, estimated without VK_EXT_memory_budget */
+        VkDeviceSize usage;
+        VkDeviceSize block_bytes;
+        VkDeviceSize allocation_bytes;
+        uint32_t block_count;
+        uint32_t allocation_count;
+        float fragmentation; /* 1 - largest free range / free bytes in the blocks */
+        bool device_local;
+    };
+
+    struct MemoryAllocationStats {
+        MemoryCategory category;
+        VkDeviceSize size;
+        uint32_t width; /* 0 for buffers and raw memory */
+        uint32_t height;
+    };
+
+    struct MemoryStats {
+        std::vector<MemoryHeapStats> heaps;
+        VkDeviceSize category_bytes[MEMORY_CATEGORY_MAX];
+        uint32_t category_counts[MEMORY_CATEGORY_MAX];
+        std::vector<MemoryAllocationStats> largest; /* sorted by size, descending */
+    };
+
+    // walks every vma block, meant for debug panels and soak tests rather than
+    // every frame.
+    void get_memory_stats(MemoryStats *p_stats, uint32_t largest_count = 8);
+    static const char *get_memory_category_name(MemoryCategory category);
+
+    // begin_frame compacts the vma blocks incrementally whenever nothing is in flight
+    // on the gpu, running passes until the budget is spent. moved resources keep their
+    // pointers and handles, their vulkan objects are replaced and the bindless table,
+    // cached texture sets and sets written by update_descriptor_set_xxx() are patched.
+    // sampled textures and uploaded device buffers move, the copies are recorded into
+    // the frame and the old objects are released once it retires. host visible buffers
+    // are written through their mapping by any thread and stay where they are, as do
+    // attachments, storage resources, aliased memory and pinned resources. 0 disables.
+    void set_defragmentation_budget(float v_budget_ms) { defragmentation_budget_ms = v_budget_ms; }
+
+    struct DefragmentationStats {
+        uint64_t passes = 0;
+        uint64_t moved_allocations = 0;
+        VkDeviceSize moved_bytes = 0;
+        uint64_t freed_blocks = 0;
+    };
+
+    DefragmentationStats get_defragmentation_stats() { return defragmentation_stats; }
+
     void create_descriptor_set_layout(uint32_t bind_count, VkDescriptorSetLayoutBinding *p_bind, VkDescriptorSetLayout *p_descriptor_set_layout);
     void destroy_descriptor_set_layout(VkDescriptorSetLayout descriptor_set_layout);
     void allocate_descriptor_set(VkDescriptorSetLayout descriptor_set_layout, VkDescriptorSet *p_descriptor_set);
     void free_descriptor_set(VkDescriptorSet descriptor_set);
+    // written sets that live until the frame being recorded retires, identical
+    // content within a frame returns the same set.
+    VkDescriptorSet get_frame_descriptor_set(VkDescriptorSetLayout descriptor_set_layout, uint32_t binding_count, const DescriptorAllocator::Binding *p_bindings);
+    // a combined image sampler at binding 0 for fragment shaders, the layout the imgui
+    // backend uses for its texture ids.
+    VkDescriptorSetLayout get_texture_descriptor_set_layout() { return texture_descriptor_set_layout; }
+    VkDescriptorSet get_frame_texture_descriptor_set(Texture2D *p_texture);
+    // same layout, written once and kept in the texture until it is destroyed or
+    // its sampler changes. render targets are recreated on resize and so get a
+    // new set together with their new image view.
+    VkDescriptorSet get_texture_descriptor_set(Texture2D *p_texture);
+    uint32_t get_descriptor_pool_count() { return descriptor_allocator->get_pool_count(); }
+    // slots of the bindless table, a resource is added on first use and keeps its
+    // slot until it is destroyed. BINDLESS_INVALID_INDEX once the table is full.
+    uint32_t get_bindless_texture_index(Texture2D *p_texture);
+    uint32_t get_bindless_buffer_index(Buffer *p_buffer);
+    VkDescriptorSetLayout get_bindless_descriptor_set_layout() { return bindless_table->get_descriptor_set_layout(); }
     void update_descriptor_set_buffer(Buffer *p_buffer, uint32_t binding, VkDescriptorSet descriptor_set);
     void update_descriptor_set_image(Texture2D *p_texture, uint32_t binding, VkDescriptorSet descriptor_set);
+    void update_descriptor_set_storage_buffer(Buffer *p_buffer, uint32_t binding, VkDescriptorSet descriptor_set);
+    // storage images are accessed in the general layout.
+    void update_descriptor_set_storage_image(Texture2D *p_texture, uint32_t binding, VkDescriptorSet descriptor_set);
 
     struct ShaderInfo {
         const char *vertex = NULL;
@@ -124,8 +353,15 @@ public:
         VkPushConstantRange *p_push_const_range = NULL;
     };
 
+    // attachment formats a graphics pipeline renders into.
+    struct FramebufferFormat {
+        VkFormat color_format = VK_FORMAT_UNDEFINED;
+        VkFormat depth_format = VK_FORMAT_UNDEFINED;
+        VkFormat stencil_format = VK_FORMAT_UNDEFINED;
+    };
+
     struct PipelineCreateInfo {
-        VkRenderPass render_pass;
+        FramebufferFormat framebuffer_format;
         VkPolygonMode polygon;
         VkPrimitiveTopology topology;
         VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
@@ -140,50 +376,274 @@ public:
         VkPipeline pipeline;
         VkPipelineLayout layout;
         VkPipelineBindPoint bind_point;
+        ResourceHandle<Pipeline> handle;
     };
 
+    typedef ResourceHandle<Pipeline> PipelineHandle;
+
     Pipeline *create_graphics_pipeline(PipelineCreateInfo *p_create_info, ShaderInfo *p_shader_info);
     Pipeline *create_compute_pipeline(ComputeShaderInfo *p_shader_info);
     void destroy_pipeline(Pipeline *p_pipeline);
+    void destroy_pipeline(PipelineHandle handle) { if (Pipeline *pipeline = pipeline_pool.get(handle)) destroy_pipeline(pipeline); }
+
+    // NULL for a stale handle, debug builds exit instead.
+    Buffer *get_buffer(BufferHandle handle) { return buffer_pool.get(handle); }
+    Texture2D *get_texture(TextureHandle handle) { return texture_pool.get(handle); }
+    Pipeline *get_pipeline(PipelineHandle handle) { return pipeline_pool.get(handle); }
+    uint32_t get_buffer_count() { return buffer_pool.get_alive_count(); }
+    uint32_t get_texture_count() { return texture_pool.get_alive_count(); }
+    uint32_t get_pipeline_count() { return pipeline_pool.get_alive_count(); }
+
+    template<typename Fn> void for_each_buffer(Fn fn) { buffer_pool.for_each(fn); }
+    template<typename Fn> void for_each_texture(Fn fn) { texture_pool.for_each(fn); }
 
     void cmd_buffer_begin(VkCommandBuffer cmd_buffer, VkCommandBufferUsageFlags usage);
+    // secondary buffer executed inside a render pass or a dynamic rendering scope of p_framebuffer_format.
+    void cmd_buffer_begin_secondary(VkCommandBuffer cmd_buffer, FramebufferFormat *p_framebuffer_format, VkSampleCountFlagBits samples);
     void cmd_buffer_end(VkCommandBuffer cmd_buffer);
     void cmd_buffer_one_time_begin(VkCommandBuffer *p_cmd_buffer);
-    void cmd_buffer_one_time_end(VkCommandBuffer cmd_buffer);
 
+    // single image transition, several barriers are better batched with a BarrierBuilder.
     struct PipelineMemoryBarrier {
         struct {
             Texture2D *texture = VK_NULL_HANDLE;
             VkImageLayout old_image_layout = VK_IMAGE_LAYOUT_UNDEFINED;
             VkImageLayout new_image_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-            VkAccessFlags src_access_mask = 0;
-            VkAccessFlags dst_access_mask = 0;
+            VkPipelineStageFlags2 src_stage_mask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            VkAccessFlags2 src_access_mask = 0;
+            VkPipelineStageFlags2 dst_stage_mask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            VkAccessFlags2 dst_access_mask = 0;
         } image;
     };
 
     void cmd_pipeline_barrier(VkCommandBuffer cmd_buffer, const PipelineMemoryBarrier *p_pipeline_memory_barrier);
 
-    void cmd_begin_render_pass(VkCommandBuffer cmd_buffer, VkRenderPass render_pass, uint32_t clear_value_count, VkClearValue *p_clear_values, VkFramebuffer framebuffer, VkRect2D *p_rect);
-    void cmd_end_render_pass(VkCommandBuffer cmd_buffer);
+    // the bind, viewport and push constant commands below remember what they set on
+    // the command buffer being recorded by the calling thread and drop calls that
+    // would set the same state again. raw vkCmd calls that change bindings in between
+    // have to invalidate it.
+    struct CmdStateStats {
+        uint32_t pipeline = 0;
+        uint32_t descriptor_set = 0;
+        uint32_t vertex_buffer = 0;
+        uint32_t index_buffer = 0;
+        uint32_t viewport = 0;
+        uint32_t push_const = 0;
+    };
+
+    void cmd_invalidate_state(VkCommandBuffer cmd_buffer);
+    // calls skipped during the previous frame.
+    CmdStateStats get_skipped_cmd_stats() { return skipped_cmd_stats; }
+
+    struct RenderingAttachment {
+        VkImageView image_view;
+        VkImageLayout image_layout;
+        VkAttachmentLoadOp load_op;
+        VkAttachmentStoreOp store_op;
+        VkClearValue clear_value = {};
+        VkResolveModeFlagBits resolve_mode = VK_RESOLVE_MODE_NONE;
+        VkImageView resolve_image_view = VK_NULL_HANDLE;
+        VkImageLayout resolve_image_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    // dynamic rendering, the attachments have to be in their layouts already.
+    void cmd_begin_rendering(VkCommandBuffer cmd_buffer, VkRect2D *p_rect, uint32_t color_attachment_count, RenderingAttachment *p_color_attachments, RenderingAttachment *p_depth_attachment, RenderingAttachment *p_stencil_attachment, VkRenderingFlags flags = 0);
+    void cmd_end_rendering(VkCommandBuffer cmd_buffer);
+    void cmd_execute_commands(VkCommandBuffer cmd_buffer, uint32_t cmd_buffer_count, VkCommandBuffer *p_cmd_buffers);
     void cmd_bind_vertex_buffer(VkCommandBuffer cmd_buffer, Buffer *p_buffer);
     void cmd_bind_index_buffer(VkCommandBuffer cmd_buffer, VkIndexType type, Buffer *p_buffer);
     void cmd_draw(VkCommandBuffer cmd_buffer, uint32_t vertex_count);
     void cmd_draw_indexed(VkCommandBuffer cmd_buffer, uint32_t index_count);
+    void cmd_dispatch(VkCommandBuffer cmd_buffer, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z);
+    // the buffer holds a VkDispatchIndirectCommand at offset.
+    void cmd_dispatch_indirect(VkCommandBuffer cmd_buffer, Buffer *p_buffer, VkDeviceSize offset);
     void cmd_bind_pipeline(VkCommandBuffer cmd_buffer, Pipeline *p_pipeline);
-    void cmd_buffer_submit(VkCommandBuffer cmd_buffer, uint32_t wait_semaphore_count, VkSemaphore *p_wait_semaphore, uint32_t signal_semaphore_count, VkSemaphore *p_signal_semaphore, VkPipelineStageFlags *p_mask, VkQueue queue, VkFence fence);
+    // returns the timeline value of the queue the submission signals. p_wait_values
+    // holds the values of timeline wait semaphores, NULL when all are binary.
+    uint64_t cmd_buffer_submit(VkCommandBuffer cmd_buffer, uint32_t wait_semaphore_count, VkSemaphore *p_wait_semaphore, uint32_t signal_semaphore_count, VkSemaphore *p_signal_semaphore, VkPipelineStageFlags *p_mask, VkQueue queue, const uint64_t *p_wait_values = NULL);
+    // the frame's command buffers are collected with their dependencies and go out
+    // together in flush_submissions, one vkQueueSubmit2 per queue. end_frame flushes
+    // whatever is still pending.
+    void enqueue_submission(VkCommandBuffer cmd_buffer, uint32_t wait_semaphore_count, VkSemaphore *p_wait_semaphore, uint32_t signal_semaphore_count, VkSemaphore *p_signal_semaphore, VkPipelineStageFlags *p_mask, VkQueue queue, const uint64_t *p_wait_values = NULL);
+    void flush_submissions();
     void cmd_bind_descriptor_set(VkCommandBuffer cmd_buffer, Pipeline *p_pipeline, VkDescriptorSet descriptor);
+    // binds the table at RENDER_DEVICE_BINDLESS_SET, after the set 0 of the pipeline.
+    void cmd_bind_bindless_descriptor_set(VkCommandBuffer cmd_buffer, Pipeline *p_pipeline);
     void cmd_setval_viewport(VkCommandBuffer cmd_buffer , uint32_t w, uint32_t h);
     void cmd_push_const(VkCommandBuffer cmd_buffer, RenderDevice::Pipeline *pipeline, VkShaderStageFlags shader_stage_flags, uint32_t offset, uint32_t size, void *p_values);
-    void present(VkQueue queue, VkSwapchainKHR swap_chain, uint32_t index, VkSemaphore wait_semaphore);
+    void present(VkSwapchainKHR swap_chain, uint32_t index, VkSemaphore wait_semaphore);
 
 private:
-    void _initialize_descriptor_pool();
+    Texture2D *_create_texture(TextureCreateInfo *p_create_info, VmaAllocation aliasing_allocation);
+    void _initialize_descriptor_pools();
+    VkSampler _create_sampler(const SamplerCreateInfo *p_create_info);
+    void _retire_frames(bool wait_all);
+    void _reset_frame_cmd_pools();
+    RenderDeviceContext::QueueType _get_queue_type(VkQueue queue);
+
+    struct _Submission;
+    static void _fill_submission(_Submission *p_submission, VkCommandBuffer cmd_buffer, uint32_t wait_semaphore_count, VkSemaphore *p_wait_semaphore, uint32_t signal_semaphore_count, VkSemaphore *p_signal_semaphore, VkPipelineStageFlags *p_mask, const uint64_t *p_wait_values);
+    static VkSubmitInfo2 _submit_info(const _Submission *p_submission);
+    Buffer *_create_buffer(VkBufferUsageFlags usage, VkDeviceSize size, VmaMemoryUsage memory_usage, bool concurrent);
+    std::future<ReadbackResult> _defer_readback(Buffer *p_staging_buffer, ReadbackResult v_result);
+    void _track_allocation(VmaAllocation allocation, MemoryCategory category, Buffer *p_buffer, Texture2D *p_texture);
+    void _untrack_allocation(VmaAllocation allocation);
+    void _create_texture_image_view(Texture2D *p_texture);
+    void _write_texture_descriptor_set(Texture2D *p_texture);
+    void _record_descriptor_write(VkDescriptorSet descriptor_set, uint32_t binding, VkDescriptorType type, Buffer *p_buffer, Texture2D *p_texture);
+    void _defragment();
+    bool _defragment_pass();
+    struct _MovedObjects;
+    bool _end_defragmentation_pass(VmaDefragmentationPassMoveInfo *p_pass, const _MovedObjects *p_moved);
+    bool _is_movable(Buffer *p_buffer, Texture2D *p_texture);
+    void _move_buffer(Buffer *p_buffer, VmaAllocation dst_allocation, VkCommandBuffer cmd_buffer, _MovedObjects *p_moved);
+    void _move_texture(Texture2D *p_texture, VmaAllocation dst_allocation, VkCommandBuffer cmd_buffer, _MovedObjects *p_moved);
+
+    struct _CmdState;
+    _CmdState *_get_cmd_state(VkCommandBuffer cmd_buffer);
+    void _flush_cmd_state_stats(_CmdState *state);
+
+    struct _TextureUpload {
+        Texture2D *texture;
+        Buffer *staging_buffer;
+        uint32_t level_count;
+        VkDeviceSize level_offsets[TEXTURE_MAX_MIP_LEVELS];
+    };
+
+    struct _BufferUpload {
+        Buffer *buffer;
+        Buffer *staging_buffer;
+    };
+
+    struct _Submission {
+        std::vector<VkCommandBufferSubmitInfo> cmd_buffers;
+        std::vector<VkSemaphoreSubmitInfo> waits;
+        std::vector<VkSemaphoreSubmitInfo> signals;
+    };
+
+    struct _TrackedAllocation {
+        MemoryAllocationStats stats;
+        Buffer *buffer; /* the resource living in the allocation, NULL for raw memory */
+        Texture2D *texture;
+    };
+
+    // last write of a binding through update_descriptor_set_xxx(), replayed when the
+    // resource moves. entries of freed sets are dropped with the set.
+    struct _DescriptorWrite {
+        VkDescriptorType type;
+        BufferHandle buffer;
+        TextureHandle texture;
+    };
+
+    // vulkan objects replaced by a defragmentation pass, destroyed once its copies
+    // have finished.
+    struct _MovedObjects {
+        std::vector<VkBuffer> buffers;
+        std::vector<VkImage> images;
+        std::vector<VkImageView> image_views;
+        std::vector<BufferHandle> moved_buffers;
+        std::vector<TextureHandle> moved_textures;
+    };
+
+    struct _Deletion {
+        uint64_t frame;
+        std::function<void()> deletion;
+    };
+
+    // indexed by VkCommandBufferLevel, buffers below used are taken this frame.
+    struct _FrameCmdPool {
+        VkCommandPool cmd_pool;
+        std::vector<VkCommandBuffer> cmd_buffers[2];
+        uint32_t used[2];
+    };
+
+    struct _ThreadCmdPools {
+        _FrameCmdPool frames[RENDER_DEVICE_FRAMES_IN_FLIGHT];
+    };
+
+    struct _ComputeFrame {
+        VkCommandPool cmd_pool;
+        std::vector<VkCommandBuffer> cmd_buffers;
+        uint32_t used;
+    };
+
+    // per thread, a thread records one command buffer at a time. switching to
+    // another buffer forgets everything, which is always correct.
+    struct _CmdState {
+        VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+        VkPipeline pipelines[2] = {}; /* graphics, compute */
+        VkPipelineLayout descriptor_set_layouts[2] = {};
+        VkDescriptorSet descriptor_sets[2] = {};
+        VkPipelineLayout bindless_layouts[2] = {};
+        VkBuffer vertex_buffer = VK_NULL_HANDLE;
+        VkBuffer index_buffer = VK_NULL_HANDLE;
+        VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+        uint32_t viewport_width = UINT32_MAX;
+        uint32_t viewport_height = UINT32_MAX;
+        VkPipelineLayout push_const_layout = VK_NULL_HANDLE;
+        VkShaderStageFlags push_const_stages = 0;
+        uint32_t push_const_offset = 0;
+        uint32_t push_const_size = 0;
+        uint8_t push_const[RENDER_DEVICE_MAX_PUSH_CONST_SIZE];
+        CmdStateStats skipped;
+    };
+
+    struct _CachedSampler {
+        SamplerCreateInfo info;
+        VkSampler sampler;
+        uint32_t ref_count;
+    };
+
+    struct _FrameSlot {
+        uint64_t timeline_values[RenderDeviceContext::QUEUE_TYPE_MAX];
+        uint64_t frame; /* frame tracked in this slot, UINT64_MAX when free */
+    };
 
     RenderDeviceContext *vk_rdc;
     VkDevice vk_device;
     VmaAllocator allocator;
-    VkDescriptorPool descriptor_pool;
+    DescriptorAllocator *descriptor_allocator = NULL;
+    BindlessTable *bindless_table = NULL;
+    std::mutex binding_mutex;
+    std::mutex sampler_mutex;
+    std::unordered_map<uint64_t, std::vector<_CachedSampler *>> sampler_buckets;
+    std::unordered_map<VkSampler, _CachedSampler *> sampler_cache;
+    std::mutex memory_mutex;
+    std::unordered_map<VmaAllocation, _TrackedAllocation> tracked_allocations;
+    std::mutex descriptor_write_mutex;
+    std::map<std::pair<VkDescriptorSet, uint32_t>, _DescriptorWrite> descriptor_writes;
+    VmaDefragmentationContext defragmentation_context = VK_NULL_HANDLE;
+    bool defragmentation_pass_open = false; /* copies in flight, ended by the deletion queue */
+    float defragmentation_budget_ms = 1.0f;
+    uint64_t next_defragmentation_frame = 0;
+    DefragmentationStats defragmentation_stats;
+    VkDescriptorPool external_descriptor_pool;
+    VkDescriptorSetLayout texture_descriptor_set_layout;
     VkSampleCountFlagBits msaa_sample_counts;
+    bool lazily_allocated_memory = false;
+    std::vector<_TextureUpload> texture_uploads;
+    std::vector<_BufferUpload> buffer_uploads;
+
+    uint64_t frame_index = 0; /* frame being recorded */
+    uint64_t retired_frame_count = 0; /* every frame below it has finished on the gpu */
+    _FrameSlot frame_slots[RENDER_DEVICE_FRAMES_IN_FLIGHT];
+    std::mutex deletion_mutex;
+    std::deque<_Deletion> deletion_queue;
+    static thread_local _CmdState cmd_state;
+    std::mutex cmd_state_mutex;
+    CmdStateStats frame_skipped_cmd_stats;
+    CmdStateStats skipped_cmd_stats;
+    std::mutex cmd_pool_mutex;
+    std::unordered_map<std::thread::id, _ThreadCmdPools *> thread_cmd_pools;
+    std::mutex compute_mutex;
+    std::mutex submission_mutex;
+    std::vector<_Submission> pending_submissions[RenderDeviceContext::QUEUE_TYPE_MAX];
+    _ComputeFrame compute_frames[RENDER_DEVICE_FRAMES_IN_FLIGHT];
+    uint32_t queue_families[2]; /* graphics, compute */
+
+    ResourcePool<Buffer> buffer_pool;
+    ResourcePool<Texture2D> texture_pool;
+    ResourcePool<Pipeline> pipeline_pool;
 };
 
 #endif /* _RENDERING_DEVICE_DRIVER_VULKAN_H */
\ No newline at end of file
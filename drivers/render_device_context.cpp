@@ -22,6 +22,7 @@
 /* ======================================================================== */
 #include "render_device_context.h"
 #include <algorithm>
+#include <string.h>
 
 const char *ignore_validation_error[] = {
         "[ VUID-RuntimeSpirv-samples-08725 ]",
@@ -153,6 +154,8 @@ RenderDeviceContext::~RenderDeviceContext()
 {
     vmaDestroyAllocator(allocator);
     vkDestroyCommandPool(device, cmd_pool, allocation_callbacks);
+    for (auto &timeline: timelines)
+        vkDestroySemaphore(device, timeline.semaphore, allocation_callbacks);
     vkDestroyDevice(device, allocation_callbacks);
 #ifdef ENGINE_ENABLE_VULKAN_DEBUG_UTILS_EXT
     fnDestroyDebugUtilsMessengerExt(instance, messenger, allocation_callbacks);
@@ -164,6 +167,7 @@ Error RenderDeviceContext::initialize()
 {
     _create_device();
     _create_cmd_pool();
+    _create_timelines();
     _create_vma_allocator();
 
     return OK;
@@ -241,6 +245,17 @@ void RenderDeviceContext::_initialize_window_arguments(VkSurfaceKHR surface)
         }
     }
 
+    // a compute only family runs next to the graphics queue, without one compute
+    // work goes to the graphics queue.
+    compute_queue_family = graph_queue_family;
+    for (uint32_t i = 0; i < queue_family_count; i++) {
+        VkQueueFlags flags = queue_family_properties[i].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            compute_queue_family = i;
+            break;
+        }
+    }
+
     free(queue_family_properties);
 }
 
@@ -252,39 +267,120 @@ void RenderDeviceContext::_load_proc_addr()
 #endif
 }
 
+bool RenderDeviceContext::_is_device_extension_supported(const char *name)
+{
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count, nullptr);
+
+    std::vector<VkExtensionProperties> properties(count);
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count, std::data(properties));
+
+    for (const auto &property: properties) {
+        if (strcmp(property.extensionName, name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
 void RenderDeviceContext::_create_device()
 {
     VkResult U_ASSERT_ONLY err;
 
     float priorities = 1.0f;
-    VkDeviceQueueCreateInfo queue_create_info = {
-            /* sType */ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-            /* pNext */ nextptr,
-            /* flags */ no_flag_bits,
-            /* queueFamilyIndex */ graph_queue_family,
-            /* queueCount */ 1,
-            /* pQueuePriorities */ &priorities
+    VkDeviceQueueCreateInfo queue_create_infos[] = {
+            {
+                    /* sType */ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                    /* pNext */ nextptr,
+                    /* flags */ no_flag_bits,
+                    /* queueFamilyIndex */ graph_queue_family,
+                    /* queueCount */ 1,
+                    /* pQueuePriorities */ &priorities
+            },
+            {
+                    /* sType */ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                    /* pNext */ nextptr,
+                    /* flags */ no_flag_bits,
+                    /* queueFamilyIndex */ compute_queue_family,
+                    /* queueCount */ 1,
+                    /* pQueuePriorities */ &priorities
+            },
     };
 
     /* create logic device */
-    const char *extensions[] = {
+    std::vector<const char *> extensions = {
             "VK_KHR_swapchain",
             "VK_KHR_synchronization2"
     };
 
     VkPhysicalDeviceFeatures features = {};
     features.wideLines = VK_TRUE;
+    features.samplerAnisotropy = physical_device_features.samplerAnisotropy;
+    features.textureCompressionBC = physical_device_features.textureCompressionBC;
+    enabled_features = features;
+
+    // the render graph records every barrier through synchronization2.
+    VkPhysicalDeviceVulkan12Features supported_vulkan12_features = {};
+    supported_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceVulkan13Features supported_vulkan13_features = {};
+    supported_vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    supported_vulkan13_features.pNext = &supported_vulkan12_features;
+
+    VkPhysicalDeviceFeatures2 supported_features = {};
+    supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features.pNext = &supported_vulkan13_features;
+    vkGetPhysicalDeviceFeatures2(physical_device, &supported_features);
+
+    EXIT_FAIL_COND_V(supported_vulkan13_features.synchronization2, "-engine error: device %s does not support synchronization2!\n", get_device_name());
+
+    // queue synchronization is built on timeline semaphores, core since 1.2.
+    EXIT_FAIL_COND_V(supported_vulkan12_features.timelineSemaphore, "-engine error: device %s does not support timeline semaphores!\n", get_device_name());
+
+    // bindless tables, descriptor indexing is core since 1.2 and these bits are
+    // guaranteed on every 1.3 device.
+    EXIT_FAIL_COND_V(supported_vulkan12_features.descriptorIndexing, "-engine error: device %s does not support descriptor indexing!\n", get_device_name());
+
+    // every pass renders dynamically, there are no render pass or framebuffer objects.
+    // the extension name is still enabled since the imgui backend looks its entry
+    // points up by the KHR names.
+    EXIT_FAIL_COND_V(supported_vulkan13_features.dynamicRendering, "-engine error: device %s does not support dynamic rendering!\n", get_device_name());
+    if (_is_device_extension_supported("VK_KHR_dynamic_rendering"))
+        extensions.push_back("VK_KHR_dynamic_rendering");
+
+    // heap budgets from the driver, otherwise vma estimates them from its own blocks.
+    memory_budget = _is_device_extension_supported("VK_EXT_memory_budget");
+    if (memory_budget)
+        extensions.push_back("VK_EXT_memory_budget");
+
+    VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12_features.timelineSemaphore = VK_TRUE;
+    vulkan12_features.descriptorIndexing = VK_TRUE;
+    vulkan12_features.runtimeDescriptorArray = VK_TRUE;
+    vulkan12_features.descriptorBindingPartiallyBound = VK_TRUE;
+    vulkan12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    vulkan12_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    vulkan12_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    vulkan12_features.shaderStorageBufferArrayNonUniformIndexing = supported_vulkan12_features.shaderStorageBufferArrayNonUniformIndexing;
+
+    VkPhysicalDeviceVulkan13Features vulkan13_features = {};
+    vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13_features.pNext = &vulkan12_features;
+    vulkan13_features.synchronization2 = VK_TRUE;
+    vulkan13_features.dynamicRendering = VK_TRUE;
 
     VkDeviceCreateInfo device_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            /* pNext */ nextptr,
+            /* pNext */ &vulkan13_features,
             /* flags */ no_flag_bits,
-            /* queueCreateInfoCount */ 1,
-            /* pQueueCreateInfos */ &queue_create_info,
+            /* queueCreateInfoCount */ is_async_compute_supported() ? 2u : 1u,
+            /* pQueueCreateInfos */ queue_create_infos,
             /* enabledLayerCount */ 0,
             /* ppEnabledLayerNames */ nullptr,
-            /* enabledExtensionCount */ ARRAY_SIZE(extensions),
-            /* ppEnabledExtensionNames */ extensions,
+            /* enabledExtensionCount */ (uint32_t) std::size(extensions),
+            /* ppEnabledExtensionNames */ std::data(extensions),
             /* pEnabledFeatures */ &features,
     };
 
@@ -292,6 +388,7 @@ void RenderDeviceContext::_create_device()
     assert(!err);
 
     vkGetDeviceQueue(device, graph_queue_family, 0, &graph_queue);
+    vkGetDeviceQueue(device, compute_queue_family, 0, &compute_queue);
 }
 
 void RenderDeviceContext::_create_cmd_pool()
@@ -309,6 +406,112 @@ void RenderDeviceContext::_create_cmd_pool()
     assert(!err);
 }
 
+void RenderDeviceContext::_create_timelines()
+{
+    VkSemaphoreTypeCreateInfo semaphore_type_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            /* pNext */ nextptr,
+            /* semaphoreType */ VK_SEMAPHORE_TYPE_TIMELINE,
+            /* initialValue */ 0,
+    };
+
+    VkSemaphoreCreateInfo semaphore_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            /* pNext */ &semaphore_type_create_info,
+            /* flags */ no_flag_bits,
+    };
+
+    for (auto &timeline: timelines) {
+        VkResult U_ASSERT_ONLY err = vkCreateSemaphore(device, &semaphore_create_info, allocation_callbacks, &timeline.semaphore);
+        assert(!err);
+        timeline.submitted_value = 0;
+    }
+
+    timelines[QUEUE_TYPE_GRAPHICS].queue = graph_queue;
+    timelines[QUEUE_TYPE_COMPUTE].queue = compute_queue;
+}
+
+RenderDeviceContext::_Timeline *RenderDeviceContext::_get_timeline(QueueType type)
+{
+    // a single queue has a single timeline, otherwise the values would not be ordered.
+    return is_async_compute_supported() ? &timelines[type] : &timelines[QUEUE_TYPE_GRAPHICS];
+}
+
+VkSemaphore RenderDeviceContext::get_timeline_semaphore(QueueType type)
+{
+    return _get_timeline(type)->semaphore;
+}
+
+uint64_t RenderDeviceContext::get_submitted_timeline_value(QueueType type)
+{
+    _Timeline *timeline = _get_timeline(type);
+    std::unique_lock<std::mutex> lock(timeline->mutex);
+    return timeline->submitted_value;
+}
+
+uint64_t RenderDeviceContext::get_completed_timeline_value(QueueType type)
+{
+    uint64_t value;
+    VkResult U_ASSERT_ONLY err = vkGetSemaphoreCounterValue(device, _get_timeline(type)->semaphore, &value);
+    assert(!err);
+    return value;
+}
+
+void RenderDeviceContext::wait_timeline_value(QueueType type, uint64_t value)
+{
+    VkSemaphoreWaitInfo wait_info = {
+            /* sType */ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            /* pNext */ nextptr,
+            /* flags */ no_flag_bits,
+            /* semaphoreCount */ 1,
+            /* pSemaphores */ &_get_timeline(type)->semaphore,
+            /* pValues */ &value,
+    };
+
+    VkResult U_ASSERT_ONLY err = vkWaitSemaphores(device, &wait_info, UINT64_MAX);
+    assert(!err);
+}
+
+uint64_t RenderDeviceContext::queue_submit(QueueType type, uint32_t submit_count, const VkSubmitInfo2 *p_submits)
+{
+    assert(submit_count > 0);
+
+    _Timeline *timeline = _get_timeline(type);
+    std::unique_lock<std::mutex> lock(timeline->mutex);
+
+    uint64_t value = timeline->submitted_value + 1;
+
+    // the timeline is signaled after the last submission's own semaphores, once
+    // everything before it in the queue has completed.
+    std::vector<VkSubmitInfo2> submits(p_submits, p_submits + submit_count);
+    VkSubmitInfo2 *last = &submits.back();
+
+    std::vector<VkSemaphoreSubmitInfo> signals(last->pSignalSemaphoreInfos, last->pSignalSemaphoreInfos + last->signalSemaphoreInfoCount);
+    signals.push_back({
+            /* sType */ VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            /* pNext */ nextptr,
+            /* semaphore */ timeline->semaphore,
+            /* value */ value,
+            /* stageMask */ VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            /* deviceIndex */ 0,
+    });
+
+    last->signalSemaphoreInfoCount = (uint32_t) std::size(signals);
+    last->pSignalSemaphoreInfos = std::data(signals);
+
+    VkResult U_ASSERT_ONLY err = vkQueueSubmit2(timeline->queue, submit_count, std::data(submits), VK_NULL_HANDLE);
+    assert(!err);
+
+    timeline->submitted_value = value;
+    return value;
+}
+
+VkResult RenderDeviceContext::queue_present(const VkPresentInfoKHR *p_present_info)
+{
+    std::unique_lock<std::mutex> lock(timelines[QUEUE_TYPE_GRAPHICS].mutex);
+    return vkQueuePresentKHR(graph_queue, p_present_info);
+}
+
 void RenderDeviceContext::_create_vma_allocator()
 {
     VkResult U_ASSERT_ONLY err;
@@ -317,6 +520,9 @@ void RenderDeviceContext::_create_vma_allocator()
     vma_allocator_create_info.instance = instance;
     vma_allocator_create_info.physicalDevice = physical_device;
     vma_allocator_create_info.device = device;
+    vma_allocator_create_info.vulkanApiVersion = VK_API_VERSION_1_3;
+    if (memory_budget)
+        vma_allocator_create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 
     err = vmaCreateAllocator(&vma_allocator_create_info, &allocator);
     assert(!err);
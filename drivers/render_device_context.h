@@ -34,6 +34,7 @@
 #include <bright/error.h>
 #include <bright/typedefs.h>
 #include <time.h>
+#include <mutex>
 #include <vector>
 
 #define no_flag_bits         0
@@ -54,14 +55,39 @@ public:
     VkInstance get_instance() { return instance; }
     VkPhysicalDevice get_physical_device() { return physical_device; }
     const char *get_device_name() { return physical_device_properties.deviceName; }
+    const VkPhysicalDeviceLimits &get_device_limits() { return physical_device_properties.limits; }
+    const VkPhysicalDeviceFeatures &get_enabled_features() { return enabled_features; }
     VkDevice get_device() { return device; }
     VmaAllocator get_allocator() { return allocator; }
     uint32_t get_graph_queue_family() { return graph_queue_family; }
     VkQueue get_graph_queue() { return graph_queue; };
+    uint32_t get_compute_queue_family() { return compute_queue_family; }
+    VkQueue get_compute_queue() { return compute_queue; }
+    bool is_async_compute_supported() { return compute_queue_family != graph_queue_family; }
+
+    enum QueueType {
+        QUEUE_TYPE_GRAPHICS = 0,
+        QUEUE_TYPE_COMPUTE = 1,
+        QUEUE_TYPE_MAX = 2,
+    };
+
+    // every submission to a queue signals the next value of its timeline semaphore,
+    // a value is reached once that submission and all before it have completed.
+    // cpu waits, resource retirement and cross queue waits all go through the
+    // values. without async compute both types submit to the graphics queue.
+    VkSemaphore get_timeline_semaphore(QueueType type);
+    uint64_t get_submitted_timeline_value(QueueType type);
+    uint64_t get_completed_timeline_value(QueueType type);
+    void wait_timeline_value(QueueType type, uint64_t value);
+    // submits all infos in a single vkQueueSubmit2, the last one additionally
+    // signals the next timeline value which is returned.
+    uint64_t queue_submit(QueueType type, uint32_t submit_count, const VkSubmitInfo2 *p_submits);
+    VkResult queue_present(const VkPresentInfoKHR *p_present_info);
     VkCommandPool get_cmd_pool() { return cmd_pool; }
     VkFormat get_window_format() { return format; }
     VkFormat find_supported_format(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     VkSampleCountFlagBits get_max_msaa_sample_counts() { return max_msaa_sample_counts; }
+    bool is_memory_budget_supported() { return memory_budget; }
 
     void allocate_cmd_buffer(VkCommandBufferLevel level, VkCommandBuffer *p_cmd_buffer);
     void free_cmd_buffer(VkCommandBuffer cmd_buffer);
@@ -76,8 +102,10 @@ private:
 #endif
 
     void _load_proc_addr();
+    bool _is_device_extension_supported(const char *name);
     void _create_device();
     void _create_cmd_pool();
+    void _create_timelines();
     void _create_vma_allocator();
 
     VkInstance instance = VK_NULL_HANDLE;
@@ -87,14 +115,30 @@ private:
     VkPhysicalDevice physical_device = VK_NULL_HANDLE;
     VkPhysicalDeviceProperties physical_device_properties;
     VkPhysicalDeviceFeatures physical_device_features;
+    VkPhysicalDeviceFeatures enabled_features = {};
     VkDevice device = VK_NULL_HANDLE;
     uint32_t graph_queue_family;
     VkQueue graph_queue = VK_NULL_HANDLE;
+    uint32_t compute_queue_family;
+    VkQueue compute_queue = VK_NULL_HANDLE;
     VkCommandPool cmd_pool = VK_NULL_HANDLE;
     VmaAllocator allocator = VK_NULL_HANDLE;
     VkSurfaceCapabilitiesKHR capabilities;
     VkFormat format;
     VkSampleCountFlagBits max_msaa_sample_counts = VK_SAMPLE_COUNT_1_BIT;
+    bool memory_budget = false;
+
+    // the mutex keeps submissions and their values in the same order.
+    struct _Timeline {
+        VkQueue queue;
+        VkSemaphore semaphore;
+        uint64_t submitted_value;
+        std::mutex mutex;
+    };
+
+    _Timeline *_get_timeline(QueueType type);
+
+    _Timeline timelines[QUEUE_TYPE_MAX];
 };
 
 #endif /* _RENDERING_CONTEXT_DRIVER_VULKAN_H */
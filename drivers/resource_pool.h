@@ -0,0 +1,165 @@
+/* ======================================================================== */
+/* resource_pool.h                                                          */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _RESOURCE_POOL_H_
+#define _RESOURCE_POOL_H_
+
+#include <bright/error.h>
+#include <bright/typedefs.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define RESOURCE_HANDLE_INDEX_BITS 20
+#define RESOURCE_HANDLE_GENERATION_BITS 12
+#define RESOURCE_HANDLE_INDEX_MASK ((1u << RESOURCE_HANDLE_INDEX_BITS) - 1)
+#define RESOURCE_HANDLE_GENERATION_MASK ((1u << RESOURCE_HANDLE_GENERATION_BITS) - 1)
+// slots per storage chunk, chunks never move so pointers into the pool stay valid.
+#define RESOURCE_POOL_CHUNK_SIZE 256
+
+/*
+ * typed 32 bit handle, slot index in the low bits and the slot generation in
+ * the high bits. generation 0 is never handed out, so a zero handle is null.
+ */
+template<typename T>
+struct ResourceHandle {
+    uint32_t value = 0;
+
+    V_FORCEINLINE uint32_t get_index() const { return value & RESOURCE_HANDLE_INDEX_MASK; }
+    V_FORCEINLINE uint32_t get_generation() const { return value >> RESOURCE_HANDLE_INDEX_BITS; }
+    V_FORCEINLINE bool is_null() const { return value == 0; }
+    V_FORCEINLINE bool operator==(const ResourceHandle &other) const { return value == other.value; }
+    V_FORCEINLINE bool operator!=(const ResourceHandle &other) const { return value != other.value; }
+};
+
+/*
+ * dense pooled storage with generational handles. freed slots bump their
+ * generation, so stale handles are caught by get() and double frees by free()
+ * in debug builds instead of touching a recycled object. raw pointers into the
+ * pool carry no generation, a pointer kept past free() is only caught until its
+ * slot is handed out again. allocate and free are thread safe, objects are reset
+ * to T{} when allocated.
+ */
+template<typename T>
+class ResourcePool {
+public:
+    T *allocate(ResourceHandle<T> *p_handle)
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        uint32_t index;
+        if (!free_slots.empty()) {
+            index = free_slots.back();
+            free_slots.pop_back();
+        } else {
+            index = (uint32_t) generations.size();
+            EXIT_FAIL_COND_V(index <= RESOURCE_HANDLE_INDEX_MASK, "-engine error: resource pool is full!\n");
+            if (index % RESOURCE_POOL_CHUNK_SIZE == 0)
+                chunks.push_back(std::make_unique<T[]>(RESOURCE_POOL_CHUNK_SIZE));
+            generations.push_back(1);
+            alive.push_back(false);
+        }
+
+        alive[index] = true;
+        alive_count++;
+
+        T *object = _slot(index);
+        *object = T{};
+        p_handle->value = (generations[index] << RESOURCE_HANDLE_INDEX_BITS) | index;
+        return object;
+      }
+
+    void free(ResourceHandle<T> handle)
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+
+#ifndef NDEBUG
+        EXIT_FAIL_COND_V(_is_valid(handle), "-engine error: free of a stale resource handle 0x%08x!\n", handle.value);
+#endif
+
+        uint32_t index = handle.get_index();
+        alive[index] = false;
+        alive_count--;
+
+        // skip generation 0 on wrap around, it marks the null handle.
+        uint32_t generation = (generations[index] + 1) & RESOURCE_HANDLE_GENERATION_MASK;
+        generations[index] = generation ? generation : 1;
+        free_slots.push_back(index);
+      }
+
+    // NULL for a stale handle in release builds, exits in debug builds.
+    T *get(ResourceHandle<T> handle)
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (!_is_valid(handle)) {
+#ifndef NDEBUG
+            EXIT_FAIL("-engine error: access through a stale resource handle 0x%08x!\n", handle.value);
+#endif
+            return NULL;
+        }
+
+        return _slot(handle.get_index());
+      }
+
+    bool is_valid(ResourceHandle<T> handle)
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        return _is_valid(handle);
+      }
+
+    uint32_t get_alive_count()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        return alive_count;
+      }
+
+    // visits every live object in slot order, chunk by chunk.
+    template<typename Fn>
+    void for_each(Fn fn)
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (uint32_t i = 0; i < (uint32_t) alive.size(); i++) {
+            if (alive[i])
+                fn(_slot(i));
+        }
+      }
+
+private:
+    V_FORCEINLINE T *_slot(uint32_t index) { return &chunks[index / RESOURCE_POOL_CHUNK_SIZE][index % RESOURCE_POOL_CHUNK_SIZE]; }
+
+    V_FORCEINLINE bool _is_valid(ResourceHandle<T> handle)
+      {
+        uint32_t index = handle.get_index();
+        return !handle.is_null() && index < generations.size() && alive[index] && generations[index] == handle.get_generation();
+      }
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<T[]>> chunks;
+    std::vector<uint16_t> generations;
+    std::vector<bool> alive;
+    std::vector<uint32_t> free_slots;
+    uint32_t alive_count = 0;
+};
+
+#endif /* _RESOURCE_POOL_H_ */
@@ -45,6 +45,14 @@ static VkSurfaceFormatKHR pick_surface_format(const VkSurfaceFormatKHR *surface_
     return surface_formats[0];
 }
 
+// combined depth/stencil formats, their stencil aspect has to be transitioned and
+// attached together with the depth aspect.
+static bool is_stencil_format(VkFormat format)
+{
+    return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+           format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_S8_UINT;
+}
+
 static VkSampleCountFlagBits find_max_msaa_sample_counts(VkPhysicalDeviceProperties properties)
 {
     VkSampleCountFlags framebuffer_color_sample_count;
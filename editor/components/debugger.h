@@ -23,7 +23,74 @@
 #ifndef _NAVEDITOR_COMPONENT_DEBUGGER_H_
 #define _NAVEDITOR_COMPONENT_DEBUGGER_H_
 
-static void _draw_debugger_editor_ui(DebuggerProperties *v_debugger)
+#define _MIB(bytes) ((double) (bytes) / (1024.0 * 1024.0))
+
+static void _draw_memory_stats(RenderDevice *v_rd)
+{
+    static RenderDevice::MemoryStats stats;
+    static uint64_t refresh_frame = UINT64_MAX;
+
+    // walking the vma blocks is not free, a few times a second is plenty.
+    if (refresh_frame == UINT64_MAX || v_rd->get_frame_index() - refresh_frame >= 30) {
+        v_rd->get_memory_stats(&stats);
+        refresh_frame = v_rd->get_frame_index();
+    }
+
+    ImGui::SeparatorText("显存");
+    ImGui::Indent(32.0f);
+
+    if (!v_rd->get_device_context()->is_memory_budget_supported())
+        ImGui::TextDisabled("budget estimated, VK_EXT_memory_budget unsupported");
+
+    for (size_t i = 0; i < std::size(stats.heaps); i++) {
+        const RenderDevice::MemoryHeapStats &heap = stats.heaps[i];
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.1f / %.1f MiB", _MIB(heap.usage), _MIB(heap.budget));
+        ImGui::Text("heap %zu (%s)", i, heap.device_local ? "device" : "host");
+        ImGui::ProgressBar(heap.budget > 0 ? (float) heap.usage / (float) heap.budget : 0.0f, ImVec2(-1.0f, 0.0f), overlay);
+        if (heap.block_count > 0)
+            ImGui::Text("blocks: %u (%.1f MiB), allocations: %u (%.1f MiB), fragmentation: %.0f%%", heap.block_count, _MIB(heap.block_bytes),
+                        heap.allocation_count, _MIB(heap.allocation_bytes), heap.fragmentation * 100.0f);
+    }
+
+    RenderDevice::DefragmentationStats defragmentation = v_rd->get_defragmentation_stats();
+    ImGui::Text("defragmentation: %llu passes, %llu moves (%.1f MiB), %llu blocks freed", (unsigned long long) defragmentation.passes,
+                (unsigned long long) defragmentation.moved_allocations, _MIB(defragmentation.moved_bytes), (unsigned long long) defragmentation.freed_blocks);
+
+    if (ImGui::BeginTable("##categories", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV)) {
+        ImGui::TableSetupColumn("category");
+        ImGui::TableSetupColumn("count");
+        ImGui::TableSetupColumn("MiB");
+        ImGui::TableHeadersRow();
+        for (uint32_t i = 0; i < RenderDevice::MEMORY_CATEGORY_MAX; i++) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(RenderDevice::get_memory_category_name((RenderDevice::MemoryCategory) i));
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", stats.category_counts[i]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", _MIB(stats.category_bytes[i]));
+        }
+        ImGui::EndTable();
+    }
+
+    if (!stats.largest.empty() && ImGui::TreeNode("largest allocations")) {
+        for (const auto &allocation : stats.largest) {
+            const char *category = RenderDevice::get_memory_category_name(allocation.category);
+            if (allocation.width > 0)
+                ImGui::Text("%.2f MiB  %s %ux%u", _MIB(allocation.size), category, allocation.width, allocation.height);
+            else
+                ImGui::Text("%.2f MiB  %s", _MIB(allocation.size), category);
+        }
+        ImGui::TreePop();
+    }
+
+    ImGui::Unindent(32.0f);
+}
+
+#undef _MIB
+
+static void _draw_debugger_editor_ui(RenderDevice *v_rd, DebuggerProperties *v_debugger)
 {
     static std::vector<float> fps_list;
 
@@ -60,6 +127,7 @@ static void _draw_debugger_editor_ui(DebuggerProperties *v_debugger)
             }
         }
 
+        _draw_memory_stats(v_rd);
     }
     NavUI::End();
 }
@@ -23,29 +23,65 @@
 #ifndef _NAVEDITOR_COMPONENT_SCENE_H_
 #define _NAVEDITOR_COMPONENT_SCENE_H_
 
-static void _draw_scene_editor_ui(RenderDevice::Texture2D *v_texture, RenderDevice::Texture2D *v_depth, ImVec2 *p_region)
+// depth of a readback texel in [0, 1], d24 formats keep it in the low 24 bits.
+static float _decode_picked_depth(const RenderDevice::ReadbackResult &v_result)
 {
+    uint32_t bits;
+    memcpy(&bits, std::data(v_result.data), sizeof(bits));
+
+    if (v_result.format == VK_FORMAT_D24_UNORM_S8_UINT)
+        return (float) (bits & 0x00ffffff) / (float) 0x00ffffff;
+
+    float depth;
+    memcpy(&depth, &bits, sizeof(depth));
+    return depth;
+}
+
+static void _draw_scene_editor_ui(RenderDevice *rd, RenderDevice::Texture2D *v_texture, RenderDevice::Texture2D *v_depth, ImVec2 *p_region)
+{
+    // a click picks the depth under the cursor, the readback arrives a frame later.
+    static std::future<RenderDevice::ReadbackResult> pick;
+    static float picked_depth = -1.0f;
+
     NavUI::BeginViewport("场景");
     {
-        static ImTextureID preview = NULL;
-        if (preview != NULL)
-            NavUI::RemoveTexture(preview);
+        // the sets share the layout of the imgui texture ids and are cached in the
+        // render targets, a resize brings new targets with new sets.
+        ImTextureID preview = (ImTextureID) rd->get_texture_descriptor_set(v_texture);
+        // the depth is only resolved while the preview is enabled.
+        ImTextureID depth = v_depth != NULL ? (ImTextureID) rd->get_texture_descriptor_set(v_depth) : NULL;
 
-        static ImTextureID depth = NULL;
-        if (depth != NULL)
-            NavUI::RemoveTexture(depth);
-
-        preview = NavUI::AddTexture(v_texture->sampler, v_texture->image_view, v_texture->image_layout);
-        depth = NavUI::AddTexture(v_depth->sampler, v_depth->image_view, v_depth->image_layout);
+        // the scene only covers the top left part of the pooled render target.
+        uint32_t scene_width, scene_height;
+        Renderer3D::get_scene_extent(&scene_width, &scene_height);
+        ImVec2 uv1 = ImVec2((float) scene_width / (float) v_texture->width, (float) scene_height / (float) v_texture->height);
 
         // Main image
         {
             *p_region = ImGui::GetContentRegionAvail();
-            ImGui::Image(preview, ImVec2(p_region->x, p_region->y));
+            ImGui::Image(preview, ImVec2(p_region->x, p_region->y), ImVec2(0.0f, 0.0f), uv1);
+
+            if (depth != NULL && ImGui::IsItemClicked(ImGuiMouseButton_Left) && p_region->x > 0.0f && p_region->y > 0.0f) {
+                ImVec2 cursor = ImGui::GetMousePos();
+                ImVec2 origin = ImGui::GetItemRectMin();
+                uint32_t x = (uint32_t) ((cursor.x - origin.x) / p_region->x * (float) scene_width);
+                uint32_t y = (uint32_t) ((cursor.y - origin.y) / p_region->y * (float) scene_height);
+                pick = Renderer3D::read_scene_depth(x, y);
+            }
+
+            if (pick.valid() && pick.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                RenderDevice::ReadbackResult result = pick.get();
+                picked_depth = !result.data.empty() ? _decode_picked_depth(result) : -1.0f;
+            }
+
+            if (depth != NULL && picked_depth >= 0.0f) {
+                ImGui::SetCursorPos(ImVec2(ImGui::GetCursorStartPos().x + 8.0f, ImGui::GetCursorStartPos().y + 8.0f));
+                ImGui::Text("depth: %.6f", picked_depth);
+            }
         }
 
         // Depth image
-        {
+        if (depth != NULL) {
             ImVec2 position = ImGui::GetWindowPos();
             ImVec2 size = ImGui::GetWindowSize();
 
@@ -55,7 +91,7 @@ static void _draw_scene_editor_ui(RenderDevice::Texture2D *v_texture, RenderDevi
             ImVec2 depth_tex_pos = ImVec2(position.x + offset.x, position.y + size.y - tex_size.y - offset.y);
 
             ImDrawList *draw = ImGui::GetWindowDrawList();
-            draw->AddImage(depth, depth_tex_pos, ImVec2(depth_tex_pos.x + tex_size.x, depth_tex_pos.y + tex_size.y));
+            draw->AddImage(depth, depth_tex_pos, ImVec2(depth_tex_pos.x + tex_size.x, depth_tex_pos.y + tex_size.y), ImVec2(0.0f, 0.0f), uv1);
         }
     }
     NavUI::EndViewport();
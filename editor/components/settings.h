@@ -48,6 +48,7 @@ namespace _child {
         ImGui::SeparatorText("渲染");
         _SETTINGS_INDENT();
         ImGui::Checkbox("显示坐标线", &p_values->render_show_coordinate);
+        ImGui::Checkbox("显示深度预览", &p_values->render_show_depth_preview);
         _SETTINGS_UNINDENT();
     }
 
@@ -22,6 +22,7 @@
 /* ======================================================================== */
 #include "naveditor.h"
 #include "rendering/renderer3d.h"
+#include "rendering/asset_loader.h"
 #include <bright/typedefs.h>
 
 // components
@@ -30,7 +31,6 @@
 #include "components/settings.h"
 #include "components/scene_node_browser.h"
 
-#include <stb/stb_image.h>
 
 #define MENU_ITEM(title) ImGui::MenuItem("        " title)
 
@@ -46,11 +46,11 @@ Naveditor::Naveditor(RenderDevice *v_rd, RenderingScreen *v_screen)
     initialize_info.Device = rdc->get_device();
     initialize_info.QueueFamily = rdc->get_graph_queue_family();
     initialize_info.Queue = rdc->get_graph_queue();
-    initialize_info.DescriptorPool = v_rd->get_descriptor_pool();
-    initialize_info.RenderPass = v_screen->get_render_pass();
+    initialize_info.DescriptorPool = v_rd->get_external_descriptor_pool();
     initialize_info.MinImageCount = v_screen->get_image_buffer_count();
     initialize_info.ImageCount = v_screen->get_image_buffer_count();
     initialize_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    initialize_info.ColorAttachmentFormat = v_screen->get_format();
     NavUI::Initialize(&initialize_info);
 
     _initialize_icon();
@@ -58,9 +58,9 @@ Naveditor::Naveditor(RenderDevice *v_rd, RenderingScreen *v_screen)
 
 Naveditor::~Naveditor()
 {
+    // icon images are owned by the asset loader.
     for (const auto &item: icons) {
         NavUI::RemoveTexture(item.second->texture);
-        rd->destroy_texture(item.second->image);
         free(item.second);
     }
 
@@ -100,12 +100,12 @@ void Naveditor::cmd_end_naveditor_render(VkCommandBuffer cmd_buffer)
 
 void Naveditor::cmd_draw_debugger_editor_ui()
 {
-    _draw_debugger_editor_ui(Debugger::v_debugger_properties);
+    _draw_debugger_editor_ui(rd, Debugger::v_debugger_properties);
 }
 
 void Naveditor::cmd_draw_scene_viewport_ui(RenderDevice::Texture2D *v_texture, RenderDevice::Texture2D *v_depth, ImVec2 *p_region)
 {
-    _draw_scene_editor_ui(v_texture, v_depth, p_region);
+    _draw_scene_editor_ui(rd, v_texture, v_depth, p_region);
 }
 
 void Naveditor::cmd_draw_scene_node_browser()
@@ -126,28 +126,25 @@ void Naveditor::cmd_draw_scene_node_browser()
 
 void Naveditor::_load_icon(const char* name, const char* icon)
 {
-    unsigned char* pixels;
-    int width, height, channels;
-
-    RenderDevice::TextureCreateInfo texture_create_info = {};
-    texture_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
-    texture_create_info.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
-    texture_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-    texture_create_info.image_type = VK_IMAGE_TYPE_2D;
-    texture_create_info.image_view_type = VK_IMAGE_VIEW_TYPE_2D;
-    texture_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-
     Navicon* navicon = (Navicon*)imalloc(sizeof(Navicon));
     navicon->name = name;
-    pixels = stbi_load(icon, &width, &height, &channels, STBI_rgb_alpha);
-    texture_create_info.width = width;
-    texture_create_info.height = height;
-    navicon->image = rd->create_texture(&texture_create_info);
-    rd->bind_texture_sampler(navicon->image, sampler);
-    rd->write_texture(navicon->image, width * height * 4, pixels);
-    navicon->texture = NavUI::AddTexture(navicon->image->sampler, navicon->image->image_view, navicon->image->image_layout);
     icons[navicon->name] = navicon;
-    stbi_image_free(pixels);
+
+    // show the placeholder until the icon is resident, then swap the imgui texture.
+    // imgui keeps the image view in its own set, pin the texture in place.
+    AssetLoader::TextureHandle handle = AssetLoader::load_texture(icon, [this, navicon](RenderDevice::Texture2D *texture) {
+        if (navicon->texture)
+            NavUI::RemoveTexture(navicon->texture);
+        texture->pinned = true;
+        navicon->image = texture;
+        navicon->texture = NavUI::AddTexture(sampler, texture->image_view, texture->image_layout);
+    });
+
+    if (!AssetLoader::is_texture_resident(handle)) {
+        navicon->image = AssetLoader::get_texture(handle);
+        navicon->image->pinned = true;
+        navicon->texture = NavUI::AddTexture(sampler, navicon->image->image_view, navicon->image->image_layout);
+    }
 }
 
 void Naveditor::_initialize_icon()
@@ -164,6 +161,7 @@ void Naveditor::_initialize_icon()
 void Naveditor::_check_values()
 {
     Renderer3D::enable_coordinate_axis(setting_values.render_show_coordinate);
+    Renderer3D::enable_depth_preview(setting_values.render_show_depth_preview);
 
     if (setting_values.imgui_show_demo_window)
         ImGui::ShowDemoWindow(&setting_values.imgui_show_demo_window);
@@ -38,6 +38,7 @@ public:
 
     struct SettingValues {
         bool render_show_coordinate = true;
+        bool render_show_depth_preview = true;
         bool imgui_show_demo_window = false;
     };
 
@@ -23,8 +23,32 @@
 #ifndef _IOUTILS_H_
 #define _IOUTILS_H_
 
+#include <stdint.h>
 #include <fstream>
 #include <bright/memalloc.h>
+#include <bright/error.h>
+
+// read only file mapping, data is NULL when the file is empty.
+struct IOMapping {
+    const char *data = NULL;
+    size_t size = 0;
+    void *file = NULL;
+    void *mapping = NULL;
+};
+
+Error io_map_file(const char *path, IOMapping *p_mapping);
+void io_unmap_file(IOMapping *p_mapping);
+
+// size and last write time of a file, used to detect stale caches.
+Error io_file_stamp(const char *path, uint64_t *p_size, uint64_t *p_mtime);
+// content hash of a memory block or a whole file.
+uint64_t io_hash_bytes(const void *data, size_t size);
+Error io_hash_file(const char *path, uint64_t *p_hash);
+// true when the file still has the stamped content, a touched file falls back to the hash.
+bool io_file_unchanged(const char *path, uint64_t size, uint64_t mtime, uint64_t hash);
+// write through a uniquely named temporary file and rename, readers never see a
+// partial file and concurrent writers never share a temporary file.
+Error io_write_file(const char *path, const void *data, size_t size);
 
 static char *io_read_bytecode(const char *path, size_t *size)
 {
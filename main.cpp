@@ -27,6 +27,7 @@
 #include "rendering/rendering_screen.h"
 #include "utils/fps_counter.h"
 #include "rendering/renderer3d.h"
+#include "rendering/asset_loader.h"
 // editor ui
 #include "editor/naveditor.h"
 // misc
@@ -106,6 +107,8 @@ void initialize()
     rdc->initialize();
     rd = ((RenderDeviceContextWin32 *) rdc)->load_render_device();
 
+    AssetLoader::initialize(rd);
+
     physical = memnew(Physical3D);
 
     screen = memnew(RenderingScreen, rd);
@@ -153,11 +156,17 @@ int main(int argc, char **argv)
     initialize();
 
     while (window->is_close()) {
+        /* wait for the frame slot and release retired resources */
+        rd->begin_frame();
+
         fps_counter.update();
         /* poll events */
         window->poll_events();
         update();
 
+        /* make finished background loads resident */
+        AssetLoader::update();
+
         physical->update_physical_world();
 
         /* render to scene */
@@ -182,16 +191,21 @@ int main(int argc, char **argv)
         screen->cmd_end_screen_render(screen_cmd_buffer);
         double screen_render_end_time = glfwGetTime();
 
+        rd->end_frame();
+
         // set render debug time for debug.
         Debugger::set_scene_render_time_value((scene_render_end_time - scene_render_start_time) * 1000.0f);
         Debugger::set_screen_render_time((screen_render_end_time - screen_render_start_time) * 1000.0f);
         Debugger::set_fps_value(fps_counter.fps());
     }
 
+    rd->wait_idle();
+
     memdel(cube);
     memdel(camera);
     Renderer3D::destroy();
     memdel(naveditor);
+    AssetLoader::destroy();
     memdel(screen);
     memdel(physical);
     ((RenderDeviceContextWin32 *) rdc)->destroy_render_device(rd);
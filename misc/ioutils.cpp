@@ -0,0 +1,226 @@
+/* ======================================================================== */
+/* ioutils.cpp                                                              */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include <bright/ioutils.h>
+#include <atomic>
+#include <filesystem>
+#include <string>
+
+#if defined(_WIN32)
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+Error io_map_file(const char *path, IOMapping *p_mapping)
+{
+    *p_mapping = {};
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return FAIL;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return FAIL;
+    }
+
+    p_mapping->file = file;
+    p_mapping->size = (size_t) size.QuadPart;
+
+    if (p_mapping->size == 0)
+        return OK;
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        *p_mapping = {};
+        return FAIL;
+    }
+
+    p_mapping->mapping = mapping;
+    p_mapping->data = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return FAIL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return FAIL;
+    }
+
+    // keep fd + 1 so that a zero descriptor is not mistaken for no file.
+    p_mapping->file = (void *) (intptr_t) (fd + 1);
+    p_mapping->size = (size_t) st.st_size;
+
+    if (p_mapping->size == 0)
+        return OK;
+
+    void *data = mmap(NULL, p_mapping->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+        madvise(data, p_mapping->size, MADV_SEQUENTIAL);
+        p_mapping->data = (const char *) data;
+    }
+#endif
+
+    if (p_mapping->data == NULL) {
+        io_unmap_file(p_mapping);
+        return FAIL;
+    }
+
+    return OK;
+}
+
+void io_unmap_file(IOMapping *p_mapping)
+{
+#if defined(_WIN32)
+    if (p_mapping->data)
+        UnmapViewOfFile(p_mapping->data);
+    if (p_mapping->mapping)
+        CloseHandle((HANDLE) p_mapping->mapping);
+    if (p_mapping->file)
+        CloseHandle((HANDLE) p_mapping->file);
+#else
+    if (p_mapping->data)
+        munmap((void *) p_mapping->data, p_mapping->size);
+    if (p_mapping->file)
+        close((int) (intptr_t) p_mapping->file - 1);
+#endif
+
+    *p_mapping = {};
+}
+
+Error io_file_stamp(const char *path, uint64_t *p_size, uint64_t *p_mtime)
+{
+    std::error_code ec;
+
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return FAIL;
+
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return FAIL;
+
+    *p_size = size;
+    *p_mtime = (uint64_t) mtime.time_since_epoch().count();
+
+    return OK;
+}
+
+// four independent multiply-mix lanes so the hash keeps up with the memory bus.
+uint64_t io_hash_bytes(const void *p_data, size_t size)
+{
+    const char *data = (const char *) p_data;
+    const uint64_t k = 0x9E3779B97F4A7C15;
+    uint64_t h[4] = { size, k, ~size, k ^ 0xC2B2AE3D27D4EB4F };
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, data + i + lane * 8, 8);
+            h[lane] = (h[lane] ^ word) * k;
+            h[lane] ^= h[lane] >> 31;
+        }
+    }
+
+    for (; i < size; i++)
+        h[i & 3] = (h[i & 3] ^ (uint8_t) data[i]) * k;
+
+    uint64_t hash = h[0] ^ (h[1] * 3) ^ (h[2] * 5) ^ (h[3] * 7);
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCD;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+Error io_hash_file(const char *path, uint64_t *p_hash)
+{
+    IOMapping file;
+    if (io_map_file(path, &file) != OK)
+        return FAIL;
+
+    *p_hash = io_hash_bytes(file.data, file.size);
+    io_unmap_file(&file);
+
+    return OK;
+}
+
+bool io_file_unchanged(const char *path, uint64_t size, uint64_t mtime, uint64_t hash)
+{
+    uint64_t current_size, current_mtime, current_hash;
+    if (io_file_stamp(path, &current_size, &current_mtime) != OK || current_size != size)
+        return false;
+
+    if (current_mtime == mtime)
+        return true;
+
+    return io_hash_file(path, &current_hash) == OK && current_hash == hash;
+}
+
+static uint64_t _process_id()
+{
+#if defined(_WIN32)
+    return (uint64_t) GetCurrentProcessId();
+#else
+    return (uint64_t) getpid();
+#endif
+}
+
+Error io_write_file(const char *path, const void *data, size_t size)
+{
+    // the temporary name is unique per process and call, writers of the same
+    // file never truncate each other's temporary file and the last rename wins.
+    static std::atomic<uint64_t> counter = 0;
+    std::string tmp = std::string(path) + "." + std::to_string(_process_id()) + "." + std::to_string(counter++) + ".tmp";
+
+    FILE *file = fopen(tmp.c_str(), "wb");
+    if (file == NULL)
+        return FAIL;
+
+    size_t written = fwrite(data, 1, size, file);
+    if (fclose(file) != 0 || written != size) {
+        remove(tmp.c_str());
+        return FAIL;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        remove(tmp.c_str());
+        return FAIL;
+    }
+
+    return OK;
+}
@@ -0,0 +1,401 @@
+/* ======================================================================== */
+/* hdr.cpp                                                                  */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "hdr.h"
+#include <bright/error.h>
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <string>
+
+// the avx2 paths are built for every x86 target and picked at runtime, the rest
+// of the engine stays on the baseline instruction set.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define HDR_USE_AVX2
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#  if defined(__GNUC__) || defined(__clang__)
+#    define HDR_TARGET_AVX2 __attribute__((target("avx2,f16c,fma")))
+#  else
+#    define HDR_TARGET_AVX2
+#  endif
+#endif
+
+#define HDR_RGB9E5_MAX 65408.0f /* (2^9 - 1) / 2^9 * 2^16 */
+
+static V_FORCEINLINE uint32_t _float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static V_FORCEINLINE float _bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// round to nearest even, overflow goes to inf and nan stays nan.
+static V_FORCEINLINE uint16_t _float_to_half(float value)
+{
+    uint32_t bits = _float_bits(value);
+    uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+    bits &= 0x7FFFFFFF;
+
+    if (bits >= 0x47800000) /* >= 65536, inf or nan */
+        return sign | (bits > 0x7F800000 ? 0x7E00 : 0x7C00);
+
+    if (bits < 0x38800000) { /* half subnormal or zero, let the fpu round */
+        float f = _bits_float(bits) + 0.5f;
+        return sign | (uint16_t) (_float_bits(f) - 0x3F000000);
+    }
+
+    uint32_t odd = (bits >> 13) & 1;
+    bits += 0xC8000FFF + odd; /* rebias exponent 127 -> 15 and round */
+    return sign | (uint16_t) (bits >> 13);
+}
+
+static V_FORCEINLINE uint32_t _float3_to_rgb9e5(float r, float g, float b)
+{
+    // std::max(x, 0) with the constant first also flushes nan to zero.
+    r = std::min(std::max(0.0f, r), HDR_RGB9E5_MAX);
+    g = std::min(std::max(0.0f, g), HDR_RGB9E5_MAX);
+    b = std::min(std::max(0.0f, b), HDR_RGB9E5_MAX);
+
+    float m = std::max(r, std::max(g, b));
+
+    // floor(log2(m)) straight from the float exponent, clamped to the smallest shared exponent.
+    int32_t exponent = std::max((int32_t) (_float_bits(m) >> 23) - 127, -16) + 16;
+    float scale = _bits_float((uint32_t) (24 - exponent + 127) << 23);
+
+    if ((uint32_t) (m * scale + 0.5f) == 512) {
+        exponent++;
+        scale *= 0.5f;
+    }
+
+    uint32_t rm = (uint32_t) (r * scale + 0.5f);
+    uint32_t gm = (uint32_t) (g * scale + 0.5f);
+    uint32_t bm = (uint32_t) (b * scale + 0.5f);
+
+    return rm | (gm << 9) | (bm << 18) | ((uint32_t) exponent << 27);
+}
+
+#if defined(HDR_USE_AVX2)
+// every cpu with avx2 also has f16c and fma, all three are checked anyway.
+static bool _is_avx2_supported()
+{
+    static const bool supported = [] {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        __cpuid(info, 1);
+        const int required = (1 << 12) /* fma */ | (1 << 27) /* osxsave */ | (1 << 28) /* avx */ | (1 << 29) /* f16c */;
+        if ((info[2] & required) != required || (_xgetbv(0) & 0x6) != 0x6) /* os saves ymm state */
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0; /* avx2 */
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c") && __builtin_cpu_supports("fma");
+#endif
+    }();
+
+    return supported;
+}
+
+// both return the number of values packed, the scalar loop finishes the tail.
+static HDR_TARGET_AVX2 size_t _pack_rgba16f_avx2(const float *src, uint16_t *dst, size_t count)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i *) (dst + i), half);
+    }
+
+    return i;
+}
+
+static HDR_TARGET_AVX2 size_t _pack_rgb9e5_avx2(const float *src, uint32_t *dst, size_t texel_count)
+{
+    size_t i = 0;
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max = _mm256_set1_ps(HDR_RGB9E5_MAX);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    for (; i + 8 <= texel_count; i += 8) {
+        const float *texels = src + i * 4;
+
+        // texel n and n + 4 share a row, so the in-lane transpose yields r/g/b in texel order.
+        __m256 t0 = _mm256_set_m128(_mm_loadu_ps(texels + 16), _mm_loadu_ps(texels + 0));
+        __m256 t1 = _mm256_set_m128(_mm_loadu_ps(texels + 20), _mm_loadu_ps(texels + 4));
+        __m256 t2 = _mm256_set_m128(_mm_loadu_ps(texels + 24), _mm_loadu_ps(texels + 8));
+        __m256 t3 = _mm256_set_m128(_mm_loadu_ps(texels + 28), _mm_loadu_ps(texels + 12));
+
+        __m256 rg01 = _mm256_unpacklo_ps(t0, t1); /* r0 r1 g0 g1 */
+        __m256 rg23 = _mm256_unpacklo_ps(t2, t3); /* r2 r3 g2 g3 */
+        __m256 ba01 = _mm256_unpackhi_ps(t0, t1); /* b0 b1 a0 a1 */
+        __m256 ba23 = _mm256_unpackhi_ps(t2, t3); /* b2 b3 a2 a3 */
+
+        __m256 r = _mm256_castpd_ps(_mm256_unpacklo_pd(_mm256_castps_pd(rg01), _mm256_castps_pd(rg23)));
+        __m256 g = _mm256_castpd_ps(_mm256_unpackhi_pd(_mm256_castps_pd(rg01), _mm256_castps_pd(rg23)));
+        __m256 b = _mm256_castpd_ps(_mm256_unpacklo_pd(_mm256_castps_pd(ba01), _mm256_castps_pd(ba23)));
+
+        // max(x, 0) returns the second operand for nan, so nan flushes to zero.
+        r = _mm256_min_ps(_mm256_max_ps(r, zero), max);
+        g = _mm256_min_ps(_mm256_max_ps(g, zero), max);
+        b = _mm256_min_ps(_mm256_max_ps(b, zero), max);
+
+        __m256 m = _mm256_max_ps(r, _mm256_max_ps(g, b));
+
+        __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(m), 23), _mm256_set1_epi32(127));
+        exponent = _mm256_add_epi32(_mm256_max_epi32(exponent, _mm256_set1_epi32(-16)), _mm256_set1_epi32(16));
+
+        __m256i scale_bits = _mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(24 + 127), exponent), 23);
+        __m256 scale = _mm256_castsi256_ps(scale_bits);
+
+        __m256i mm = _mm256_cvttps_epi32(_mm256_fmadd_ps(m, scale, half));
+        __m256i overflow = _mm256_cmpeq_epi32(mm, _mm256_set1_epi32(512));
+        exponent = _mm256_sub_epi32(exponent, overflow); /* overflow lanes are -1 */
+        scale = _mm256_castsi256_ps(_mm256_add_epi32(scale_bits, _mm256_slli_epi32(overflow, 23)));
+
+        __m256i rm = _mm256_cvttps_epi32(_mm256_fmadd_ps(r, scale, half));
+        __m256i gm = _mm256_cvttps_epi32(_mm256_fmadd_ps(g, scale, half));
+        __m256i bm = _mm256_cvttps_epi32(_mm256_fmadd_ps(b, scale, half));
+
+        __m256i packed = _mm256_or_si256(
+            _mm256_or_si256(rm, _mm256_slli_epi32(gm, 9)),
+            _mm256_or_si256(_mm256_slli_epi32(bm, 18), _mm256_slli_epi32(exponent, 27)));
+
+        _mm256_storeu_si256((__m256i *) (dst + i), packed);
+    }
+
+    return i;
+}
+#endif
+
+void hdr_pack_rgba16f(const float *src, uint16_t *dst, size_t texel_count)
+{
+    size_t count = texel_count * 4;
+    size_t i = 0;
+
+#if defined(HDR_USE_AVX2)
+    if (_is_avx2_supported())
+        i = _pack_rgba16f_avx2(src, dst, count);
+#endif
+
+    for (; i < count; i++)
+        dst[i] = _float_to_half(src[i]);
+}
+
+void hdr_pack_rgb9e5(const float *src, uint32_t *dst, size_t texel_count)
+{
+    size_t i = 0;
+
+#if defined(HDR_USE_AVX2)
+    if (_is_avx2_supported())
+        i = _pack_rgb9e5_avx2(src, dst, texel_count);
+#endif
+
+    for (; i < texel_count; i++)
+        dst[i] = _float3_to_rgb9e5(src[i * 4 + 0], src[i * 4 + 1], src[i * 4 + 2]);
+}
+
+static uint32_t _mip_level_count(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+// 2x2 box filter of rgba32f texels, odd edges repeat the last texel.
+static void _downsample(const float *src, uint32_t width, uint32_t height, float *dst)
+{
+    uint32_t dst_width = std::max(width >> 1, 1u);
+    uint32_t dst_height = std::max(height >> 1, 1u);
+
+    for (uint32_t y = 0; y < dst_height; y++) {
+        const float *row0 = src + (size_t) std::min(y * 2, height - 1) * width * 4;
+        const float *row1 = src + (size_t) std::min(y * 2 + 1, height - 1) * width * 4;
+
+        for (uint32_t x = 0; x < dst_width; x++) {
+            uint32_t x0 = std::min(x * 2, width - 1) * 4;
+            uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+
+            float *texel = dst + ((size_t) y * dst_width + x) * 4;
+            for (int c = 0; c < 4; c++)
+                texel[c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+        }
+    }
+}
+
+size_t HdrImage::_level_size(uint32_t width, uint32_t height, uint32_t texel_size, uint32_t level)
+{
+    return (size_t) std::max(width >> level, 1u) * std::max(height >> level, 1u) * texel_size;
+}
+
+size_t HdrImage::get_size() const
+{
+    return get_level_offset(header->mip_levels);
+}
+
+size_t HdrImage::get_level_offset(uint32_t level) const
+{
+    size_t offset = 0;
+    for (uint32_t i = 0; i < level; i++)
+        offset += _level_size(header->width, header->height, header->texel_size, i);
+    return offset;
+}
+
+static bool _validate(const IOMapping &mapping, HdrFormat format, bool mipmaps)
+{
+    if (mapping.size < sizeof(HdrImage::Header))
+        return false;
+
+    const HdrImage::Header *header = (const HdrImage::Header *) mapping.data;
+    if (header->magic != HDR_CACHE_MAGIC || header->version != HDR_CACHE_VERSION)
+        return false;
+
+    if (header->file_size != mapping.size || header->format != (uint32_t) format)
+        return false;
+
+    uint32_t mip_levels = mipmaps ? _mip_level_count(header->width, header->height) : 1;
+    if (header->mip_levels != mip_levels)
+        return false;
+
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < mip_levels; i++)
+        size += (uint64_t) std::max(header->width >> i, 1u) * std::max(header->height >> i, 1u) * header->texel_size;
+
+    return header->pixel_offset <= mapping.size && size <= mapping.size - header->pixel_offset;
+}
+
+HdrImage::~HdrImage()
+{
+    io_unmap_file(&mapping);
+}
+
+HdrImage *HdrImage::load(const char *filepath, HdrFormat format, bool v_mipmaps)
+{
+    std::string cache_path = std::string(filepath) + HDR_CACHE_EXTENSION;
+
+    uint64_t source_size = 0, source_mtime = 0, source_hash = 0;
+    bool has_source = io_file_stamp(filepath, &source_size, &source_mtime) == OK;
+
+    HdrImage *image = memnew(HdrImage);
+
+    if (io_map_file(cache_path.c_str(), &image->mapping) == OK) {
+        bool fresh = _validate(image->mapping, format, v_mipmaps);
+
+        // shipped without the source image, trust the cache.
+        if (fresh && has_source) {
+            const Header *header = (const Header *) image->mapping.data;
+            fresh = io_file_unchanged(filepath, header->source_size, header->source_mtime, header->source_hash);
+        }
+
+        if (fresh) {
+            image->data = image->mapping.data;
+            image->header = (const Header *) image->data;
+            return image;
+        }
+
+        io_unmap_file(&image->mapping);
+    }
+
+    int width, height, channels;
+    float *pixels = has_source ? stbi_loadf(filepath, &width, &height, &channels, STBI_rgb_alpha) : NULL;
+    if (!pixels || io_hash_file(filepath, &source_hash) != OK) {
+        stbi_image_free(pixels);
+        memdel(image);
+        return NULL;
+    }
+
+    Header header = {};
+    header.magic = HDR_CACHE_MAGIC;
+    header.version = HDR_CACHE_VERSION;
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+    header.source_hash = source_hash;
+    header.format = format;
+    header.width = (uint32_t) width;
+    header.height = (uint32_t) height;
+    header.texel_size = format == HDR_FORMAT_RGB9E5 ? sizeof(uint32_t) : sizeof(uint16_t) * 4;
+    header.mip_levels = v_mipmaps ? _mip_level_count(header.width, header.height) : 1;
+    header.pixel_offset = sizeof(Header);
+
+    uint64_t pixel_size = 0;
+    for (uint32_t i = 0; i < header.mip_levels; i++)
+        pixel_size += _level_size(header.width, header.height, header.texel_size, i);
+    header.file_size = header.pixel_offset + pixel_size;
+
+    image->blob.resize(header.file_size);
+    memcpy(image->blob.data(), &header, sizeof(header));
+
+    // filter in float before packing, each level is packed right after the previous one.
+    char *dst = image->blob.data() + header.pixel_offset;
+    std::vector<float> scratch;
+    const float *level_pixels = pixels;
+
+    for (uint32_t i = 0; i < header.mip_levels; i++) {
+        uint32_t level_width = std::max(header.width >> i, 1u);
+        uint32_t level_height = std::max(header.height >> i, 1u);
+        size_t texel_count = (size_t) level_width * level_height;
+
+        if (format == HDR_FORMAT_RGB9E5)
+            hdr_pack_rgb9e5(level_pixels, (uint32_t *) dst, texel_count);
+        else
+            hdr_pack_rgba16f(level_pixels, (uint16_t *) dst, texel_count);
+
+        dst += texel_count * header.texel_size;
+
+        if (i + 1 < header.mip_levels) {
+            std::vector<float> next((size_t) std::max(level_width >> 1, 1u) * std::max(level_height >> 1, 1u) * 4);
+            _downsample(level_pixels, level_width, level_height, next.data());
+            scratch.swap(next);
+            level_pixels = scratch.data();
+        }
+    }
+
+    stbi_image_free(pixels);
+
+    if (io_write_file(cache_path.c_str(), image->blob.data(), image->blob.size()) != OK)
+        fprintf(stderr, "-engine warning: can not write hdr cache: %s\n", cache_path.c_str());
+
+    image->data = image->blob.data();
+    image->header = (const Header *) image->data;
+
+    return image;
+}
+
+void HdrImage::destroy(HdrImage *image)
+{
+    memdel(image);
+}
@@ -0,0 +1,93 @@
+/* ======================================================================== */
+/* hdr.h                                                                    */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _HDR_H_
+#define _HDR_H_
+
+#include <bright/typedefs.h>
+#include <bright/ioutils.h>
+#include <vector>
+
+#define HDR_CACHE_MAGIC 0x52444842 /* BHDR */
+#define HDR_CACHE_VERSION 2
+#define HDR_CACHE_EXTENSION ".bhdr"
+
+enum HdrFormat {
+    HDR_FORMAT_RGBA16F, /* VK_FORMAT_R16G16B16A16_SFLOAT */
+    HDR_FORMAT_RGB9E5, /* VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 */
+};
+
+// rgba32f texels to packed gpu formats, F16C/AVX2 when the cpu supports them.
+void hdr_pack_rgba16f(const float *src, uint16_t *dst, size_t texel_count);
+void hdr_pack_rgb9e5(const float *src, uint32_t *dst, size_t texel_count);
+
+/*
+ * hdr image packed for upload. the packed texels are cached next to the source
+ * (e.g. puresky_2k.hdr.bhdr) and memory mapped on later loads, so the radiance
+ * file is only decoded once.
+ */
+class HdrImage {
+public:
+    ~HdrImage();
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t file_size;
+        /* source stamp */
+        uint64_t source_size;
+        uint64_t source_mtime;
+        uint64_t source_hash;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t texel_size;
+        uint32_t mip_levels;
+        uint32_t _reserved;
+        uint64_t pixel_offset;
+    };
+
+    V_FORCEINLINE uint32_t get_width() const { return header->width; }
+    V_FORCEINLINE uint32_t get_height() const { return header->height; }
+    V_FORCEINLINE HdrFormat get_format() const { return (HdrFormat) header->format; }
+    V_FORCEINLINE uint32_t get_mip_levels() const { return header->mip_levels; }
+    V_FORCEINLINE const void *get_pixels() const { return data + header->pixel_offset; }
+    size_t get_size() const; /* all mip levels */
+    size_t get_level_offset(uint32_t level) const; /* from get_pixels() */
+
+    // static, returns NULL when the file can not be decoded. with v_mipmaps
+    // the full mip chain is box filtered on the cpu, for formats that can not be blit.
+    static HdrImage *load(const char *filepath, HdrFormat format, bool v_mipmaps);
+    static void destroy(HdrImage *image);
+
+private:
+    U_MEMNEW_ONLY HdrImage() { /* do nothing... */ }
+
+    static size_t _level_size(uint32_t width, uint32_t height, uint32_t texel_size, uint32_t level);
+
+    IOMapping mapping = {};
+    std::vector<char> blob; /* used when the cache file can not be written */
+    const char *data = NULL;
+    const Header *header = NULL;
+};
+
+#endif /* _HDR_H_ */
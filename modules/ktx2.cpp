@@ -0,0 +1,327 @@
+/* ======================================================================== */
+/* ktx2.cpp                                                                 */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "ktx2.h"
+#include <bright/error.h>
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+static const uint8_t ktx2_identifier[KTX2_IDENTIFIER_SIZE] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A /* «KTX 20»\r\n\x1A\n */
+};
+
+/* data format descriptor, khronos data format specification 1.3 */
+#define KHR_DF_VERSION 2
+#define KHR_DF_MODEL_RGBSDA 1
+#define KHR_DF_MODEL_BC1A 128
+#define KHR_DF_MODEL_BC2 129
+#define KHR_DF_MODEL_BC3 130
+#define KHR_DF_MODEL_BC4 131
+#define KHR_DF_MODEL_BC5 132
+#define KHR_DF_MODEL_BC6H 133
+#define KHR_DF_MODEL_BC7 134
+#define KHR_DF_PRIMARIES_BT709 1
+#define KHR_DF_TRANSFER_LINEAR 1
+#define KHR_DF_TRANSFER_SRGB 2
+#define KHR_DF_SAMPLE_LINEAR 0x10
+#define KHR_DF_SAMPLE_SIGNED 0x40
+#define KHR_DF_SAMPLE_FLOAT 0x80
+#define KHR_DF_CHANNEL_ALPHA 15
+
+bool ktx2_get_format_info(VkFormat format, Ktx2FormatInfo *p_info)
+{
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            *p_info = { 8, 4, 4, true };
+            return true;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            *p_info = { 16, 4, 4, true };
+            return true;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+            *p_info = { 4, 1, 1, false };
+            return true;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            *p_info = { 8, 1, 1, false };
+            return true;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            *p_info = { 16, 1, 1, false };
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint64_t _level_size(const Ktx2FormatInfo &info, uint32_t width, uint32_t height, uint32_t layers, uint32_t level)
+{
+    uint64_t blocks_x = (std::max(width >> level, 1u) + info.block_width - 1) / info.block_width;
+    uint64_t blocks_y = (std::max(height >> level, 1u) + info.block_height - 1) / info.block_height;
+    return blocks_x * blocks_y * info.block_size * layers;
+}
+
+static uint32_t _level_alignment(const Ktx2FormatInfo &info)
+{
+    return std::lcm(info.block_size, 4u);
+}
+
+// levels of the full mip chain, down to 1x1.
+static uint32_t _max_level_count(uint32_t width, uint32_t height)
+{
+    return (uint32_t) std::bit_width(std::max(width, height));
+}
+
+static bool _validate(const IOMapping &mapping)
+{
+    if (mapping.size < sizeof(Ktx2Image::Header))
+        return false;
+
+    const Ktx2Image::Header *header = (const Ktx2Image::Header *) mapping.data;
+    if (memcmp(header->identifier, ktx2_identifier, KTX2_IDENTIFIER_SIZE) != 0)
+        return false;
+
+    if (header->supercompression_scheme != 0) {
+        fprintf(stderr, "-engine warning: ktx2 supercompression is not supported\n");
+        return false;
+    }
+
+    // cube maps and 3d textures have no texture type yet.
+    if (header->pixel_width == 0 || header->pixel_height == 0 || header->pixel_depth > 1 || header->face_count != 1)
+        return false;
+
+    Ktx2FormatInfo info;
+    if (!ktx2_get_format_info((VkFormat) header->vk_format, &info))
+        return false;
+
+    uint32_t level_count = std::max(header->level_count, 1u);
+    if (level_count > _max_level_count(header->pixel_width, header->pixel_height))
+        return false;
+    if (mapping.size < sizeof(Ktx2Image::Header) + level_count * sizeof(Ktx2Image::Level))
+        return false;
+
+    const Ktx2Image::Level *levels = (const Ktx2Image::Level *) (mapping.data + sizeof(Ktx2Image::Header));
+    uint32_t layers = std::max(header->layer_count, 1u);
+    uint32_t alignment = _level_alignment(info);
+
+    for (uint32_t i = 0; i < level_count; i++) {
+        if (levels[i].byte_offset % alignment != 0)
+            return false;
+        if (levels[i].byte_length < _level_size(info, header->pixel_width, header->pixel_height, layers, i))
+            return false;
+        if (levels[i].byte_length > mapping.size || levels[i].byte_offset > mapping.size - levels[i].byte_length)
+            return false;
+    }
+
+    return true;
+}
+
+Ktx2Image::~Ktx2Image()
+{
+    io_unmap_file(&mapping);
+}
+
+Ktx2Image *Ktx2Image::load(const char *filepath)
+{
+    Ktx2Image *image = memnew(Ktx2Image);
+
+    if (io_map_file(filepath, &image->mapping) != OK || !_validate(image->mapping)) {
+        memdel(image);
+        return NULL;
+    }
+
+    image->header = (const Header *) image->mapping.data;
+    image->levels = (const Level *) (image->mapping.data + sizeof(Header));
+
+    return image;
+}
+
+void Ktx2Image::destroy(Ktx2Image *image)
+{
+    memdel(image);
+}
+
+template<typename T>
+static void _push(std::vector<char> &blob, T value)
+{
+    blob.insert(blob.end(), (const char *) &value, (const char *) &value + sizeof(value));
+}
+
+static void _push_sample(std::vector<char> &blob, uint16_t bit_offset, uint32_t bit_length, uint8_t channel_type, uint32_t lower, uint32_t upper)
+{
+    _push<uint16_t>(blob, bit_offset);
+    _push<uint8_t>(blob, (uint8_t) (bit_length - 1));
+    _push<uint8_t>(blob, channel_type);
+    _push<uint32_t>(blob, 0); /* sample position */
+    _push<uint32_t>(blob, lower);
+    _push<uint32_t>(blob, upper);
+}
+
+// basic data format descriptor block, one sample per channel or per bc sub block.
+static bool _write_dfd(std::vector<char> &blob, VkFormat format, const Ktx2FormatInfo &info, bool srgb)
+{
+    std::vector<char> samples;
+    uint8_t model;
+
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            model = KHR_DF_MODEL_BC1A;
+            _push_sample(samples, 0, 64, 0, 0, UINT32_MAX);
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            model = KHR_DF_MODEL_BC3;
+            _push_sample(samples, 0, 64, KHR_DF_CHANNEL_ALPHA | (srgb ? KHR_DF_SAMPLE_LINEAR : 0), 0, UINT32_MAX);
+            _push_sample(samples, 64, 64, 0, 0, UINT32_MAX);
+            break;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            model = KHR_DF_MODEL_BC4;
+            _push_sample(samples, 0, 64, 0, 0, UINT32_MAX);
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            model = KHR_DF_MODEL_BC5;
+            _push_sample(samples, 0, 64, 0, 0, UINT32_MAX);
+            _push_sample(samples, 64, 64, 1, 0, UINT32_MAX);
+            break;
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+            model = KHR_DF_MODEL_BC6H;
+            _push_sample(samples, 0, 128, KHR_DF_SAMPLE_FLOAT, 0, 0x3F800000 /* 1.0f */);
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            model = KHR_DF_MODEL_BC7;
+            _push_sample(samples, 0, 128, 0, 0, UINT32_MAX);
+            break;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            model = KHR_DF_MODEL_RGBSDA;
+            for (uint8_t c = 0; c < 4; c++)
+                _push_sample(samples, c * 8, 8, c == 3 ? KHR_DF_CHANNEL_ALPHA | (srgb ? KHR_DF_SAMPLE_LINEAR : 0) : c, 0, 255);
+            break;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32B32A32_SFLOAT: {
+            model = KHR_DF_MODEL_RGBSDA;
+            uint32_t bits = info.block_size * 2;
+            for (uint8_t c = 0; c < 4; c++)
+                _push_sample(samples, c * bits, bits, (c == 3 ? KHR_DF_CHANNEL_ALPHA : c) | KHR_DF_SAMPLE_FLOAT | KHR_DF_SAMPLE_SIGNED,
+                             0xBF800000 /* -1.0f */, 0x3F800000 /* 1.0f */);
+            break;
+        }
+        default:
+            return false;
+    }
+
+    uint16_t block_size = (uint16_t) (24 + samples.size());
+
+    _push<uint32_t>(blob, 4 + block_size); /* dfd total size */
+    _push<uint32_t>(blob, 0); /* vendor khronos, descriptor type basic */
+    _push<uint16_t>(blob, KHR_DF_VERSION);
+    _push<uint16_t>(blob, block_size);
+    _push<uint8_t>(blob, model);
+    _push<uint8_t>(blob, KHR_DF_PRIMARIES_BT709);
+    _push<uint8_t>(blob, srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR);
+    _push<uint8_t>(blob, 0); /* straight alpha */
+    _push<uint8_t>(blob, (uint8_t) (info.block_width - 1));
+    _push<uint8_t>(blob, (uint8_t) (info.block_height - 1));
+    _push<uint8_t>(blob, 0);
+    _push<uint8_t>(blob, 0);
+    _push<uint8_t>(blob, (uint8_t) info.block_size); /* bytes plane 0 */
+    for (int i = 1; i < 8; i++)
+        _push<uint8_t>(blob, 0);
+
+    blob.insert(blob.end(), samples.begin(), samples.end());
+    return true;
+}
+
+Error Ktx2Image::save(const char *filepath, const WriteInfo *p_info)
+{
+    Ktx2FormatInfo info;
+    if (!ktx2_get_format_info(p_info->format, &info) || p_info->levels.empty())
+        return FAIL;
+
+    uint32_t level_count = (uint32_t) p_info->levels.size();
+    uint32_t layers = std::max(p_info->layers, 1u);
+
+    if (p_info->width == 0 || p_info->height == 0 || level_count > _max_level_count(p_info->width, p_info->height))
+        return FAIL;
+
+    for (uint32_t i = 0; i < level_count; i++) {
+        if (p_info->levels[i].size() != _level_size(info, p_info->width, p_info->height, layers, i))
+            return FAIL;
+    }
+
+    std::vector<char> blob(sizeof(Header) + level_count * sizeof(Level));
+
+    Header header = {};
+    memcpy(header.identifier, ktx2_identifier, KTX2_IDENTIFIER_SIZE);
+    header.vk_format = p_info->format;
+    header.type_size = info.compressed ? 1 : (info.block_size == 4 ? 1 : info.block_size / 4);
+    header.pixel_width = p_info->width;
+    header.pixel_height = p_info->height;
+    header.layer_count = p_info->layers > 1 ? p_info->layers : 0;
+    header.face_count = 1;
+    header.level_count = level_count;
+
+    header.dfd_byte_offset = (uint32_t) blob.size();
+    if (!_write_dfd(blob, p_info->format, info, p_info->srgb))
+        return FAIL;
+    header.dfd_byte_length = (uint32_t) blob.size() - header.dfd_byte_offset;
+
+    // key and value data, one entry padded to 4 bytes.
+    static const char writer[] = "KTXwriter\0Bright Engine";
+    header.kvd_byte_offset = (uint32_t) blob.size();
+    _push<uint32_t>(blob, sizeof(writer));
+    blob.insert(blob.end(), writer, writer + sizeof(writer));
+    blob.resize((blob.size() + 3) & ~(size_t) 3);
+    header.kvd_byte_length = (uint32_t) blob.size() - header.kvd_byte_offset;
+
+    // the smallest level is stored first.
+    std::vector<Level> levels(level_count);
+    uint32_t alignment = _level_alignment(info);
+    for (int32_t i = (int32_t) level_count - 1; i >= 0; i--) {
+        blob.resize((blob.size() + alignment - 1) / alignment * alignment);
+        levels[i].byte_offset = blob.size();
+        levels[i].byte_length = p_info->levels[i].size();
+        levels[i].uncompressed_byte_length = levels[i].byte_length;
+        blob.insert(blob.end(), p_info->levels[i].begin(), p_info->levels[i].end());
+    }
+
+    memcpy(blob.data(), &header, sizeof(header));
+    memcpy(blob.data() + sizeof(header), levels.data(), levels.size() * sizeof(Level));
+
+    return io_write_file(filepath, blob.data(), blob.size());
+}
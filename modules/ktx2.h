@@ -0,0 +1,113 @@
+/* ======================================================================== */
+/* ktx2.h                                                                   */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _KTX2_H_
+#define _KTX2_H_
+
+#include <bright/typedefs.h>
+#include <bright/ioutils.h>
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#define KTX2_EXTENSION ".ktx2"
+#define KTX2_IDENTIFIER_SIZE 12
+
+// block footprint of the formats a ktx2 file may carry, block_width is 1 for plain texels.
+struct Ktx2FormatInfo {
+    uint32_t block_size;
+    uint32_t block_width;
+    uint32_t block_height;
+    bool compressed;
+};
+
+// false when the format is not supported by the loader.
+bool ktx2_get_format_info(VkFormat format, Ktx2FormatInfo *p_info);
+
+/*
+ * khronos ktx2 container, memory mapped. only 2d images and 2d arrays without
+ * supercompression are accepted, levels are read in place and copied to the
+ * staging buffer as is, the level alignment of the format is kept by the file.
+ */
+class Ktx2Image {
+public:
+    ~Ktx2Image();
+
+    struct Header {
+        uint8_t identifier[KTX2_IDENTIFIER_SIZE];
+        uint32_t vk_format;
+        uint32_t type_size;
+        uint32_t pixel_width;
+        uint32_t pixel_height;
+        uint32_t pixel_depth;
+        uint32_t layer_count;
+        uint32_t face_count;
+        uint32_t level_count;
+        uint32_t supercompression_scheme;
+        /* index */
+        uint32_t dfd_byte_offset;
+        uint32_t dfd_byte_length;
+        uint32_t kvd_byte_offset;
+        uint32_t kvd_byte_length;
+        uint64_t sgd_byte_offset;
+        uint64_t sgd_byte_length;
+    };
+
+    struct Level {
+        uint64_t byte_offset;
+        uint64_t byte_length;
+        uint64_t uncompressed_byte_length;
+    };
+
+    V_FORCEINLINE VkFormat get_format() const { return (VkFormat) header->vk_format; }
+    V_FORCEINLINE uint32_t get_width() const { return header->pixel_width; }
+    V_FORCEINLINE uint32_t get_height() const { return header->pixel_height; }
+    V_FORCEINLINE uint32_t get_layers() const { return header->layer_count ? header->layer_count : 1; }
+    // 0 when the file asks the loader to generate the mip chain.
+    V_FORCEINLINE uint32_t get_mip_levels() const { return header->level_count; }
+    V_FORCEINLINE const Level *get_level(uint32_t level) const { return levels + level; }
+    V_FORCEINLINE const char *get_data() const { return mapping.data; }
+
+    // static, returns NULL when the file is missing or not supported.
+    static Ktx2Image *load(const char *filepath);
+    static void destroy(Ktx2Image *image);
+
+    struct WriteInfo {
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t layers;
+        bool srgb;
+        // level 0 first, each level holds all layers back to back.
+        std::vector<std::vector<char>> levels;
+    };
+
+    static Error save(const char *filepath, const WriteInfo *p_info);
+
+private:
+    U_MEMNEW_ONLY Ktx2Image() { /* do nothing... */ }
+
+    IOMapping mapping = {};
+    const Header *header = NULL;
+    const Level *levels = NULL;
+};
+
+#endif /* _KTX2_H_ */
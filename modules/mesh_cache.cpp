@@ -0,0 +1,366 @@
+/* ======================================================================== */
+/* mesh_cache.cpp                                                           */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "mesh_cache.h"
+#include <bright/error.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+
+typedef ObjLoader::Vertex Vertex;
+
+static V_FORCEINLINE size_t _align(size_t size)
+{
+    return (size + MESH_CACHE_ALIGNMENT - 1) & ~((size_t) MESH_CACHE_ALIGNMENT - 1);
+}
+
+static void _compute_bounds(const Vertex *vertices, size_t vertex_count, MeshCache::Bounds *p_bounds)
+{
+    vec3 min = vertex_count ? vertices[0].position : vec3(0.0f);
+    vec3 max = min;
+
+    for (size_t i = 0; i < vertex_count; i++) {
+        min = glm::min(min, vertices[i].position);
+        max = glm::max(max, vertices[i].position);
+    }
+
+    vec3 center = (min + max) * 0.5f;
+    float radius = 0.0f;
+    for (size_t i = 0; i < vertex_count; i++)
+        radius = std::max(radius, glm::distance(center, vertices[i].position));
+
+    for (int i = 0; i < 3; i++) {
+        p_bounds->min[i] = min[i];
+        p_bounds->max[i] = max[i];
+        p_bounds->center[i] = center[i];
+    }
+
+    p_bounds->radius = radius;
+}
+
+// simplify lod 0 by vertex clustering on a uniform grid, every cluster collapses
+// onto the source vertex nearest to its centroid, so all lods share one vertex
+// buffer and only the index ranges differ.
+static void _build_lods(const std::vector<Vertex> &vertices, const MeshCache::Bounds &bounds,
+                        std::vector<uint32_t> *p_indices, std::vector<MeshCache::Lod> *p_lods)
+{
+    const uint32_t base_count = (uint32_t) p_indices->size();
+    p_lods->push_back({ 0, base_count, 0.0f, 0 });
+
+    vec3 min = { bounds.min[0], bounds.min[1], bounds.min[2] };
+    vec3 max = { bounds.max[0], bounds.max[1], bounds.max[2] };
+    float extent = std::max({ max.x - min.x, max.y - min.y, max.z - min.z });
+    if (extent <= 0.0f || vertices.empty())
+        return;
+
+    std::vector<uint32_t> cluster_of(vertices.size());
+    std::vector<uint32_t> remap;
+    std::vector<vec4> centroids;
+    std::unordered_map<uint64_t, uint32_t> clusters;
+
+    uint32_t previous_count = base_count;
+    float base_resolution = sqrtf((float) vertices.size());
+
+    for (uint32_t level = 1; level < 16 && p_lods->size() < MESH_CACHE_MAX_LODS; level++) {
+        uint32_t resolution = (uint32_t) (base_resolution / (float) (1u << level));
+        if (resolution < 2)
+            break;
+
+        float cell = extent / (float) resolution;
+
+        clusters.clear();
+        centroids.clear();
+
+        for (size_t i = 0; i < vertices.size(); i++) {
+            vec3 grid = (vertices[i].position - min) / cell;
+            uint64_t x = std::min((uint32_t) grid.x, resolution - 1);
+            uint64_t y = std::min((uint32_t) grid.y, resolution - 1);
+            uint64_t z = std::min((uint32_t) grid.z, resolution - 1);
+
+            auto [it, inserted] = clusters.try_emplace(x | (y << 21) | (z << 42), (uint32_t) centroids.size());
+            if (inserted)
+                centroids.push_back(vec4(0.0f));
+
+            centroids[it->second] += vec4(vertices[i].position, 1.0f);
+            cluster_of[i] = it->second;
+        }
+
+        // pick the vertex nearest to each cluster centroid.
+        std::vector<float> nearest(centroids.size(), INFINITY);
+        remap.assign(centroids.size(), 0);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            uint32_t c = cluster_of[i];
+            vec3 centroid = vec3(centroids[c]) / centroids[c].w;
+            float d = glm::distance(centroid, vertices[i].position);
+            if (d < nearest[c]) {
+                nearest[c] = d;
+                remap[c] = (uint32_t) i;
+            }
+        }
+
+        uint32_t offset = (uint32_t) p_indices->size();
+        for (uint32_t i = 0; i + 2 < base_count; i += 3) {
+            uint32_t a = remap[cluster_of[(*p_indices)[i + 0]]];
+            uint32_t b = remap[cluster_of[(*p_indices)[i + 1]]];
+            uint32_t c = remap[cluster_of[(*p_indices)[i + 2]]];
+
+            if (a == b || b == c || a == c)
+                continue;
+
+            p_indices->push_back(a);
+            p_indices->push_back(b);
+            p_indices->push_back(c);
+        }
+
+        uint32_t count = (uint32_t) p_indices->size() - offset;
+        if (count == 0) {
+            p_indices->resize(offset);
+            break;
+        }
+
+        // not simplified enough to be worth a lod, try a coarser grid.
+        if (count * 5 > previous_count * 4) {
+            p_indices->resize(offset);
+            continue;
+        }
+
+        p_lods->push_back({ offset, count, cell, 0 });
+        previous_count = count;
+    }
+}
+
+// greedily pack consecutive triangles of lod 0 into meshlets.
+static void _build_meshlets(const std::vector<Vertex> &vertices, const uint32_t *indices, uint32_t index_count,
+                            std::vector<MeshCache::Meshlet> *p_meshlets, std::vector<uint32_t> *p_meshlet_vertices,
+                            std::vector<uint8_t> *p_meshlet_triangles)
+{
+    std::vector<uint32_t> stamp(vertices.size(), UINT32_MAX);
+    std::vector<uint8_t> local(vertices.size());
+
+    MeshCache::Meshlet meshlet = {};
+
+    auto flush = [&]() {
+        if (meshlet.triangle_count == 0)
+            return;
+
+        const uint32_t *meshlet_vertices = p_meshlet_vertices->data() + meshlet.vertex_offset;
+
+        vec3 min = vertices[meshlet_vertices[0]].position;
+        vec3 max = min;
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+            min = glm::min(min, vertices[meshlet_vertices[i]].position);
+            max = glm::max(max, vertices[meshlet_vertices[i]].position);
+        }
+
+        vec3 center = (min + max) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t i = 0; i < meshlet.vertex_count; i++)
+            radius = std::max(radius, glm::distance(center, vertices[meshlet_vertices[i]].position));
+
+        meshlet.center[0] = center.x;
+        meshlet.center[1] = center.y;
+        meshlet.center[2] = center.z;
+        meshlet.radius = radius;
+        p_meshlets->push_back(meshlet);
+
+        // keep every meshlet's triangle list 4 bytes aligned.
+        p_meshlet_triangles->resize((p_meshlet_triangles->size() + 3) & ~(size_t) 3);
+
+        meshlet = {};
+        meshlet.vertex_offset = (uint32_t) p_meshlet_vertices->size();
+        meshlet.triangle_offset = (uint32_t) p_meshlet_triangles->size();
+    };
+
+    for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+        const uint32_t id = (uint32_t) p_meshlets->size();
+        const uint32_t *triangle = indices + i;
+
+        uint32_t missing = 0;
+        for (int k = 0; k < 3; k++)
+            missing += stamp[triangle[k]] != id;
+
+        if (meshlet.vertex_count + missing > MESH_CACHE_MESHLET_MAX_VERTICES || meshlet.triangle_count + 1 > MESH_CACHE_MESHLET_MAX_TRIANGLES)
+            flush();
+
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = triangle[k];
+            if (stamp[v] != (uint32_t) p_meshlets->size()) {
+                stamp[v] = (uint32_t) p_meshlets->size();
+                local[v] = (uint8_t) meshlet.vertex_count++;
+                p_meshlet_vertices->push_back(v);
+            }
+
+            p_meshlet_triangles->push_back(local[v]);
+        }
+
+        meshlet.triangle_count++;
+    }
+
+    flush();
+}
+
+static void _serialize(const ObjLoader *loader, uint64_t source_size, uint64_t source_mtime, uint64_t source_hash, std::vector<char> *p_blob)
+{
+    const std::vector<Vertex> &vertices = loader->get_vertices();
+
+    MeshCache::Header header = {};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+    header.source_hash = source_hash;
+    header.vertex_stride = sizeof(Vertex);
+    header.vertex_count = (uint32_t) vertices.size();
+
+    _compute_bounds(vertices.data(), vertices.size(), &header.bounds);
+
+    std::vector<uint32_t> indices = loader->get_indices();
+    std::vector<MeshCache::Lod> lods;
+    _build_lods(vertices, header.bounds, &indices, &lods);
+
+    std::vector<MeshCache::Meshlet> meshlets;
+    std::vector<uint32_t> meshlet_vertices;
+    std::vector<uint8_t> meshlet_triangles;
+    _build_meshlets(vertices, indices.data(), lods[0].index_count, &meshlets, &meshlet_vertices, &meshlet_triangles);
+
+    header.index_count = (uint32_t) indices.size();
+    header.lod_count = (uint32_t) lods.size();
+    header.meshlet_count = (uint32_t) meshlets.size();
+    header.meshlet_vertex_count = (uint32_t) meshlet_vertices.size();
+    header.meshlet_triangle_size = (uint32_t) meshlet_triangles.size();
+
+    size_t offset = _align(sizeof(MeshCache::Header));
+    header.vertex_offset = offset;
+    offset = _align(offset + vertices.size() * sizeof(Vertex));
+    header.index_offset = offset;
+    offset = _align(offset + indices.size() * sizeof(uint32_t));
+    header.lod_offset = offset;
+    offset = _align(offset + lods.size() * sizeof(MeshCache::Lod));
+    header.meshlet_offset = offset;
+    offset = _align(offset + meshlets.size() * sizeof(MeshCache::Meshlet));
+    header.meshlet_vertex_offset = offset;
+    offset = _align(offset + meshlet_vertices.size() * sizeof(uint32_t));
+    header.meshlet_triangle_offset = offset;
+    offset = _align(offset + meshlet_triangles.size());
+    header.file_size = offset;
+
+    p_blob->assign(offset, 0);
+    char *dst = p_blob->data();
+    memcpy(dst, &header, sizeof(header));
+    memcpy(dst + header.vertex_offset, vertices.data(), vertices.size() * sizeof(Vertex));
+    memcpy(dst + header.index_offset, indices.data(), indices.size() * sizeof(uint32_t));
+    memcpy(dst + header.lod_offset, lods.data(), lods.size() * sizeof(MeshCache::Lod));
+    memcpy(dst + header.meshlet_offset, meshlets.data(), meshlets.size() * sizeof(MeshCache::Meshlet));
+    memcpy(dst + header.meshlet_vertex_offset, meshlet_vertices.data(), meshlet_vertices.size() * sizeof(uint32_t));
+    memcpy(dst + header.meshlet_triangle_offset, meshlet_triangles.data(), meshlet_triangles.size());
+}
+
+static V_FORCEINLINE bool _section_in_range(uint64_t offset, uint64_t size, uint64_t file_size)
+{
+    return offset % MESH_CACHE_ALIGNMENT == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+static bool _validate(const IOMapping &mapping)
+{
+    if (mapping.size < sizeof(MeshCache::Header))
+        return false;
+
+    const MeshCache::Header *header = (const MeshCache::Header *) mapping.data;
+    if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION)
+        return false;
+
+    if (header->file_size != mapping.size || header->vertex_stride != sizeof(Vertex) || header->lod_count == 0)
+        return false;
+
+    if (!_section_in_range(header->vertex_offset, (uint64_t) header->vertex_count * sizeof(Vertex), mapping.size) ||
+        !_section_in_range(header->index_offset, (uint64_t) header->index_count * sizeof(uint32_t), mapping.size) ||
+        !_section_in_range(header->lod_offset, (uint64_t) header->lod_count * sizeof(MeshCache::Lod), mapping.size) ||
+        !_section_in_range(header->meshlet_offset, (uint64_t) header->meshlet_count * sizeof(MeshCache::Meshlet), mapping.size) ||
+        !_section_in_range(header->meshlet_vertex_offset, (uint64_t) header->meshlet_vertex_count * sizeof(uint32_t), mapping.size) ||
+        !_section_in_range(header->meshlet_triangle_offset, header->meshlet_triangle_size, mapping.size))
+        return false;
+
+    const MeshCache::Lod *lods = (const MeshCache::Lod *) (mapping.data + header->lod_offset);
+    for (uint32_t i = 0; i < header->lod_count; i++) {
+        if ((uint64_t) lods[i].index_offset + lods[i].index_count > header->index_count)
+            return false;
+    }
+
+    return true;
+}
+
+MeshCache::~MeshCache()
+{
+    io_unmap_file(&mapping);
+}
+
+MeshCache *MeshCache::load(const char *filepath)
+{
+    std::string cache_path = std::string(filepath) + MESH_CACHE_EXTENSION;
+
+    uint64_t source_size = 0, source_mtime = 0, source_hash = 0;
+    bool has_source = io_file_stamp(filepath, &source_size, &source_mtime) == OK;
+
+    MeshCache *cache = memnew(MeshCache);
+
+    if (io_map_file(cache_path.c_str(), &cache->mapping) == OK) {
+        bool fresh = _validate(cache->mapping);
+
+        // shipped without the source model, trust the cache.
+        if (fresh && has_source) {
+            const Header *header = (const Header *) cache->mapping.data;
+            fresh = io_file_unchanged(filepath, header->source_size, header->source_mtime, header->source_hash);
+        }
+
+        if (fresh) {
+            cache->data = cache->mapping.data;
+            cache->header = (const Header *) cache->data;
+            return cache;
+        }
+
+        io_unmap_file(&cache->mapping);
+    }
+
+    ObjLoader *loader = NULL;
+    if (!has_source || io_hash_file(filepath, &source_hash) != OK || !(loader = ObjLoader::load(filepath))) {
+        fprintf(stderr, "-engine error: load mesh failed! can not open file: %s\n", filepath);
+        memdel(cache);
+        return NULL;
+    }
+
+    _serialize(loader, source_size, source_mtime, source_hash, &cache->blob);
+    ObjLoader::destroy(loader);
+
+    if (io_write_file(cache_path.c_str(), cache->blob.data(), cache->blob.size()) != OK)
+        fprintf(stderr, "-engine warning: can not write mesh cache: %s\n", cache_path.c_str());
+
+    cache->data = cache->blob.data();
+    cache->header = (const Header *) cache->data;
+
+    return cache;
+}
+
+void MeshCache::destroy(MeshCache *cache)
+{
+    memdel(cache);
+}
@@ -0,0 +1,131 @@
+/* ======================================================================== */
+/* mesh_cache.h                                                             */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include "obj.h"
+#include <bright/ioutils.h>
+
+#define MESH_CACHE_MAGIC 0x48534D42 /* BMSH */
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_EXTENSION ".bmesh"
+#define MESH_CACHE_ALIGNMENT 16
+#define MESH_CACHE_MAX_LODS 4
+#define MESH_CACHE_MESHLET_MAX_VERTICES 64
+#define MESH_CACHE_MESHLET_MAX_TRIANGLES 124
+
+/*
+ * binary mesh cache, written next to the source model (e.g. cube.obj.bmesh)
+ * after the first import and memory mapped on later loads. every section is
+ * 16 bytes aligned and can be copied straight into a gpu buffer.
+ *
+ *   Header | vertices | indices (all lods) | lods | meshlets
+ *          | meshlet vertices | meshlet triangles
+ */
+class MeshCache {
+public:
+    ~MeshCache();
+
+    struct Bounds {
+        float min[3];
+        float max[3];
+        float center[3];
+        float radius;
+    };
+
+    struct Lod {
+        uint32_t index_offset; /* in indices, not bytes */
+        uint32_t index_count;
+        float error; /* cluster cell size in model space */
+        uint32_t _reserved;
+    };
+
+    struct Meshlet {
+        uint32_t vertex_offset; /* into meshlet vertices */
+        uint32_t triangle_offset; /* into meshlet triangles, bytes */
+        uint32_t vertex_count;
+        uint32_t triangle_count;
+        float center[3];
+        float radius;
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t file_size;
+        /* source stamp */
+        uint64_t source_size;
+        uint64_t source_mtime;
+        uint64_t source_hash;
+        /* counts */
+        uint32_t vertex_stride;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        uint32_t lod_count;
+        uint32_t meshlet_count;
+        uint32_t meshlet_vertex_count;
+        uint32_t meshlet_triangle_size;
+        uint32_t _reserved;
+        Bounds bounds;
+        /* section offsets in bytes from the file start */
+        uint64_t vertex_offset;
+        uint64_t index_offset;
+        uint64_t lod_offset;
+        uint64_t meshlet_offset;
+        uint64_t meshlet_vertex_offset;
+        uint64_t meshlet_triangle_offset;
+    };
+
+    V_FORCEINLINE const Header *get_header() const { return header; }
+    V_FORCEINLINE const Bounds &get_bounds() const { return header->bounds; }
+
+    V_FORCEINLINE uint32_t get_vertex_count() const { return header->vertex_count; }
+    V_FORCEINLINE size_t get_vertex_buffer_size() const { return (size_t) header->vertex_count * header->vertex_stride; }
+    V_FORCEINLINE const ObjLoader::Vertex *get_vertices() const { return (const ObjLoader::Vertex *) (data + header->vertex_offset); }
+
+    V_FORCEINLINE uint32_t get_lod_count() const { return header->lod_count; }
+    V_FORCEINLINE const Lod *get_lods() const { return (const Lod *) (data + header->lod_offset); }
+    V_FORCEINLINE uint32_t get_index_count(uint32_t lod = 0) const { return get_lods()[lod].index_count; }
+    V_FORCEINLINE size_t get_index_buffer_size(uint32_t lod = 0) const { return get_index_count(lod) * sizeof(uint32_t); }
+    V_FORCEINLINE const uint32_t *get_indices(uint32_t lod = 0) const { return (const uint32_t *) (data + header->index_offset) + get_lods()[lod].index_offset; }
+
+    V_FORCEINLINE uint32_t get_meshlet_count() const { return header->meshlet_count; }
+    V_FORCEINLINE const Meshlet *get_meshlets() const { return (const Meshlet *) (data + header->meshlet_offset); }
+    V_FORCEINLINE const uint32_t *get_meshlet_vertices() const { return (const uint32_t *) (data + header->meshlet_vertex_offset); }
+    V_FORCEINLINE const uint8_t *get_meshlet_triangles() const { return (const uint8_t *) (data + header->meshlet_triangle_offset); }
+
+    // static
+    // returns NULL when the file can not be read.
+    static MeshCache *load(const char *filepath);
+    static void destroy(MeshCache *cache);
+
+private:
+    U_MEMNEW_ONLY MeshCache() { /* do nothing... */ }
+
+    IOMapping mapping = {};
+    std::vector<char> blob; /* used when the cache file can not be written */
+    const char *data = NULL;
+    const Header *header = NULL;
+};
+
+#endif /* _MESH_CACHE_H_ */
@@ -23,72 +23,465 @@
 #include "obj.h"
 #include <bright/memalloc.h>
 #include <bright/error.h>
-#include <tinyobjloader/tiny_obj_loader.h>
-#include <unordered_map>
-
-namespace std {
-  template <>
-  struct hash<ObjLoader::Vertex> {
-    size_t operator()(ObjLoader::Vertex const &vertex) const {
-      std::size_t h1 = std::hash<float>{}(vertex.position.x);
-      std::size_t h2 = std::hash<float>{}(vertex.position.y);
-      std::size_t h3 = std::hash<float>{}(vertex.position.z);
-      std::size_t h4 = std::hash<float>{}(vertex.texcoord.x);
-      std::size_t h5 = std::hash<float>{}(vertex.texcoord.y);
-      std::size_t h6 = std::hash<float>{}(vertex.normal.x);
-      std::size_t h7 = std::hash<float>{}(vertex.normal.y);
-      std::size_t h8 = std::hash<float>{}(vertex.normal.z);
-      // Combine hash values
-      return h1 ^ (h2 << 1) ^ (h3 << 2) ^ (h4 << 3) ^ (h5 << 4) ^ (h6 << 5) ^ (h7 << 6) ^ (h8 << 7);
-    }
-  };
+#include <bright/ioutils.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// do not split files smaller than this into parallel chunks.
+#define OBJ_MIN_CHUNK_SIZE (1 << 20)
+#define OBJ_MISSING_INDEX INT32_MIN
+
+struct _ObjCorner {
+    int32_t v, t, n;
+    uint8_t relative; /* bit0: v, bit1: t, bit2: n */
+};
+
+struct _ObjChunk {
+    const char *begin;
+    const char *end;
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+    std::vector<float> normals;
+    std::vector<_ObjCorner> corners;
+    size_t position_base = 0;
+    size_t texcoord_base = 0;
+    size_t normal_base = 0;
+};
+
+static const double _pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static V_FORCEINLINE bool _is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
 }
 
-ObjLoader *ObjLoader::load(const char *filepath)
+static V_FORCEINLINE void _skip_space(const char **p, const char *end)
 {
-    ObjLoader *loader = memnew(ObjLoader);
+    while (*p < end && _is_space(**p))
+        (*p)++;
+}
 
-    tinyobj::ObjReader reader;
+// check whether the 8 bytes are all ascii digits and convert them at once,
+// the bytes are processed as packed lanes of one 64-bit register (SWAR).
+static V_FORCEINLINE bool _is_eight_digits(uint64_t val)
+{
+    return (((val & 0xF0F0F0F0F0F0F0F0) | (((val + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333);
+}
 
-    if (!reader.ParseFromFile(filepath))
-        EXIT_FAIL("-engine error: parse .obj model failed!");
+static V_FORCEINLINE uint32_t _parse_eight_digits(uint64_t val)
+{
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 0x000F424000000064; // 100 + (1000000ULL << 32)
+    const uint64_t mul2 = 0x0000271000000001; // 1 + (10000ULL << 32)
+    val -= 0x3030303030303030;
+    val = (val * 10) + (val >> 8);
+    val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t) val;
+}
 
-    const tinyobj::attrib_t& attrib = reader.GetAttrib();
-    const std::vector<tinyobj::shape_t>& shapes = reader.GetShapes();
-    std::unordered_map<Vertex, uint32_t> unique_vertices = {};
+static V_FORCEINLINE const char *_parse_digits(const char *p, const char *end, uint64_t *p_mantissa, int *p_digits)
+{
+    uint64_t mantissa = *p_mantissa;
+    int digits = *p_digits;
 
-    for (const auto &shape : shapes) {
-        for (const auto &index : shape.mesh.indices) {
-            Vertex vertex = {};
-            if (index.vertex_index >= 0) {
-                vertex.position = {
-                  attrib.vertices[3 * index.vertex_index + 0],
-                  attrib.vertices[3 * index.vertex_index + 1],
-                  attrib.vertices[3 * index.vertex_index + 2],
-                };
+    while (end - p >= 8 && digits <= 11) {
+        uint64_t val;
+        memcpy(&val, p, sizeof(val));
+        if (!_is_eight_digits(val))
+            break;
+        mantissa = mantissa * 100000000 + _parse_eight_digits(val);
+        digits += 8;
+        p += 8;
+    }
+
+    while (p < end && (unsigned) (*p - '0') < 10) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits++;
+        } else {
+            // too many significant digits, the rest only scale the value.
+            digits++;
+        }
+        p++;
+    }
+
+    *p_mantissa = mantissa;
+    *p_digits = digits;
+    return p;
+}
+
+static const char *_parse_float(const char *p, const char *end, float *p_value)
+{
+    const char *start = p;
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+
+    const char *integer = p;
+    p = _parse_digits(p, end, &mantissa, &digits);
+    if (digits > 19)
+        exponent += digits - 19;
+    bool has_digits = p != integer;
+
+    if (p < end && *p == '.') {
+        p++;
+        const char *fraction = p;
+        int before = digits;
+        p = _parse_digits(p, end, &mantissa, &digits);
+        int taken = std::min(digits, 19) - std::min(before, 19);
+        exponent -= taken;
+        has_digits |= p != fraction;
+    }
+
+    if (!has_digits) {
+        // inf, nan and other rare spellings. the mapping is not nul terminated,
+        // strtof gets a bounded copy of the token.
+        char token[32];
+        size_t length = 0;
+        while (start + length < end && length < sizeof(token) - 1 && !_is_space(start[length]) && start[length] != '\n')
+            length++;
+        memcpy(token, start, length);
+        token[length] = '\0';
+
+        char *stop;
+        *p_value = strtof(token, &stop);
+        return start + (stop - token);
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *e = p++;
+        bool exp_negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exp_negative = *p == '-';
+            p++;
+        }
+        if (p < end && (unsigned) (*p - '0') < 10) {
+            int exp = 0;
+            while (p < end && (unsigned) (*p - '0') < 10) {
+                if (exp < 10000)
+                    exp = exp * 10 + (*p - '0');
+                p++;
             }
+            exponent += exp_negative ? -exp : exp;
+        } else {
+            p = e;
+        }
+    }
+
+    double value = (double) mantissa;
+    if (exponent < 0)
+        value = exponent >= -22 ? value / _pow10[-exponent] : value * std::pow(10.0, exponent);
+    else if (exponent > 0)
+        value = exponent <= 22 ? value * _pow10[exponent] : value * std::pow(10.0, exponent);
+
+    *p_value = (float) (negative ? -value : value);
+    return p;
+}
+
+static V_FORCEINLINE const char *_parse_int(const char *p, const char *end, int32_t *p_value)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    int32_t value = 0;
+    while (p < end && (unsigned) (*p - '0') < 10) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+
+    *p_value = negative ? -value : value;
+    return p;
+}
+
+static const char *_parse_floats(const char *p, const char *end, uint32_t count, std::vector<float> *p_values)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        float value = 0.0f;
+        _skip_space(&p, end);
+        if (p < end && *p != '\n')
+            p = _parse_float(p, end, &value);
+        p_values->push_back(value);
+    }
+    return p;
+}
+
+// resolve a single obj index, positive indices are absolute (1 based) and
+// negative indices are relative to the element count at the current line.
+static V_FORCEINLINE void _resolve_index(int32_t index, size_t local_count, uint8_t bit, int32_t *p_value, uint8_t *p_relative)
+{
+    if (index > 0) {
+        *p_value = index - 1;
+    } else if (index < 0) {
+        *p_value = (int32_t) local_count + index;
+        *p_relative |= bit;
+    } else {
+        *p_value = OBJ_MISSING_INDEX;
+    }
+}
+
+static const char *_parse_corner(const char *p, const char *end, _ObjChunk *chunk, _ObjCorner *p_corner)
+{
+    int32_t index;
+    _ObjCorner corner = { OBJ_MISSING_INDEX, OBJ_MISSING_INDEX, OBJ_MISSING_INDEX, 0 };
+
+    p = _parse_int(p, end, &index);
+    _resolve_index(index, chunk->positions.size() / 3, 0x1, &corner.v, &corner.relative);
+
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/') {
+            p = _parse_int(p, end, &index);
+            _resolve_index(index, chunk->texcoords.size() / 2, 0x2, &corner.t, &corner.relative);
+        }
+        if (p < end && *p == '/') {
+            p++;
+            p = _parse_int(p, end, &index);
+            _resolve_index(index, chunk->normals.size() / 3, 0x4, &corner.n, &corner.relative);
+        }
+    }
+
+    // skip anything we do not understand up to the next separator.
+    while (p < end && !_is_space(*p) && *p != '\n')
+        p++;
+
+    *p_corner = corner;
+    return p;
+}
+
+static void _parse_chunk(_ObjChunk *chunk)
+{
+    const char *p = chunk->begin;
+    const char *end = chunk->end;
+    std::vector<_ObjCorner> face;
+
+    while (p < end) {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
 
-            if (index.texcoord_index >= 0) {
-                vertex.texcoord = {
-                  attrib.texcoords[2 * index.texcoord_index + 0],
-                  attrib.texcoords[2 * index.texcoord_index + 1],
-                };
+        _skip_space(&p, eol);
+
+        if (eol - p >= 2 && p[0] == 'v') {
+            if (p[1] == ' ' || p[1] == '\t') {
+                _parse_floats(p + 2, eol, 3, &chunk->positions);
+            } else if (p[1] == 't' && eol - p >= 3 && _is_space(p[2])) {
+                _parse_floats(p + 3, eol, 2, &chunk->texcoords);
+            } else if (p[1] == 'n' && eol - p >= 3 && _is_space(p[2])) {
+                _parse_floats(p + 3, eol, 3, &chunk->normals);
+            }
+        } else if (eol - p >= 2 && p[0] == 'f' && _is_space(p[1])) {
+            face.clear();
+            p += 2;
+            while (p < eol) {
+                _skip_space(&p, eol);
+                if (p >= eol)
+                    break;
+                _ObjCorner corner;
+                p = _parse_corner(p, eol, chunk, &corner);
+                face.push_back(corner);
             }
 
-            if (index.normal_index >= 0) {
-                vertex.normal = {
-                  attrib.normals[3 * index.normal_index + 0],
-                  attrib.normals[3 * index.normal_index + 1],
-                  attrib.normals[3 * index.normal_index + 1],
-                };
+            // triangulate polygon as a fan.
+            for (size_t i = 2; i < face.size(); i++) {
+                chunk->corners.push_back(face[0]);
+                chunk->corners.push_back(face[i - 1]);
+                chunk->corners.push_back(face[i]);
             }
+        }
+
+        p = eol + 1;
+    }
+}
+
+static V_FORCEINLINE uint64_t _hash_vertex(const ObjLoader::Vertex &vertex)
+{
+    static_assert(sizeof(ObjLoader::Vertex) == 32, "vertex must be tightly packed");
+
+    uint64_t words[4];
+    memcpy(words, &vertex, sizeof(words));
+
+    uint64_t h = 0x9E3779B97F4A7C15;
+    for (uint64_t w : words) {
+        h ^= w;
+        h *= 0xBF58476D1CE4E5B9;
+        h ^= h >> 31;
+    }
+
+    return h;
+}
+
+// open addressing table keyed by the packed vertex bytes, slots keep the
+// upper hash bits next to the vertex index to avoid touching the vertex
+// array on most probe misses.
+class _VertexTable {
+public:
+    _VertexTable(size_t expected)
+      {
+        size_t capacity = 16;
+        while (capacity < expected * 2)
+            capacity <<= 1;
+        _resize(capacity);
+      }
+
+    uint32_t insert(const ObjLoader::Vertex &vertex, std::vector<ObjLoader::Vertex> *p_vertices)
+      {
+        // keep load factor under 0.5.
+        if ((p_vertices->size() + 1) * 2 > slots.size())
+            _rehash(*p_vertices);
 
-            if (unique_vertices.count(vertex) == 0) {
-                unique_vertices[vertex] = static_cast<uint32_t>(loader->vertices.size());
-                loader->vertices.push_back(vertex);
+        uint64_t h = _hash_vertex(vertex);
+        uint32_t tag = (uint32_t) (h >> 32);
+        size_t i = h & mask;
+
+        while (true) {
+            Slot &slot = slots[i];
+            if (slot.index == UINT32_MAX) {
+                slot.tag = tag;
+                slot.index = (uint32_t) p_vertices->size();
+                p_vertices->push_back(vertex);
+                return slot.index;
             }
+            if (slot.tag == tag && memcmp(&(*p_vertices)[slot.index], &vertex, sizeof(vertex)) == 0)
+                return slot.index;
+            i = (i + 1) & mask;
+        }
+      }
+
+private:
+    struct Slot {
+        uint32_t tag;
+        uint32_t index;
+    };
+
+    void _resize(size_t capacity)
+      {
+        mask = capacity - 1;
+        slots.assign(capacity, { 0, UINT32_MAX });
+      }
 
-            loader->indices.push_back(unique_vertices[vertex]);
+    void _rehash(const std::vector<ObjLoader::Vertex> &vertices)
+      {
+        _resize(slots.size() * 2);
+        for (uint32_t index = 0; index < (uint32_t) vertices.size(); index++) {
+            uint64_t h = _hash_vertex(vertices[index]);
+            size_t i = h & mask;
+            while (slots[i].index != UINT32_MAX)
+                i = (i + 1) & mask;
+            slots[i] = { (uint32_t) (h >> 32), index };
+        }
+      }
+
+    std::vector<Slot> slots;
+    size_t mask;
+};
+
+static V_FORCEINLINE const float *_fetch(const std::vector<_ObjChunk> &chunks, int32_t index, uint32_t components, size_t total, const std::vector<float> _ObjChunk::*member, const size_t _ObjChunk::*base)
+{
+    if (index < 0 || (size_t) index >= total)
+        return NULL;
+
+    // chunks are ordered, find the one that owns the global index.
+    auto it = std::upper_bound(chunks.begin(), chunks.end(), (size_t) index, [base](size_t value, const _ObjChunk &chunk) {
+        return value < chunk.*base;
+    });
+
+    const _ObjChunk &chunk = *(it - 1);
+    return (chunk.*member).data() + (index - chunk.*base) * components;
+}
+
+ObjLoader *ObjLoader::load(const char *filepath)
+{
+    IOMapping file;
+    if (io_map_file(filepath, &file) != OK) {
+        fprintf(stderr, "-engine error: parse .obj model failed! can not open file: %s\n", filepath);
+        return NULL;
+    }
+
+    ObjLoader *loader = memnew(ObjLoader);
+
+    // split file into line aligned chunks.
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunk_count = std::clamp(file.size / OBJ_MIN_CHUNK_SIZE, (size_t) 1, thread_count);
+
+    std::vector<_ObjChunk> chunks(chunk_count);
+    const char *begin = file.data;
+    const char *end = file.data + file.size;
+    for (size_t i = 0; i < chunk_count; i++) {
+        const char *chunk_end = i + 1 == chunk_count ? end : file.data + (file.size / chunk_count) * (i + 1);
+        if (chunk_end < begin)
+            chunk_end = begin;
+        const char *eol = chunk_end < end ? (const char *) memchr(chunk_end, '\n', end - chunk_end) : NULL;
+        chunk_end = eol ? eol + 1 : end;
+
+        chunks[i].begin = begin;
+        chunks[i].end = chunk_end;
+        begin = chunk_end;
+    }
+
+    if (chunk_count == 1) {
+        _parse_chunk(&chunks[0]);
+    } else {
+        std::vector<std::thread> threads;
+        for (auto &chunk : chunks)
+            threads.emplace_back(_parse_chunk, &chunk);
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    io_unmap_file(&file);
+
+    // prefix sum of element counts, so relative indices can be made global.
+    size_t position_count = 0, texcoord_count = 0, normal_count = 0, corner_count = 0;
+    for (auto &chunk : chunks) {
+        chunk.position_base = position_count;
+        chunk.texcoord_base = texcoord_count;
+        chunk.normal_base = normal_count;
+        position_count += chunk.positions.size() / 3;
+        texcoord_count += chunk.texcoords.size() / 2;
+        normal_count += chunk.normals.size() / 3;
+        corner_count += chunk.corners.size();
+    }
+
+    size_t expected_vertex_count = std::min(corner_count, position_count + 16);
+    loader->vertices.reserve(expected_vertex_count);
+    loader->indices.reserve(corner_count);
+
+    _VertexTable table(expected_vertex_count);
+
+    for (const auto &chunk : chunks) {
+        for (const auto &corner : chunk.corners) {
+            int32_t v = corner.v, t = corner.t, n = corner.n;
+            if (v != OBJ_MISSING_INDEX && (corner.relative & 0x1)) v += (int32_t) chunk.position_base;
+            if (t != OBJ_MISSING_INDEX && (corner.relative & 0x2)) t += (int32_t) chunk.texcoord_base;
+            if (n != OBJ_MISSING_INDEX && (corner.relative & 0x4)) n += (int32_t) chunk.normal_base;
+
+            Vertex vertex = {};
+            const float *src;
+
+            if ((src = _fetch(chunks, v, 3, position_count, &_ObjChunk::positions, &_ObjChunk::position_base)))
+                vertex.position = { src[0], src[1], src[2] };
+
+            if ((src = _fetch(chunks, t, 2, texcoord_count, &_ObjChunk::texcoords, &_ObjChunk::texcoord_base)))
+                vertex.texcoord = { src[0], src[1] };
+
+            if ((src = _fetch(chunks, n, 3, normal_count, &_ObjChunk::normals, &_ObjChunk::normal_base)))
+                vertex.normal = { src[0], src[1], src[2] };
+
+            loader->indices.push_back(table.insert(vertex, &loader->vertices));
         }
     }
 
@@ -98,4 +491,4 @@ ObjLoader *ObjLoader::load(const char *filepath)
 void ObjLoader::destroy(ObjLoader *loader)
 {
     memdel(loader);
-}
\ No newline at end of file
+}
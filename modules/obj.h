@@ -38,8 +38,7 @@ public:
 
         // eq
         bool operator==(const Vertex &other) const {
-          return position == other.position && normal == other.normal && normal == other.normal &&
-                 texcoord == other.texcoord;
+          return position == other.position && texcoord == other.texcoord && normal == other.normal;
         }
     };
 
@@ -47,6 +46,7 @@ public:
     const std::vector<uint32_t> &get_indices() const { return indices; }
 
     // static
+    // returns NULL when the file can not be read.
     static ObjLoader *load(const char *filepath);
     static void destroy(ObjLoader *loader);
 
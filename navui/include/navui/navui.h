@@ -36,10 +36,10 @@ namespace NavUI {
         uint32_t                        QueueFamily;
         VkQueue                         Queue;
         VkDescriptorPool                DescriptorPool;
-        VkRenderPass                    RenderPass;
         uint32_t                        MinImageCount;
         uint32_t                        ImageCount;
         VkSampleCountFlagBits           MSAASamples;
+        VkFormat                        ColorAttachmentFormat;  // Rendered dynamically, no render pass
     };
 
     // create and destroy
@@ -26,6 +26,7 @@
 #include <bright/typedefs.h>
 
 static GLFWwindow *_window = NULL;
+static VkFormat _color_attachment_format = VK_FORMAT_UNDEFINED;
 
 void _DarkNavUITheme()
   {
@@ -182,11 +183,16 @@ namespace NavUI {
         init_info.Queue = p_initialize_info->Queue;
         init_info.PipelineCache = VK_NULL_HANDLE;
         init_info.DescriptorPool = p_initialize_info->DescriptorPool;
-        init_info.RenderPass = p_initialize_info->RenderPass;
-        init_info.Subpass = 0;
         init_info.MinImageCount = p_initialize_info->MinImageCount;
         init_info.ImageCount = p_initialize_info->ImageCount;
         init_info.MSAASamples = p_initialize_info->MSAASamples;
+
+        // the backend keeps a copy of the create info, the format has to outlive it.
+        _color_attachment_format = p_initialize_info->ColorAttachmentFormat;
+        init_info.UseDynamicRendering = true;
+        init_info.PipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        init_info.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
+        init_info.PipelineRenderingCreateInfo.pColorAttachmentFormats = &_color_attachment_format;
         ImGui_ImplVulkan_Init(&init_info);
 
         _window = p_initialize_info->window;
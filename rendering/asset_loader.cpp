@@ -0,0 +1,466 @@
+/* ======================================================================== */
+/* asset_loader.cpp                                                         */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "asset_loader.h"
+#include "utils/thread_pool.h"
+#include <stb/stb_image.h>
+
+struct AssetLoader::_TextureEntry {
+    RenderDevice::Texture2D *texture;
+    bool hdr;
+    bool resident;
+    std::vector<TextureCallback> callbacks;
+};
+
+struct AssetLoader::_MeshEntry {
+    Mesh mesh;
+    bool resident;
+    std::vector<MeshCallback> callbacks;
+};
+
+struct AssetLoader::_TextureJob {
+    TextureHandle handle;
+    std::string path;
+    bool hdr;
+    bool ktx2;
+    RenderDevice::Texture2D *texture;
+    RenderDevice::Buffer *staging_buffer;
+    uint32_t level_count;
+    VkDeviceSize level_offsets[TEXTURE_MAX_MIP_LEVELS];
+};
+
+struct AssetLoader::_MeshJob {
+    MeshHandle handle;
+    std::string path;
+    Mesh mesh;
+    RenderDevice::Buffer *vertex_staging_buffer;
+    RenderDevice::Buffer *index_staging_buffer;
+};
+
+RenderDevice *AssetLoader::rd = NULL;
+ThreadPool *AssetLoader::pool = NULL;
+RenderDevice::Texture2D *AssetLoader::placeholder_ldr = NULL;
+RenderDevice::Texture2D *AssetLoader::placeholder_hdr = NULL;
+VkSampler AssetLoader::placeholder_sampler = VK_NULL_HANDLE;
+HdrFormat AssetLoader::hdr_format = HDR_FORMAT_RGBA16F;
+bool AssetLoader::hdr_cpu_mipmaps = false;
+std::vector<AssetLoader::_TextureEntry *> AssetLoader::textures;
+std::vector<AssetLoader::_MeshEntry *> AssetLoader::meshes;
+std::unordered_map<std::string, uint32_t> AssetLoader::texture_paths;
+std::unordered_map<std::string, uint32_t> AssetLoader::mesh_paths;
+std::mutex AssetLoader::completed_mutex;
+std::vector<AssetLoader::_TextureJob *> AssetLoader::completed_textures;
+std::vector<AssetLoader::_MeshJob *> AssetLoader::completed_meshes;
+
+#define _CHECK_ASSET_LOADER_INIT() do {                                                                             \
+    EXIT_FAIL_COND_V(rd, "-engine error: the asset loader is not initialized! call AssetLoader::initialize(rd)");   \
+} while(0)
+
+static bool _is_path_extension(const char *path, const char *extension)
+{
+    size_t length = strlen(path);
+    size_t extension_length = strlen(extension);
+    return length >= extension_length && strcmp(path + length - extension_length, extension) == 0;
+}
+
+static RenderDevice::Texture2D *_create_texture(RenderDevice *rd, uint32_t width, uint32_t height, VkFormat format, uint32_t mip_levels, uint32_t array_layers = 1)
+{
+    RenderDevice::TextureCreateInfo texture_create_info = {
+        /* width= */ width,
+        /* height= */ height,
+        /* samples= */ VK_SAMPLE_COUNT_1_BIT,
+        /* format= */ format,
+        /* aspect_mask= */ VK_IMAGE_ASPECT_COLOR_BIT,
+        /* image_type= */ VK_IMAGE_TYPE_2D,
+        /* image_view_type= */ array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D,
+        /* usage= */ VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        /* mip_levels= */ mip_levels,
+        /* array_layers= */ array_layers,
+    };
+
+    return rd->create_texture(&texture_create_info);
+}
+
+static RenderDevice::Buffer *_create_staging_buffer(RenderDevice *rd, size_t size, void *pixels)
+{
+    RenderDevice::Buffer *staging_buffer = rd->create_buffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
+    rd->write_buffer(staging_buffer, 0, size, pixels);
+    return staging_buffer;
+}
+
+// block compressed levels go to the gpu as stored, the staging buffer holds the
+// level range of the file and the offsets are rebased to it.
+static bool _load_ktx2_texture(RenderDevice *rd, const char *path, RenderDevice::Texture2D **p_texture, RenderDevice::Buffer **p_staging_buffer,
+                               uint32_t *p_level_count, VkDeviceSize *p_level_offsets)
+{
+    Ktx2Image *image = Ktx2Image::load(path);
+    if (!image)
+        return false;
+
+    VkFormat format = image->get_format();
+    Ktx2FormatInfo info;
+    ktx2_get_format_info(format, &info);
+
+    if ((info.compressed && !rd->get_device_context()->get_enabled_features().textureCompressionBC) || !rd->is_format_sampled_filterable(format)) {
+        fprintf(stderr, "-engine warning: ktx2 format %d is not supported by the device: %s\n", format, path);
+        Ktx2Image::destroy(image);
+        return false;
+    }
+
+    // a level count of zero asks for generated mips, only possible when the format can be blit.
+    uint32_t level_count = std::min(std::max(image->get_mip_levels(), 1u), (uint32_t) TEXTURE_MAX_MIP_LEVELS);
+    uint32_t mip_levels = level_count;
+    if (image->get_mip_levels() == 0 && !info.compressed && rd->is_format_blit_filterable(format))
+        mip_levels = RenderDevice::get_mip_level_count(image->get_width(), image->get_height());
+
+    uint64_t begin = UINT64_MAX, end = 0;
+    for (uint32_t i = 0; i < level_count; i++) {
+        const Ktx2Image::Level *level = image->get_level(i);
+        begin = std::min(begin, level->byte_offset);
+        end = std::max(end, level->byte_offset + level->byte_length);
+    }
+
+    for (uint32_t i = 0; i < level_count; i++)
+        p_level_offsets[i] = image->get_level(i)->byte_offset - begin;
+
+    *p_texture = _create_texture(rd, image->get_width(), image->get_height(), format, mip_levels, image->get_layers());
+    *p_staging_buffer = _create_staging_buffer(rd, end - begin, (void *) (image->get_data() + begin));
+    *p_level_count = level_count;
+
+    Ktx2Image::destroy(image);
+    return true;
+}
+
+void AssetLoader::initialize(RenderDevice *v_rd)
+{
+    rd = v_rd;
+    pool = memnew(ThreadPool, ThreadPool::default_thread_count());
+
+    // shared exponent is a quarter of rgba32f, fall back to half floats when it can not be filtered.
+    hdr_format = rd->is_format_sampled_filterable(VK_FORMAT_E5B9G9R9_UFLOAT_PACK32) ? HDR_FORMAT_RGB9E5 : HDR_FORMAT_RGBA16F;
+    // shared exponent formats usually can not be blit, their mips are built on import.
+    hdr_cpu_mipmaps = !rd->is_format_blit_filterable(hdr_format == HDR_FORMAT_RGB9E5 ? VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 : VK_FORMAT_R16G16B16A16_SFLOAT);
+
+    RenderDevice::SamplerCreateInfo sampler_create_info = {};
+    rd->create_sampler(&sampler_create_info, &placeholder_sampler);
+
+    // 1x1 placeholders, shown while the real texture is still loading.
+    uint8_t ldr_pixel[4] = { 255, 255, 255, 255 };
+    placeholder_ldr = _create_texture(rd, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, 1);
+    rd->bind_texture_sampler(placeholder_ldr, placeholder_sampler);
+    rd->enqueue_texture_upload(placeholder_ldr, _create_staging_buffer(rd, sizeof(ldr_pixel), ldr_pixel));
+
+    float hdr_pixel[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+    placeholder_hdr = _create_texture(rd, 1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 1);
+    rd->bind_texture_sampler(placeholder_hdr, placeholder_sampler);
+    rd->enqueue_texture_upload(placeholder_hdr, _create_staging_buffer(rd, sizeof(hdr_pixel), hdr_pixel));
+
+    rd->flush_upload_queue();
+}
+
+void AssetLoader::destroy()
+{
+    _CHECK_ASSET_LOADER_INIT();
+
+    // joins the workers after every queued job has finished.
+    memdel(pool);
+
+    for (_TextureJob *job: completed_textures) {
+        if (job->texture) {
+            rd->destroy_buffer(job->staging_buffer);
+            rd->destroy_texture(job->texture);
+        }
+        memdel(job);
+    }
+
+    for (_MeshJob *job: completed_meshes) {
+        if (job->mesh.vertex_buffer) {
+            rd->destroy_buffer(job->vertex_staging_buffer);
+            rd->destroy_buffer(job->index_staging_buffer);
+            rd->destroy_buffer(job->mesh.vertex_buffer);
+            rd->destroy_buffer(job->mesh.index_buffer);
+        }
+        memdel(job);
+    }
+
+    completed_textures.clear();
+    completed_meshes.clear();
+
+    for (_TextureEntry *entry: textures) {
+        if (entry->resident)
+            rd->destroy_texture(entry->texture);
+        memdel(entry);
+    }
+
+    for (_MeshEntry *entry: meshes) {
+        if (entry->resident) {
+            rd->destroy_buffer(entry->mesh.vertex_buffer);
+            rd->destroy_buffer(entry->mesh.index_buffer);
+        }
+        memdel(entry);
+    }
+
+    textures.clear();
+    meshes.clear();
+    texture_paths.clear();
+    mesh_paths.clear();
+
+    rd->destroy_texture(placeholder_ldr);
+    rd->destroy_texture(placeholder_hdr);
+    rd->destroy_sampler(placeholder_sampler);
+    rd = NULL;
+}
+
+AssetLoader::TextureHandle AssetLoader::load_texture(const char *path, TextureCallback callback)
+{
+    _CHECK_ASSET_LOADER_INIT();
+
+    auto finded = texture_paths.find(path);
+    if (finded != texture_paths.end()) {
+        _TextureEntry *entry = textures[finded->second];
+        if (callback) {
+            if (entry->resident)
+                callback(entry->texture);
+            else
+                entry->callbacks.push_back(callback);
+        }
+        return finded->second;
+    }
+
+    TextureHandle handle = (TextureHandle) textures.size();
+
+    _TextureEntry *entry = memnew(_TextureEntry);
+    entry->hdr = _is_path_extension(path, ".hdr");
+    entry->texture = entry->hdr ? placeholder_hdr : placeholder_ldr;
+    entry->resident = false;
+    if (callback)
+        entry->callbacks.push_back(callback);
+
+    textures.push_back(entry);
+    texture_paths[path] = handle;
+
+    _TextureJob *job = memnew(_TextureJob);
+    job->handle = handle;
+    job->path = path;
+    job->hdr = entry->hdr;
+    job->ktx2 = _is_path_extension(path, KTX2_EXTENSION);
+
+    pool->push([job] {
+        job->texture = NULL;
+        job->staging_buffer = NULL;
+        job->level_count = 1;
+        job->level_offsets[0] = 0;
+
+        // full mip chains, levels missing from the staging buffer are blit on upload.
+        if (job->ktx2) {
+            _load_ktx2_texture(rd, job->path.c_str(), &job->texture, &job->staging_buffer, &job->level_count, job->level_offsets);
+        } else if (job->hdr) {
+            // packed texels come from the disk cache after the first load.
+            HdrImage *image = HdrImage::load(job->path.c_str(), hdr_format, hdr_cpu_mipmaps);
+            if (image) {
+                VkFormat format = image->get_format() == HDR_FORMAT_RGB9E5 ? VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 : VK_FORMAT_R16G16B16A16_SFLOAT;
+                uint32_t mip_levels = RenderDevice::get_mip_level_count(image->get_width(), image->get_height());
+                job->texture = _create_texture(rd, image->get_width(), image->get_height(), format, mip_levels);
+                job->staging_buffer = _create_staging_buffer(rd, image->get_size(), (void *) image->get_pixels());
+                job->level_count = std::min(image->get_mip_levels(), (uint32_t) TEXTURE_MAX_MIP_LEVELS);
+                for (uint32_t i = 0; i < job->level_count; i++)
+                    job->level_offsets[i] = image->get_level_offset(i);
+                HdrImage::destroy(image);
+            }
+        } else {
+            int width = 0, height = 0, channels;
+            stbi_uc *pixels = stbi_load(job->path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            if (pixels) {
+                uint32_t mip_levels = RenderDevice::get_mip_level_count(width, height);
+                job->texture = _create_texture(rd, (uint32_t) width, (uint32_t) height, VK_FORMAT_R8G8B8A8_UNORM, mip_levels);
+                job->staging_buffer = _create_staging_buffer(rd, (size_t) width * height * 4, pixels);
+                stbi_image_free(pixels);
+            }
+        }
+
+        if (!job->texture)
+            fprintf(stderr, "-engine warning: load texture failed, keep placeholder: %s\n", job->path.c_str());
+
+        std::unique_lock<std::mutex> lock(completed_mutex);
+        completed_textures.push_back(job);
+    });
+
+    return handle;
+}
+
+AssetLoader::MeshHandle AssetLoader::load_mesh(const char *path, MeshCallback callback)
+{
+    _CHECK_ASSET_LOADER_INIT();
+
+    auto finded = mesh_paths.find(path);
+    if (finded != mesh_paths.end()) {
+        _MeshEntry *entry = meshes[finded->second];
+        if (callback) {
+            if (entry->resident)
+                callback(&entry->mesh);
+            else
+                entry->callbacks.push_back(callback);
+        }
+        return finded->second;
+    }
+
+    MeshHandle handle = (MeshHandle) meshes.size();
+
+    _MeshEntry *entry = memnew(_MeshEntry);
+    entry->mesh = {};
+    entry->resident = false;
+    if (callback)
+        entry->callbacks.push_back(callback);
+
+    meshes.push_back(entry);
+    mesh_paths[path] = handle;
+
+    _MeshJob *job = memnew(_MeshJob);
+    job->handle = handle;
+    job->path = path;
+
+    // the worker fills staging buffers only, the device local buffers are written
+    // by the upload queue in update().
+    pool->push([job] {
+        job->mesh = {};
+        job->vertex_staging_buffer = NULL;
+        job->index_staging_buffer = NULL;
+
+        MeshCache *cache = MeshCache::load(job->path.c_str());
+        if (!cache) {
+            fprintf(stderr, "-engine warning: load mesh failed, keep it not resident: %s\n", job->path.c_str());
+            std::unique_lock<std::mutex> lock(completed_mutex);
+            completed_meshes.push_back(job);
+            return;
+        }
+
+        size_t vertex_buffer_size = cache->get_vertex_buffer_size();
+        size_t index_buffer_size = cache->get_index_buffer_size();
+
+        // a mesh without faces is valid input, but there is nothing to upload.
+        if (cache->get_index_count() == 0 || vertex_buffer_size == 0) {
+            fprintf(stderr, "-engine warning: mesh is empty, keep it not resident: %s\n", job->path.c_str());
+            MeshCache::destroy(cache);
+            std::unique_lock<std::mutex> lock(completed_mutex);
+            completed_meshes.push_back(job);
+            return;
+        }
+
+        job->vertex_staging_buffer = _create_staging_buffer(rd, vertex_buffer_size, (void *) cache->get_vertices());
+        job->index_staging_buffer = _create_staging_buffer(rd, index_buffer_size, (void *) cache->get_indices());
+        job->mesh.vertex_buffer = rd->create_device_buffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertex_buffer_size);
+        job->mesh.index_buffer = rd->create_device_buffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, index_buffer_size);
+        job->mesh.index_count = cache->get_index_count();
+        job->mesh.bounds = cache->get_bounds();
+
+        MeshCache::destroy(cache);
+
+        std::unique_lock<std::mutex> lock(completed_mutex);
+        completed_meshes.push_back(job);
+    });
+
+    return handle;
+}
+
+RenderDevice::Texture2D *AssetLoader::get_texture(TextureHandle handle)
+{
+    _CHECK_ASSET_LOADER_INIT();
+    return textures[handle]->texture;
+}
+
+bool AssetLoader::is_texture_resident(TextureHandle handle)
+{
+    _CHECK_ASSET_LOADER_INIT();
+    return textures[handle]->resident;
+}
+
+const AssetLoader::Mesh *AssetLoader::get_mesh(MeshHandle handle)
+{
+    _CHECK_ASSET_LOADER_INIT();
+    _MeshEntry *entry = meshes[handle];
+    return entry->resident ? &entry->mesh : NULL;
+}
+
+void AssetLoader::update()
+{
+    _CHECK_ASSET_LOADER_INIT();
+
+    std::vector<_TextureJob *> texture_jobs;
+    std::vector<_MeshJob *> mesh_jobs;
+
+    {
+        std::unique_lock<std::mutex> lock(completed_mutex);
+
+        // keep the per frame copy bounded, always take at least one job.
+        size_t budget = 0;
+        size_t taken = 0;
+        for (_TextureJob *job: completed_textures) {
+            size_t size = job->staging_buffer ? job->staging_buffer->size : 0;
+            if (taken > 0 && budget + size > ASSET_UPLOAD_BUDGET_PER_FRAME)
+                break;
+            budget += size;
+            texture_jobs.push_back(job);
+            taken++;
+        }
+
+        completed_textures.erase(completed_textures.begin(), completed_textures.begin() + taken);
+        mesh_jobs.swap(completed_meshes);
+    }
+
+    for (_TextureJob *job: texture_jobs) {
+        if (job->texture)
+            rd->enqueue_texture_upload(job->texture, job->staging_buffer, job->level_count, job->level_offsets);
+    }
+
+    for (_MeshJob *job: mesh_jobs) {
+        if (job->mesh.vertex_buffer) {
+            rd->enqueue_buffer_upload(job->mesh.vertex_buffer, job->vertex_staging_buffer);
+            rd->enqueue_buffer_upload(job->mesh.index_buffer, job->index_staging_buffer);
+        }
+    }
+
+    rd->flush_upload_queue();
+
+    for (_TextureJob *job: texture_jobs) {
+        _TextureEntry *entry = textures[job->handle];
+        if (job->texture) {
+            entry->texture = job->texture;
+            entry->resident = true;
+            for (const auto &callback: entry->callbacks)
+                callback(entry->texture);
+        }
+        entry->callbacks.clear();
+        memdel(job);
+    }
+
+    for (_MeshJob *job: mesh_jobs) {
+        _MeshEntry *entry = meshes[job->handle];
+        if (job->mesh.vertex_buffer) {
+            entry->mesh = job->mesh;
+            entry->resident = true;
+            for (const auto &callback: entry->callbacks)
+                callback(&entry->mesh);
+        }
+        entry->callbacks.clear();
+        memdel(job);
+    }
+}
@@ -0,0 +1,100 @@
+/* ======================================================================== */
+/* asset_loader.h                                                           */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _ASSET_LOADER_H_
+#define _ASSET_LOADER_H_
+
+#include "drivers/render_device.h"
+#include "modules/mesh_cache.h"
+#include "modules/hdr.h"
+#include "modules/ktx2.h"
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// upload at most this many staging bytes per frame, the rest waits for the next update.
+#define ASSET_UPLOAD_BUDGET_PER_FRAME (64 << 20)
+
+/*
+ * background asset loading. file read and decode run on a worker pool, loads
+ * return a handle right away and the asset becomes resident in a later update().
+ * until then get_texture() returns a placeholder and get_mesh() returns NULL.
+ * an asset that fails to load stays that way.
+ * assets are shared by path and owned by the loader.
+ */
+class AssetLoader {
+public:
+    typedef uint32_t TextureHandle;
+    typedef uint32_t MeshHandle;
+
+    struct Mesh {
+        RenderDevice::Buffer *vertex_buffer;
+        RenderDevice::Buffer *index_buffer;
+        uint32_t index_count;
+        MeshCache::Bounds bounds;
+    };
+
+    // called on the main thread once the asset is resident.
+    typedef std::function<void(RenderDevice::Texture2D *)> TextureCallback;
+    typedef std::function<void(const Mesh *)> MeshCallback;
+
+    // initialize and destroy
+    static void initialize(RenderDevice *v_rd);
+    static void destroy();
+
+    // api
+    static TextureHandle load_texture(const char *path, TextureCallback callback = NULL);
+    static MeshHandle load_mesh(const char *path, MeshCallback callback = NULL);
+    static RenderDevice::Texture2D *get_texture(TextureHandle handle);
+    static bool is_texture_resident(TextureHandle handle);
+    static const Mesh *get_mesh(MeshHandle handle);
+
+    // call once per frame on the main thread before recording.
+    static void update();
+
+private:
+    struct _TextureEntry;
+    struct _MeshEntry;
+    struct _TextureJob;
+    struct _MeshJob;
+
+    static RenderDevice *rd;
+    static class ThreadPool *pool;
+    static RenderDevice::Texture2D *placeholder_ldr;
+    static RenderDevice::Texture2D *placeholder_hdr;
+    static VkSampler placeholder_sampler;
+    static HdrFormat hdr_format;
+    static bool hdr_cpu_mipmaps;
+
+    static std::vector<_TextureEntry *> textures;
+    static std::vector<_MeshEntry *> meshes;
+    static std::unordered_map<std::string, uint32_t> texture_paths;
+    static std::unordered_map<std::string, uint32_t> mesh_paths;
+
+    // finished by the workers, picked up by update() on the main thread.
+    static std::mutex completed_mutex;
+    static std::vector<_TextureJob *> completed_textures;
+    static std::vector<_MeshJob *> completed_meshes;
+};
+
+#endif /* _ASSET_LOADER_H_ */
@@ -0,0 +1,421 @@
+/* ======================================================================== */
+/* render_graph.cpp                                                         */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "render_graph.h"
+#include "drivers/barrier_builder.h"
+#include <algorithm>
+#include <string.h>
+
+void RenderGraph::PassBuilder::read(ResourceID id, Access access)
+{
+    graph->passes[pass].reads.push_back({ id, access });
+}
+
+void RenderGraph::PassBuilder::write(ResourceID id, Access access)
+{
+    graph->passes[pass].writes.push_back({ id, access });
+}
+
+void RenderGraph::PassBuilder::side_effect()
+{
+    graph->passes[pass].side_effect = true;
+}
+
+RenderGraph::RenderGraph(RenderDevice *v_rd)
+    : rd(v_rd)
+{
+    /* do nothing... */
+}
+
+RenderGraph::~RenderGraph()
+{
+    _release_transient_textures();
+}
+
+const RenderGraph::_AccessInfo &RenderGraph::_get_access_info(Access access)
+{
+    static const _AccessInfo access_infos[ACCESS_MAX] = {
+        /* ACCESS_NONE */
+        { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, false },
+        /* ACCESS_COLOR_ATTACHMENT_WRITE */
+        { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true },
+        /* ACCESS_DEPTH_ATTACHMENT_WRITE */
+        { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true },
+        /* ACCESS_DEPTH_ATTACHMENT_READ */
+        { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false },
+        /* ACCESS_FRAGMENT_SHADER_READ */
+        { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT, false },
+        /* ACCESS_COMPUTE_SHADER_READ */
+        { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, RENDER_DEVICE_SAMPLED_IMAGE_LAYOUT, false },
+        /* ACCESS_COMPUTE_STORAGE_READ */
+        { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false },
+        /* ACCESS_COMPUTE_STORAGE_WRITE */
+        { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true },
+        /* ACCESS_TRANSFER_READ */
+        { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false },
+        /* ACCESS_TRANSFER_WRITE */
+        { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true },
+        /* ACCESS_VERTEX_BUFFER_READ */
+        { VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+        /* ACCESS_INDEX_BUFFER_READ */
+        { VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+        /* ACCESS_INDIRECT_BUFFER_READ */
+        { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+        /* ACCESS_UNIFORM_BUFFER_READ */
+        { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+    };
+
+    return access_infos[access];
+}
+
+RenderGraph::ResourceID RenderGraph::_add_resource(const char *name)
+{
+    _Resource resource;
+    resource.name = name;
+    resources.push_back(resource);
+    return (ResourceID) resources.size() - 1;
+}
+
+RenderGraph::ResourceID RenderGraph::import_texture(const char *name, RenderDevice::Texture2D *texture, Access v_final_access)
+{
+    ResourceID id = _add_resource(name);
+    _Resource *resource = &resources[id];
+    resource->texture = texture;
+    resource->imported = true;
+    resource->final_access = v_final_access;
+
+    // the texture was left in its final access by the previous frame.
+    const _AccessInfo &info = _get_access_info(v_final_access);
+    resource->state.stage_mask = info.stage_mask;
+    resource->state.access_mask = info.access_mask;
+    resource->state.layout = texture->image_layout;
+    resource->state.written = info.write;
+
+    return id;
+}
+
+RenderGraph::ResourceID RenderGraph::import_buffer(const char *name, RenderDevice::Buffer *buffer, Access v_final_access)
+{
+    ResourceID id = _add_resource(name);
+    _Resource *resource = &resources[id];
+    resource->buffer = buffer;
+    resource->imported = true;
+    resource->final_access = v_final_access;
+
+    const _AccessInfo &info = _get_access_info(v_final_access);
+    resource->state.stage_mask = info.stage_mask;
+    resource->state.access_mask = info.access_mask;
+    resource->state.written = info.write;
+
+    return id;
+}
+
+RenderGraph::ResourceID RenderGraph::create_texture(const char *name, RenderDevice::TextureCreateInfo *p_create_info)
+{
+    ResourceID id = _add_resource(name);
+    resources[id].create_info = *p_create_info;
+    return id;
+}
+
+void RenderGraph::add_pass(const char *name, PassSetup v_setup, PassExecute v_execute)
+{
+    _Pass pass;
+    pass.name = name;
+    pass.execute = std::move(v_execute);
+    passes.push_back(std::move(pass));
+
+    PassBuilder builder(this, (uint32_t) passes.size() - 1);
+    v_setup(builder);
+}
+
+RenderDevice::Texture2D *RenderGraph::get_texture(ResourceID id)
+{
+    return resources[id].texture;
+}
+
+RenderDevice::Buffer *RenderGraph::get_buffer(ResourceID id)
+{
+    return resources[id].buffer;
+}
+
+void RenderGraph::compile()
+{
+    _cull_passes();
+    _compute_lifetimes();
+    _allocate_transient_textures();
+    compiled = true;
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd_buffer)
+{
+    EXIT_FAIL_COND_V(compiled, "-engine error: render graph executed without compile!\n");
+
+    BarrierBuilder barriers;
+
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        _Pass *pass = &passes[i];
+        if (pass->culled)
+            continue;
+
+        // aliased memory is handed over at the first use of a transient, whichever
+        // texture used the block before may have run earlier in this very frame.
+        auto acquire = [&](const _Usage &usage) {
+            _Resource *resource = &resources[usage.resource];
+            if (resource->memory_block >= 0 && resource->first_pass == i) {
+                resource->state = memory_blocks[resource->memory_block].state;
+                resource->state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+        };
+
+        std::for_each(pass->writes.begin(), pass->writes.end(), acquire);
+        std::for_each(pass->reads.begin(), pass->reads.end(), acquire);
+
+        // the write access of a resource also covers reading it in the same pass.
+        for (const auto &usage: pass->writes)
+            _transition(&resources[usage.resource], usage.access, &barriers);
+
+        for (const auto &usage: pass->reads) {
+            bool written = std::any_of(pass->writes.begin(), pass->writes.end(), [&](const _Usage &write) {
+                return write.resource == usage.resource;
+            });
+
+            if (!written)
+                _transition(&resources[usage.resource], usage.access, &barriers);
+        }
+
+        barriers.flush(cmd_buffer);
+        pass->execute(cmd_buffer, this);
+    }
+
+    // hand the imported resources back in the access the next user expects.
+    for (auto &resource: resources) {
+        if (resource.imported && resource.first_pass != UINT32_MAX)
+            _transition(&resource, resource.final_access, &barriers);
+    }
+
+    barriers.flush(cmd_buffer);
+}
+
+void RenderGraph::reset()
+{
+    passes.clear();
+    resources.clear();
+    culled_pass_count = 0;
+    compiled = false;
+}
+
+// walks the passes backwards, a pass survives when it has a side effect, writes an
+// imported resource or writes something a surviving pass reads.
+void RenderGraph::_cull_passes()
+{
+    std::vector<bool> needed(resources.size(), false);
+    culled_pass_count = 0;
+
+    for (uint32_t i = (uint32_t) passes.size(); i-- > 0;) {
+        _Pass *pass = &passes[i];
+
+        bool alive = pass->side_effect;
+        for (const auto &usage: pass->writes)
+            alive = alive || resources[usage.resource].imported || needed[usage.resource];
+
+        pass->culled = !alive;
+        if (pass->culled) {
+            culled_pass_count++;
+            continue;
+        }
+
+        for (const auto &usage: pass->reads)
+            needed[usage.resource] = true;
+    }
+}
+
+void RenderGraph::_compute_lifetimes()
+{
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        _Pass *pass = &passes[i];
+        if (pass->culled)
+            continue;
+
+        auto use = [&](const _Usage &usage) {
+            _Resource *resource = &resources[usage.resource];
+            resource->first_pass = std::min(resource->first_pass, i);
+            resource->last_pass = std::max(resource->last_pass, i);
+        };
+
+        std::for_each(pass->reads.begin(), pass->reads.end(), use);
+        std::for_each(pass->writes.begin(), pass->writes.end(), use);
+    }
+}
+
+// transient textures are placed largest first into the first memory block whose
+// textures are all dead before it is born or born after it died.
+void RenderGraph::_allocate_transient_textures()
+{
+    std::vector<ResourceID> transients;
+    std::vector<VkMemoryRequirements> requirements(resources.size());
+
+    for (ResourceID id = 0; id < resources.size(); id++) {
+        _Resource *resource = &resources[id];
+        if (resource->imported || resource->first_pass == UINT32_MAX)
+            continue;
+
+        rd->get_texture_memory_requirements(&resource->create_info, &requirements[id]);
+        transients.push_back(id);
+    }
+
+    std::sort(transients.begin(), transients.end(), [&](ResourceID a, ResourceID b) {
+        return requirements[a].size > requirements[b].size;
+    });
+
+    std::vector<VkMemoryRequirements> block_requirements;
+    std::vector<std::vector<ResourceID>> block_residents;
+
+    for (ResourceID id: transients) {
+        _Resource *resource = &resources[id];
+        const VkMemoryRequirements &requirement = requirements[id];
+
+        uint32_t block;
+        for (block = 0; block < block_requirements.size(); block++) {
+            if (!(block_requirements[block].memoryTypeBits & requirement.memoryTypeBits))
+                continue;
+
+            bool overlap = std::any_of(block_residents[block].begin(), block_residents[block].end(), [&](ResourceID resident) {
+                return resources[resident].first_pass <= resource->last_pass && resource->first_pass <= resources[resident].last_pass;
+            });
+
+            if (!overlap)
+                break;
+        }
+
+        if (block == block_requirements.size()) {
+            block_requirements.push_back(requirement);
+            block_residents.emplace_back();
+        }
+
+        VkMemoryRequirements *placed = &block_requirements[block];
+        placed->size = std::max(placed->size, requirement.size);
+        placed->alignment = std::max(placed->alignment, requirement.alignment);
+        placed->memoryTypeBits &= requirement.memoryTypeBits;
+
+        block_residents[block].push_back(id);
+        resource->memory_block = (int32_t) block;
+    }
+
+    // keep the physical textures while the placement has not changed.
+    std::vector<_TransientKey> keys;
+    for (ResourceID id = 0; id < resources.size(); id++) {
+        _Resource *resource = &resources[id];
+        if (resource->memory_block < 0)
+            continue;
+
+        _TransientKey key = {};
+        key.width = resource->create_info.width;
+        key.height = resource->create_info.height;
+        key.format = resource->create_info.format;
+        key.samples = resource->create_info.samples;
+        key.usage = resource->create_info.usage;
+        key.aspect_mask = resource->create_info.aspect_mask;
+        key.memory_block = resource->memory_block;
+        keys.push_back(key);
+    }
+
+    bool reuse = keys.size() == transient_keys.size() && block_requirements.size() == memory_blocks.size() &&
+                 (keys.empty() || !memcmp(keys.data(), transient_keys.data(), keys.size() * sizeof(_TransientKey)));
+
+    for (uint32_t block = 0; reuse && block < block_requirements.size(); block++) {
+        const VkMemoryRequirements &current = memory_blocks[block].requirements;
+        reuse = current.size == block_requirements[block].size && current.memoryTypeBits == block_requirements[block].memoryTypeBits;
+    }
+
+    if (!reuse) {
+        _release_transient_textures();
+
+        for (const auto &requirement: block_requirements) {
+            _MemoryBlock memory_block;
+            memory_block.requirements = requirement;
+            memory_block.allocation = rd->allocate_memory(&requirement);
+            memory_blocks.push_back(memory_block);
+        }
+
+        for (ResourceID id = 0; id < resources.size(); id++) {
+            _Resource *resource = &resources[id];
+            if (resource->memory_block >= 0)
+                transient_textures.push_back(rd->create_aliasing_texture(&resource->create_info, memory_blocks[resource->memory_block].allocation));
+        }
+
+        transient_keys = std::move(keys);
+    }
+
+    // the state is taken over from the memory block once execute reaches the
+    // first use, the previous contents are discarded.
+    uint32_t index = 0;
+    for (auto &resource: resources) {
+        if (resource.memory_block >= 0)
+            resource.texture = transient_textures[index++];
+    }
+}
+
+void RenderGraph::_release_transient_textures()
+{
+    for (RenderDevice::Texture2D *texture: transient_textures)
+        rd->destroy_texture(texture);
+
+    for (const auto &memory_block: memory_blocks)
+        rd->free_memory(memory_block.allocation);
+
+    transient_textures.clear();
+    transient_keys.clear();
+    memory_blocks.clear();
+}
+
+void RenderGraph::_transition(_Resource *resource, Access access, BarrierBuilder *p_barriers)
+{
+    const _AccessInfo &info = _get_access_info(access);
+    _State *state = &resource->state;
+
+    bool layout_change = resource->texture != NULL && state->layout != info.layout;
+    bool hazard = state->written || info.write;
+
+    if (!layout_change && !hazard) {
+        // reads after reads only have to be merged into the state.
+        state->stage_mask |= info.stage_mask;
+        state->access_mask |= info.access_mask;
+    } else if (resource->texture != NULL) {
+        // the graph tracks the layout itself, aliased memory starts undefined.
+        p_barriers->image_range(resource->texture, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS,
+                                state->layout, info.layout,
+                                state->stage_mask, state->written ? state->access_mask : VK_ACCESS_2_NONE,
+                                info.stage_mask, info.access_mask);
+
+        *state = { info.stage_mask, info.access_mask, info.layout, info.write };
+        resource->texture->image_layout = info.layout;
+    } else {
+        p_barriers->buffer(resource->buffer, 0, VK_WHOLE_SIZE,
+                           state->stage_mask, state->written ? state->access_mask : VK_ACCESS_2_NONE,
+                           info.stage_mask, info.access_mask);
+
+        *state = { info.stage_mask, info.access_mask, VK_IMAGE_LAYOUT_UNDEFINED, info.write };
+    }
+
+    if (resource->memory_block >= 0)
+        memory_blocks[resource->memory_block].state = *state;
+}
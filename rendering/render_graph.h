@@ -0,0 +1,183 @@
+/* ======================================================================== */
+/* render_graph.h                                                           */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _RENDER_GRAPH_H_
+#define _RENDER_GRAPH_H_
+
+#include "drivers/render_device.h"
+#include <functional>
+#include <vector>
+
+class BarrierBuilder;
+
+// frame graph of the renderer. passes declare which resources they read and write,
+// compile culls the passes nothing depends on, places transient textures with
+// disjoint lifetimes in shared memory and execute records the passes with the
+// barriers derived from the declared accesses. the graph is rebuilt every frame,
+// physical transient textures are kept as long as the layout stays the same.
+class RenderGraph {
+public:
+    U_MEMNEW_ONLY RenderGraph(RenderDevice *v_rd);
+   ~RenderGraph();
+
+    typedef uint32_t ResourceID;
+
+    // how a pass uses a resource, every access maps to exact stage, access and
+    // layout masks.
+    enum Access {
+        ACCESS_NONE,
+        ACCESS_COLOR_ATTACHMENT_WRITE,
+        ACCESS_DEPTH_ATTACHMENT_WRITE,
+        ACCESS_DEPTH_ATTACHMENT_READ,
+        ACCESS_FRAGMENT_SHADER_READ,
+        ACCESS_COMPUTE_SHADER_READ,
+        ACCESS_COMPUTE_STORAGE_READ,
+        ACCESS_COMPUTE_STORAGE_WRITE,
+        ACCESS_TRANSFER_READ,
+        ACCESS_TRANSFER_WRITE,
+        ACCESS_VERTEX_BUFFER_READ,
+        ACCESS_INDEX_BUFFER_READ,
+        ACCESS_INDIRECT_BUFFER_READ,
+        ACCESS_UNIFORM_BUFFER_READ,
+        ACCESS_MAX,
+    };
+
+    class PassBuilder {
+    public:
+        void read(ResourceID id, Access access);
+        void write(ResourceID id, Access access);
+        // keeps the pass alive even when nothing reads its outputs.
+        void side_effect();
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph *v_graph, uint32_t v_pass) : graph(v_graph), pass(v_pass) {}
+
+        RenderGraph *graph;
+        uint32_t pass;
+    };
+
+    typedef std::function<void(PassBuilder &)> PassSetup;
+    typedef std::function<void(VkCommandBuffer, RenderGraph *)> PassExecute;
+
+    // imported resources outlive the frame. the graph expects them in v_final_access
+    // when the frame starts and leaves them there once it has executed.
+    ResourceID import_texture(const char *name, RenderDevice::Texture2D *texture, Access v_final_access);
+    ResourceID import_buffer(const char *name, RenderDevice::Buffer *buffer, Access v_final_access);
+    // transient textures only exist between their first and last use in the frame.
+    ResourceID create_texture(const char *name, RenderDevice::TextureCreateInfo *p_create_info);
+
+    void add_pass(const char *name, PassSetup v_setup, PassExecute v_execute);
+
+    // physical resources of the graph, valid inside a pass execute.
+    RenderDevice::Texture2D *get_texture(ResourceID id);
+    RenderDevice::Buffer *get_buffer(ResourceID id);
+
+    void compile();
+    void execute(VkCommandBuffer cmd_buffer);
+    // drops every pass and resource of the frame, the transient memory is kept.
+    void reset();
+
+    uint32_t get_pass_count() { return (uint32_t) passes.size(); }
+    uint32_t get_culled_pass_count() { return culled_pass_count; }
+    uint32_t get_transient_memory_block_count() { return (uint32_t) memory_blocks.size(); }
+
+private:
+    struct _Usage {
+        ResourceID resource;
+        Access access;
+    };
+
+    struct _Pass {
+        const char *name;
+        PassExecute execute;
+        std::vector<_Usage> reads;
+        std::vector<_Usage> writes;
+        bool side_effect = false;
+        bool culled = false;
+    };
+
+    struct _State {
+        VkPipelineStageFlags2 stage_mask = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 access_mask = VK_ACCESS_2_NONE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool written = false; /* the last access was a write */
+    };
+
+    struct _Resource {
+        const char *name;
+        RenderDevice::Texture2D *texture = NULL;
+        RenderDevice::Buffer *buffer = NULL;
+        RenderDevice::TextureCreateInfo create_info = {};
+        bool imported = false;
+        Access final_access = ACCESS_NONE;
+        uint32_t first_pass = UINT32_MAX;
+        uint32_t last_pass = 0;
+        int32_t memory_block = -1;
+        _State state;
+    };
+
+    struct _MemoryBlock {
+        VmaAllocation allocation;
+        VkMemoryRequirements requirements;
+        _State state; /* last access of whichever texture used the memory */
+    };
+
+    // the physical layout of the transient textures, reused while it matches.
+    struct _TransientKey {
+        uint32_t width;
+        uint32_t height;
+        VkFormat format;
+        VkSampleCountFlagBits samples;
+        VkImageUsageFlags usage;
+        VkImageAspectFlags aspect_mask;
+        int32_t memory_block;
+    };
+
+    struct _AccessInfo {
+        VkPipelineStageFlags2 stage_mask;
+        VkAccessFlags2 access_mask;
+        VkImageLayout layout;
+        bool write;
+    };
+
+    static const _AccessInfo &_get_access_info(Access access);
+
+    ResourceID _add_resource(const char *name);
+    void _cull_passes();
+    void _compute_lifetimes();
+    void _allocate_transient_textures();
+    void _release_transient_textures();
+    void _transition(_Resource *resource, Access access, BarrierBuilder *p_barriers);
+
+    RenderDevice *rd;
+    std::vector<_Pass> passes;
+    std::vector<_Resource> resources;
+    uint32_t culled_pass_count = 0;
+    bool compiled = false;
+
+    std::vector<_MemoryBlock> memory_blocks;
+    std::vector<_TransientKey> transient_keys;
+    std::vector<RenderDevice::Texture2D *> transient_textures;
+};
+
+#endif /* _RENDER_GRAPH_H_ */
@@ -21,8 +21,6 @@
 /*                                                                          */
 /* ======================================================================== */
 #include "render_object.h"
-#include "modules/obj.h"
-#include <tinyobjloader/tiny_obj_loader.h>
 
 RenderObject::RenderObject()
 {
@@ -39,8 +37,7 @@ RenderObject::RenderObject()
 
 RenderObject::~RenderObject()
 {
-    rd->destroy_buffer(vertex_buffer);
-    rd->destroy_buffer(index_buffer);
+    /* mesh buffers are owned by the asset loader */
 }
 
 void RenderObject::update()
@@ -72,54 +69,39 @@ void RenderObject::initialize(RenderDevice *v_rd, Physical3D *v_physical)
     rd = v_rd;
     physical = v_physical;
 
-    size_t vertex_buffer_size = std::size(meshes) * sizeof(Mesh);
-    size_t index_buffer_size = std::size(indices) * sizeof(uint32_t);
-
-    vertex_buffer = rd->create_buffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertex_buffer_size);
-    index_buffer = rd->create_buffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, index_buffer_size);
-
-    rd->write_buffer(vertex_buffer, 0, vertex_buffer_size, std::data(meshes));
-    rd->write_buffer(index_buffer, 0, index_buffer_size, std::data(indices));
-
     rb = physical->create_rigid_body();
 }
 
 void RenderObject::cmd_bind(VkCommandBuffer cmd_buffer)
 {
     update();
-    rd->cmd_bind_vertex_buffer(cmd_buffer, vertex_buffer);
-    rd->cmd_bind_index_buffer(cmd_buffer, VK_INDEX_TYPE_UINT32, index_buffer);
+
+    const AssetLoader::Mesh *resident = AssetLoader::get_mesh(mesh);
+    if (!resident)
+        return;
+
+    rd->cmd_bind_vertex_buffer(cmd_buffer, resident->vertex_buffer);
+    rd->cmd_bind_index_buffer(cmd_buffer, VK_INDEX_TYPE_UINT32, resident->index_buffer);
 }
 
 void RenderObject::cmd_draw(VkCommandBuffer cmd_buffer, RenderDevice::Pipeline *pipeline)
 {
+    // not drawn until the mesh is resident.
+    const AssetLoader::Mesh *resident = AssetLoader::get_mesh(mesh);
+    if (!resident)
+        return;
+
     cmd_bind(cmd_buffer);
     rd->cmd_push_const(cmd_buffer, pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4), &transform);
-    rd->cmd_draw_indexed(cmd_buffer, std::size(indices));
+    rd->cmd_draw_indexed(cmd_buffer, resident->index_count);
 }
 
 RenderObject *RenderObject::load_obj(const char *filename)
 {
-    RenderObject *object = memnew(RenderObject);
+    static_assert(sizeof(Mesh) == sizeof(ObjLoader::Vertex), "mesh layout must match the cached vertex layout");
 
-    ObjLoader *loader = ObjLoader::load(filename);
-
-    std::vector<ObjLoader::Vertex> vertices = loader->get_vertices();
-    std::vector<uint32_t> indices = loader->get_indices();
-
-    for (const auto &vertex: vertices) {
-        object->meshes.push_back({
-          vertex.position,
-          vertex.texcoord,
-          vertex.normal,
-        });
-    }
-
-    for (const auto &index: indices) {
-        object->indices.push_back(index);
-    }
-
-    ObjLoader::destroy(loader);
+    RenderObject *object = memnew(RenderObject);
+    object->mesh = AssetLoader::load_mesh(filename);
 
     return object;
-}
\ No newline at end of file
+}
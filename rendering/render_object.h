@@ -27,6 +27,7 @@
 #include <bright/math.h>
 #include <bright/properties.h>
 #include "physical3d/physical_3d.h"
+#include "asset_loader.h"
 
 class RenderObject : public NodeProperties {
 public:
@@ -63,8 +64,7 @@ private:
     Physical3D *physical;
     Physical3DRigidBody *rb;
 
-    std::vector<Mesh> meshes;
-    std::vector<uint32_t> indices;
+    AssetLoader::MeshHandle mesh;
     mat4 transform = mat4(1.0f);
     RenderDevice *rd;
 
@@ -73,8 +73,6 @@ private:
     vec3 scaling = vec3(1.0f);
 
     const char *name;
-    RenderDevice::Buffer *vertex_buffer = VK_NULL_HANDLE;
-    RenderDevice::Buffer *index_buffer = VK_NULL_HANDLE;
 };
 
 #endif /* _GRAPHICS_OBJECT_H_ */
@@ -0,0 +1,131 @@
+/* ======================================================================== */
+/* render_target_pool.cpp                                                   */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "render_target_pool.h"
+
+RenderTargetPool::RenderTargetPool(RenderDevice *v_rd, VkFormat v_color_format, VkFormat v_depth_format, VkSampler v_sampler)
+    : rd(v_rd), color_format(v_color_format), depth_format(v_depth_format), sampler(v_sampler)
+{
+    /* do nothing... */
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+    for (RenderTarget *target: targets)
+        _destroy_render_target(target);
+}
+
+RenderTargetPool::RenderTarget *RenderTargetPool::acquire(uint32_t v_width, uint32_t v_height, bool v_depth_resolve)
+{
+    uint32_t class_width = get_size_class(v_width);
+    uint32_t class_height = get_size_class(v_height);
+
+    RenderTarget *target = NULL;
+    for (RenderTarget *pooled: targets) {
+        if (pooled->width == class_width && pooled->height == class_height) {
+            target = pooled;
+            break;
+        }
+    }
+
+    if (target == NULL) {
+        target = _create_render_target(class_width, class_height);
+        targets.push_back(target);
+    }
+
+    if (v_depth_resolve && target->depth_resolve == NULL)
+        _create_depth_resolve(target);
+    else if (!v_depth_resolve && target->depth_resolve != NULL)
+        _destroy_depth_resolve(target);
+
+    target->last_used_frame = rd->get_frame_index();
+    _evict_unused_targets(target);
+
+    return target;
+}
+
+RenderTargetPool::RenderTarget *RenderTargetPool::_create_render_target(uint32_t width, uint32_t height)
+{
+    RenderTarget *target = (RenderTarget *) imalloc(sizeof(RenderTarget));
+    target->width = width;
+    target->height = height;
+
+    RenderDevice::TextureCreateInfo texture_create_info = {};
+    texture_create_info.width = width;
+    texture_create_info.height = height;
+    texture_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    texture_create_info.format = color_format;
+    texture_create_info.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
+    texture_create_info.image_type = VK_IMAGE_TYPE_2D;
+    texture_create_info.image_view_type = VK_IMAGE_VIEW_TYPE_2D;
+    texture_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    target->texture = rd->create_texture(&texture_create_info);
+    rd->bind_texture_sampler(target->texture, sampler);
+
+    return target;
+}
+
+void RenderTargetPool::_destroy_render_target(RenderTarget *target)
+{
+    if (target->depth_resolve != NULL)
+        _destroy_depth_resolve(target);
+
+    rd->destroy_texture(target->texture);
+    free(target);
+}
+
+void RenderTargetPool::_create_depth_resolve(RenderTarget *target)
+{
+    RenderDevice::TextureCreateInfo texture_create_info = {};
+    texture_create_info.width = target->width;
+    texture_create_info.height = target->height;
+    texture_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    texture_create_info.format = depth_format;
+    texture_create_info.aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    texture_create_info.image_type = VK_IMAGE_TYPE_2D;
+    texture_create_info.image_view_type = VK_IMAGE_VIEW_TYPE_2D;
+    texture_create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    target->depth_resolve = rd->create_texture(&texture_create_info);
+
+    rd->bind_texture_sampler(target->depth_resolve, sampler);
+}
+
+void RenderTargetPool::_destroy_depth_resolve(RenderTarget *target)
+{
+    rd->destroy_texture(target->depth_resolve);
+    target->depth_resolve = NULL;
+}
+
+void RenderTargetPool::_evict_unused_targets(RenderTarget *current)
+{
+    uint64_t frame_index = rd->get_frame_index();
+
+    for (auto it = targets.begin(); it != targets.end();) {
+        RenderTarget *target = *it;
+        if (target != current && frame_index - target->last_used_frame > RENDER_TARGET_EVICT_FRAMES) {
+            _destroy_render_target(target);
+            it = targets.erase(it);
+            continue;
+        }
+        it++;
+    }
+}
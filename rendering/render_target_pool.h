@@ -0,0 +1,76 @@
+/* ======================================================================== */
+/* render_target_pool.h                                                     */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _RENDER_TARGET_POOL_H_
+#define _RENDER_TARGET_POOL_H_
+
+#include "drivers/render_device.h"
+#include <vector>
+
+// targets are allocated in size classes rounded up to this granularity, a viewport
+// only needs new attachments once it leaves its class.
+#define RENDER_TARGET_SIZE_GRANULARITY 128
+// pooled targets that were not acquired for this many frames are released.
+#define RENDER_TARGET_EVICT_FRAMES 120
+
+class RenderTargetPool {
+public:
+    U_MEMNEW_ONLY RenderTargetPool(RenderDevice *v_rd, VkFormat v_color_format, VkFormat v_depth_format, VkSampler v_sampler);
+   ~RenderTargetPool();
+
+    // the resolved color and the optional resolved depth outlive the frame, the msaa
+    // color and depth they are resolved from are transient textures of the render graph.
+    struct RenderTarget {
+        RenderDevice::Texture2D *texture;
+        RenderDevice::Texture2D *depth_resolve; /* NULL unless requested */
+        uint32_t width;
+        uint32_t height;
+        uint64_t last_used_frame;
+    };
+
+    static uint32_t get_size_class(uint32_t size)
+      {
+        size = std::max(size, 1u);
+        return (size + RENDER_TARGET_SIZE_GRANULARITY - 1) / RENDER_TARGET_SIZE_GRANULARITY * RENDER_TARGET_SIZE_GRANULARITY;
+      }
+
+    // returns the pooled target of the size class covering v_width x v_height and
+    // creates it when the pool has none, the caller renders into a sub-rectangle.
+    // the resolved depth is created on demand and released once not requested.
+    RenderTarget *acquire(uint32_t v_width, uint32_t v_height, bool v_depth_resolve);
+    uint32_t get_target_count() { return (uint32_t) targets.size(); }
+
+private:
+    RenderTarget *_create_render_target(uint32_t width, uint32_t height);
+    void _destroy_render_target(RenderTarget *target);
+    void _create_depth_resolve(RenderTarget *target);
+    void _destroy_depth_resolve(RenderTarget *target);
+    void _evict_unused_targets(RenderTarget *current);
+
+    RenderDevice *rd;
+    VkFormat color_format;
+    VkFormat depth_format;
+    VkSampler sampler;
+    std::vector<RenderTarget *> targets;
+};
+
+#endif /* _RENDER_TARGET_POOL_H_ */
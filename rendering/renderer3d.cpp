@@ -75,6 +75,12 @@ void Renderer3D::enable_coordinate_axis(bool is_enable)
     scene->enable_coordinate_axis(is_enable);
 }
 
+void Renderer3D::enable_depth_preview(bool is_enable)
+{
+    _CHECK_RENDERER_INIT();
+    scene->enable_depth_preview(is_enable);
+}
+
 void Renderer3D::list_render_object(std::vector<RenderObject *> **p_objects)
 {
     _CHECK_RENDERER_INIT();
@@ -98,4 +104,22 @@ void Renderer3D::end_scene(RenderDevice::Texture2D **texture, RenderDevice::Text
     _CHECK_RENDERER_INIT();
     scene->cmd_end_scene_renderer(texture, depth);
 }
+
+void Renderer3D::get_scene_extent(uint32_t *p_width, uint32_t *p_height)
+{
+    _CHECK_RENDERER_INIT();
+    scene->get_scene_extent(p_width, p_height);
+}
+
+std::future<RenderDevice::ReadbackResult> Renderer3D::capture_scene()
+{
+    _CHECK_RENDERER_INIT();
+    return scene->capture_scene();
+}
+
+std::future<RenderDevice::ReadbackResult> Renderer3D::read_scene_depth(uint32_t x, uint32_t y)
+{
+    _CHECK_RENDERER_INIT();
+    return scene->read_scene_depth(x, y);
+}
 #pragma clang diagnostic pop
\ No newline at end of file
@@ -40,11 +40,23 @@ public:
     static RenderingDirectionalLight *get_scene_directional_light();
     static RenderingSkySphere* get_scene_sky_sphere();
     static void enable_coordinate_axis(bool is_enable);
+    // the scene depth returned by end_scene is NULL while the preview is disabled.
+    static void enable_depth_preview(bool is_enable);
     static void list_render_object(std::vector<RenderObject *> **p_objects);
     static void push_render_object(RenderObject *v_object);
 
     static void begin_scene(uint32_t v_width, uint32_t v_height);
     static void end_scene(RenderDevice::Texture2D **texture, RenderDevice::Texture2D **depth);
+    // extent of the scene inside the texture returned by end_scene, the texture
+    // itself is allocated in rounded size classes.
+    static void get_scene_extent(uint32_t *p_width, uint32_t *p_height);
+    // asynchronous readbacks of the scene, call them between end_scene and the end of
+    // the frame. the futures are resolved once the frame has retired. capture_scene
+    // returns the visible extent of the scene color, e.g. for screenshots and image
+    // comparisons. read_scene_depth returns one depth texel for picking, it comes
+    // back empty while the depth preview is disabled.
+    static std::future<RenderDevice::ReadbackResult> capture_scene();
+    static std::future<RenderDevice::ReadbackResult> read_scene_depth(uint32_t x, uint32_t y);
 
 private:
     static RenderDevice *rd;
@@ -33,17 +33,21 @@ RendererScene::RendererScene(RenderDevice *v_rd)
     scene->initialize();
 
     skysphere = memnew(RenderingSkySphere, rd, render_data);
-    skysphere->initialize(scene->get_render_pass());
+    skysphere->initialize(scene->get_framebuffer_format());
 
     axisline = memnew(RenderingCoordinateAxis, rd, render_data);
-    axisline->initialize(scene->get_render_pass());
+    axisline->initialize(scene->get_framebuffer_format());
 
     graphics = memnew(RenderingGraphics, rd, render_data);
-    graphics->initialize(scene->get_render_pass());
+    graphics->initialize(scene->get_framebuffer_format());
+
+    graph = memnew(RenderGraph, rd);
+    graph_queue = rd->get_device_context()->get_graph_queue();
 }
 
 RendererScene::~RendererScene()
 {
+    memdel(graph);
     memdel(axisline);
     memdel(graphics);
     memdel(skysphere);
@@ -67,6 +71,11 @@ void RendererScene::enable_coordinate_axis(bool is_enable)
     show_coordinate_axis = is_enable;
 }
 
+void RendererScene::enable_depth_preview(bool is_enable)
+{
+    scene->enable_depth_resolve(is_enable);
+}
+
 void RendererScene::list_render_object(std::vector<RenderObject *> **p_objects)
 {
     graphics->list_render_object(p_objects);
@@ -90,31 +99,122 @@ void RendererScene::cmd_begin_scene_renderer(uint32_t v_width, uint32_t v_height
     perspective.view = camera->get_view_matrix();
     perspective.projection = camera->get_projection_matrix();
 
+    // the rendered extent can lag behind the requested one while resizing.
+    scene->set_scene_extent(v_width, v_height);
+
     render_data->set_render_data(
-        v_width,
-        v_height,
+        scene->get_scene_width(),
+        scene->get_scene_height(),
         &perspective,
         &light
     );
+}
 
-    // render
-    scene->set_scene_extent(v_width, v_height);
-    scene->cmd_begin_scene_rendering(&scene_cmd_buffer);
-
-    if (show_coordinate_axis)
-        axisline->cmd_draw_coordinate_axis(scene_cmd_buffer);
-
-    skysphere->cmd_draw_sky_sphere(scene_cmd_buffer);
-    graphics->cmd_draw_object_list(scene_cmd_buffer);
+void RendererScene::get_scene_extent(uint32_t *p_width, uint32_t *p_height)
+{
+    *p_width = scene->get_scene_width();
+    *p_height = scene->get_scene_height();
 }
 
 void RendererScene::cmd_end_scene_renderer(RenderDevice::Texture2D **scene_texture, RenderDevice::Texture2D **scene_depth)
 {
-    scene->cmd_end_scene_rendering();
+    _build_render_graph();
+    graph->compile();
+
+    VkCommandBuffer scene_cmd_buffer = rd->allocate_frame_cmd_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    rd->cmd_buffer_begin(scene_cmd_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    graph->execute(scene_cmd_buffer);
+    rd->cmd_buffer_end(scene_cmd_buffer);
+
+    // submitted together with the screen pass of the frame.
+    rd->enqueue_submission(scene_cmd_buffer,
+                           0, nullptr,
+                           0, nullptr,
+                           nullptr,
+                           graph_queue);
 
     if (scene_texture != NULL)
         *scene_texture = scene->get_scene_texture();
 
     if (scene_depth != NULL)
         *scene_depth = scene->get_scene_depth();
-}
\ No newline at end of file
+}
+
+std::future<RenderDevice::ReadbackResult> RendererScene::capture_scene()
+{
+    VkRect2D rect = { { 0, 0 }, { scene->get_scene_width(), scene->get_scene_height() } };
+    return _readback_scene_texture(scene->get_scene_texture(), rect);
+}
+
+std::future<RenderDevice::ReadbackResult> RendererScene::read_scene_depth(uint32_t x, uint32_t y)
+{
+    RenderDevice::Texture2D *depth = scene->get_scene_depth();
+    if (depth == NULL || x >= scene->get_scene_width() || y >= scene->get_scene_height()) {
+        std::promise<RenderDevice::ReadbackResult> empty;
+        empty.set_value({});
+        return empty.get_future();
+    }
+
+    VkRect2D rect = { { (int32_t) x, (int32_t) y }, { 1, 1 } };
+    return _readback_scene_texture(depth, rect);
+}
+
+// recorded after the scene command buffer and submitted with it, the graph has left
+// the textures in their shader read layouts.
+std::future<RenderDevice::ReadbackResult> RendererScene::_readback_scene_texture(RenderDevice::Texture2D *texture, VkRect2D rect)
+{
+    VkCommandBuffer cmd_buffer = rd->allocate_frame_cmd_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    rd->cmd_buffer_begin(cmd_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    std::future<RenderDevice::ReadbackResult> future = rd->cmd_readback_texture(cmd_buffer, texture, &rect);
+    rd->cmd_buffer_end(cmd_buffer);
+
+    rd->enqueue_submission(cmd_buffer,
+                           0, nullptr,
+                           0, nullptr,
+                           nullptr,
+                           graph_queue);
+
+    return future;
+}
+
+// the editor samples the scene color and depth in the screen pass, the graph leaves
+// both ready for fragment shader reads. the msaa attachments are transient, they
+// only live inside the scene pass.
+void RendererScene::_build_render_graph()
+{
+    graph->reset();
+
+    RenderDevice::TextureCreateInfo msaa_create_info, msaa_depth_create_info;
+    scene->get_scene_msaa_create_info(&msaa_create_info, &msaa_depth_create_info);
+    RenderGraph::ResourceID msaa_id = graph->create_texture("scene_msaa", &msaa_create_info);
+    RenderGraph::ResourceID msaa_depth_id = graph->create_texture("scene_msaa_depth", &msaa_depth_create_info);
+
+    RenderDevice::Texture2D *depth = scene->get_scene_depth();
+    RenderGraph::ResourceID color_id = graph->import_texture("scene_color", scene->get_scene_texture(), RenderGraph::ACCESS_FRAGMENT_SHADER_READ);
+    RenderGraph::ResourceID depth_id = depth != NULL ? graph->import_texture("scene_depth", depth, RenderGraph::ACCESS_FRAGMENT_SHADER_READ) : 0;
+
+    graph->add_pass("scene", [&](RenderGraph::PassBuilder &builder) {
+        builder.write(msaa_id, RenderGraph::ACCESS_COLOR_ATTACHMENT_WRITE);
+        builder.write(msaa_depth_id, RenderGraph::ACCESS_DEPTH_ATTACHMENT_WRITE);
+        builder.write(color_id, RenderGraph::ACCESS_COLOR_ATTACHMENT_WRITE);
+        if (depth != NULL)
+            builder.write(depth_id, RenderGraph::ACCESS_DEPTH_ATTACHMENT_WRITE);
+    }, [this, msaa_id, msaa_depth_id](VkCommandBuffer cmd_buffer, RenderGraph *v_graph) {
+        // the axis and the sky go first, the object list is recorded in parallel batches.
+        VkCommandBuffer background_cmd_buffer = rd->allocate_frame_cmd_buffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        rd->cmd_buffer_begin_secondary(background_cmd_buffer, scene->get_framebuffer_format(), rd->get_msaa_samples());
+
+        if (show_coordinate_axis)
+            axisline->cmd_draw_coordinate_axis(background_cmd_buffer);
+
+        skysphere->cmd_draw_sky_sphere(background_cmd_buffer);
+        rd->cmd_buffer_end(background_cmd_buffer);
+
+        std::vector<VkCommandBuffer> cmd_buffers = { background_cmd_buffer };
+        graphics->cmd_record_object_list(&cmd_buffers);
+
+        scene->cmd_begin_scene_rendering(cmd_buffer, v_graph->get_texture(msaa_id), v_graph->get_texture(msaa_depth_id));
+        rd->cmd_execute_commands(cmd_buffer, (uint32_t) std::size(cmd_buffers), std::data(cmd_buffers));
+        scene->cmd_end_scene_rendering(cmd_buffer);
+    });
+}
@@ -26,6 +26,7 @@
 #include "drivers/render_device.h"
 #include "camera/camera.h"
 #include "rendering_scene.h"
+#include "render_graph.h"
 #include "rendering_directional_light.h"
 #include "rendering_coordinate_axis.h"
 #include "rendering_graphics.h"
@@ -42,12 +43,20 @@ public:
     RenderingDirectionalLight* get_directional_light() { return directional_light; }
     RenderingSkySphere* get_sky_shpere() { return skysphere; }
     void enable_coordinate_axis(bool is_enable);
+    void enable_depth_preview(bool is_enable);
     void list_render_object(std::vector<RenderObject *> **p_objects);
     void push_render_object(RenderObject *v_object);
     void cmd_begin_scene_renderer(uint32_t v_width, uint32_t v_height);
+    void get_scene_extent(uint32_t *p_width, uint32_t *p_height);
     void cmd_end_scene_renderer(RenderDevice::Texture2D **scene_texture, RenderDevice::Texture2D **scene_depth);
+    // readbacks of the scene ended this frame, see Renderer3D.
+    std::future<RenderDevice::ReadbackResult> capture_scene();
+    std::future<RenderDevice::ReadbackResult> read_scene_depth(uint32_t x, uint32_t y);
 
 private:
+    void _build_render_graph();
+    std::future<RenderDevice::ReadbackResult> _readback_scene_texture(RenderDevice::Texture2D *texture, VkRect2D rect);
+
     RenderDevice *rd;
     SceneRenderData *render_data;
     RenderingScene *scene;
@@ -55,7 +64,8 @@ private:
     RenderingSkySphere *skysphere;
     RenderingDirectionalLight* directional_light;
     RenderingGraphics *graphics;
-    VkCommandBuffer scene_cmd_buffer;
+    RenderGraph *graph;
+    VkQueue graph_queue;
     Camera *camera;
 
     bool show_coordinate_axis = true;
@@ -35,7 +35,7 @@ RenderingCoordinateAxis::~RenderingCoordinateAxis()
     rd->destroy_descriptor_set_layout(descriptor_set_layout);
 }
 
-void RenderingCoordinateAxis::initialize(VkRenderPass render_pass)
+void RenderingCoordinateAxis::initialize(RenderDevice::FramebufferFormat *p_framebuffer_format)
 {
     VkDescriptorSetLayoutBinding binds[] = {
             SceneRenderData::GetPerspectiveDescriptorBindZero(),
@@ -54,7 +54,7 @@ void RenderingCoordinateAxis::initialize(VkRenderPass render_pass)
     };
 
     RenderDevice::PipelineCreateInfo create_info = {
-            /* render_pass= */ render_pass,
+            /* framebuffer_format= */ *p_framebuffer_format,
             /* polygon= */ VK_POLYGON_MODE_FILL,
             /* topology= */ VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
             /* cull_mode= */ VK_CULL_MODE_BACK_BIT,
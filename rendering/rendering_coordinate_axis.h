@@ -31,7 +31,7 @@ public:
     U_MEMNEW_ONLY RenderingCoordinateAxis(RenderDevice *v_rd, SceneRenderData *v_render_data);
     ~RenderingCoordinateAxis();
 
-    void initialize(VkRenderPass render_pass);
+    void initialize(RenderDevice::FramebufferFormat *p_framebuffer_format);
 
     void cmd_draw_coordinate_axis(VkCommandBuffer cmd_buffer);
 
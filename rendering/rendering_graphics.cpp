@@ -21,6 +21,7 @@
 /*                                                                          */
 /* ======================================================================== */
 #include "rendering_graphics.h"
+#include "utils/thread_pool.h"
 
 RenderingGraphics::RenderingGraphics(RenderDevice *v_rd, SceneRenderData *v_render_data)
     : rd(v_rd), render_data(v_render_data)
@@ -30,13 +31,17 @@ RenderingGraphics::RenderingGraphics(RenderDevice *v_rd, SceneRenderData *v_rend
 
 RenderingGraphics::~RenderingGraphics()
 {
+    memdel(record_pool);
     rd->destroy_descriptor_set_layout(descriptor_set_layout);
     rd->free_descriptor_set(descriptor_set);
     rd->destroy_pipeline(pipeline);
 }
 
-void RenderingGraphics::initialize(VkRenderPass render_pass)
+void RenderingGraphics::initialize(RenderDevice::FramebufferFormat *p_framebuffer_format)
 {
+    framebuffer_format = *p_framebuffer_format;
+    record_pool = memnew(ThreadPool, ThreadPool::default_thread_count());
+
     VkVertexInputBindingDescription binds[] = {
             { 0, sizeof(RenderObject::Mesh), VK_VERTEX_INPUT_RATE_VERTEX  }
     };
@@ -76,7 +81,7 @@ void RenderingGraphics::initialize(VkRenderPass render_pass)
     };
 
     RenderDevice::PipelineCreateInfo create_info = {
-            /* render_pass= */ render_pass,
+            /* framebuffer_format= */ *p_framebuffer_format,
             /* polygon= */ VK_POLYGON_MODE_FILL,
             /* topology= */ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
             /* cull_mode= */ VK_CULL_MODE_BACK_BIT,
@@ -96,13 +101,45 @@ void RenderingGraphics::push_render_object(RenderObject *object)
     render_objects.push_back(object);
 }
 
-void RenderingGraphics::cmd_draw_object_list(VkCommandBuffer cmd_buffer)
+void RenderingGraphics::cmd_record_object_list(std::vector<VkCommandBuffer> *p_cmd_buffers)
 {
+    size_t object_count = render_objects.size();
+    if (object_count == 0)
+        return;
+
+    size_t batch_count = (object_count + RENDERING_GRAPHICS_OBJECTS_PER_BATCH - 1) / RENDERING_GRAPHICS_OBJECTS_PER_BATCH;
+    size_t batch_size = (object_count + batch_count - 1) / batch_count;
+
+    // buffers are taken on the recording thread, each one comes from the command
+    // pool of the thread it is recorded on.
+    size_t first = p_cmd_buffers->size();
+    p_cmd_buffers->resize(first + batch_count);
+
+    for (size_t i = 1; i < batch_count; i++) {
+        record_pool->push([this, p_cmd_buffers, first, i, batch_size, object_count] {
+            VkCommandBuffer cmd_buffer = rd->allocate_frame_cmd_buffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+            _cmd_record_batch(cmd_buffer, i * batch_size, std::min((i + 1) * batch_size, object_count));
+            (*p_cmd_buffers)[first + i] = cmd_buffer;
+        });
+    }
+
+    VkCommandBuffer cmd_buffer = rd->allocate_frame_cmd_buffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    _cmd_record_batch(cmd_buffer, 0, std::min(batch_size, object_count));
+    (*p_cmd_buffers)[first] = cmd_buffer;
+
+    record_pool->wait_idle();
+}
+
+void RenderingGraphics::_cmd_record_batch(VkCommandBuffer cmd_buffer, size_t begin, size_t end)
+{
+    // secondary buffers inherit no state, every batch binds its own.
+    rd->cmd_buffer_begin_secondary(cmd_buffer, &framebuffer_format, rd->get_msaa_samples());
     rd->cmd_bind_pipeline(cmd_buffer, pipeline);
     rd->cmd_setval_viewport(cmd_buffer, render_data->get_scene_width(), render_data->get_scene_height());
     rd->cmd_bind_descriptor_set(cmd_buffer, pipeline, descriptor_set);
 
-    for (auto &object: render_objects) {
-        object->cmd_draw(cmd_buffer, pipeline);
-    }
-}
\ No newline at end of file
+    for (size_t i = begin; i < end; i++)
+        render_objects[i]->cmd_draw(cmd_buffer, pipeline);
+
+    rd->cmd_buffer_end(cmd_buffer);
+}
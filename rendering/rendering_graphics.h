@@ -26,22 +26,32 @@
 #include "render_object.h"
 #include "scene_render_data.h"
 
+// objects recorded by one secondary command buffer, smaller lists are recorded
+// on the calling thread alone.
+#define RENDERING_GRAPHICS_OBJECTS_PER_BATCH 256
+
 class RenderingGraphics {
 public:
     U_MEMNEW_ONLY RenderingGraphics(RenderDevice *v_rd, SceneRenderData *v_render_data);
     ~RenderingGraphics();
 
-    void initialize(VkRenderPass render_pass);
+    void initialize(RenderDevice::FramebufferFormat *p_framebuffer_format);
     void list_render_object(std::vector<RenderObject *> **p_objects);
     void push_render_object(RenderObject *object);
-    void cmd_draw_object_list(VkCommandBuffer cmd_buffer);
+    // records the object list into secondary command buffers for the scene pass,
+    // the batches are spread over worker threads and appended to p_cmd_buffers.
+    void cmd_record_object_list(std::vector<VkCommandBuffer> *p_cmd_buffers);
 
 private:
+    void _cmd_record_batch(VkCommandBuffer cmd_buffer, size_t begin, size_t end);
+
     RenderDevice *rd;
     SceneRenderData *render_data;
     VkDescriptorSetLayout descriptor_set_layout;
     VkDescriptorSet descriptor_set;
     RenderDevice::Pipeline *pipeline;
+    RenderDevice::FramebufferFormat framebuffer_format;
+    class ThreadPool *record_pool = NULL;
 
     std::vector<RenderObject *> render_objects;
 };
@@ -21,7 +21,6 @@
 /*                                                                          */
 /* ======================================================================== */
 #include "rendering_scene.h"
-#include <array>
 
 RenderingScene::RenderingScene(RenderDevice *p_device)
     : rd(p_device)
@@ -31,196 +30,113 @@ RenderingScene::RenderingScene(RenderDevice *p_device)
 
 RenderingScene::~RenderingScene()
 {
-    _clean_up_scene_texture();
+    memdel(target_pool);
     rd->destroy_sampler(sampler);
-    rd->destroy_render_pass(render_pass);
-    rd->free_cmd_buffer(scene_cmd_buffer);
 }
 
 void RenderingScene::initialize()
 {
-    graph_queue = rd->get_device_context()->get_graph_queue();
-
     std::vector<VkFormat> desred_depth_formats = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
     depth_format = rdc->find_supported_format(desred_depth_formats ,VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 
-    /* ************************ */
-    /*        RenderPass        */
-    /* ************************ */
-    VkAttachmentDescription attachments[] = {
-            {
-                /* flags */ no_flag_bits,
-                /* format */ rd->get_surface_format(),
-                /* samples */ rd->get_msaa_samples(),
-                /* loadOp */ VK_ATTACHMENT_LOAD_OP_CLEAR,
-                /* storeOp */ VK_ATTACHMENT_STORE_OP_STORE,
-                /* stencilLoadOp */ VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                /* stencilStoreOp */ VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                /* initialLayout */ VK_IMAGE_LAYOUT_UNDEFINED,
-                /* finalLayout */ VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            },
-            {
-                /* flags */ no_flag_bits,
-                /* format */ depth_format,
-                /* samples */ rd->get_msaa_samples(),
-                /* loadOp */VK_ATTACHMENT_LOAD_OP_CLEAR,
-                /* storeOp */ VK_ATTACHMENT_STORE_OP_STORE,
-                /* stencilLoadOp */ VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                /* stencilStoreOp */ VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                /* initialLayout */ VK_IMAGE_LAYOUT_UNDEFINED,
-                /* finalLayout */ VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-            },
-            {
-                /* flags */ no_flag_bits,
-                /* format */ rd->get_surface_format(),
-                /* samples */ VK_SAMPLE_COUNT_1_BIT,
-                /* loadOp */VK_ATTACHMENT_LOAD_OP_CLEAR,
-                /* storeOp */ VK_ATTACHMENT_STORE_OP_STORE,
-                /* stencilLoadOp */ VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                /* stencilStoreOp */ VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                /* initialLayout */ VK_IMAGE_LAYOUT_UNDEFINED,
-                /* finalLayout */ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            }
-    };
-
-    VkAttachmentReference color_reference = {
-            /* attachment= */ 0,
-            /* layout= */ VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-    };
-
-    VkAttachmentReference depth_reference = {
-            /* attachment= */ 1,
-            /* layout= */ VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-    };
-
-    VkAttachmentReference color_resolve = {
-            /* attachment= */ 2,
-            /* layout= */ VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-    };
+    framebuffer_format.color_format = VK_FORMAT_R8G8B8A8_UNORM;
+    framebuffer_format.depth_format = depth_format;
+    framebuffer_format.stencil_format = is_stencil_format(depth_format) ? depth_format : VK_FORMAT_UNDEFINED;
 
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &color_reference;
-    subpass.pDepthStencilAttachment = &depth_reference;
-    subpass.pResolveAttachments = &color_resolve;
-
-    VkSubpassDependency subpass_dependency = {};
-    subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpass_dependency.dstSubpass = 0;
-    subpass_dependency.srcStageMask =  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    subpass_dependency.srcAccessMask = 0;
-    subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-    rd->create_render_pass(ARRAY_SIZE(attachments), attachments, 1, &subpass, 1, &subpass_dependency, &render_pass);
     RenderDevice::SamplerCreateInfo sampler_create_info;
     rd->create_sampler(&sampler_create_info, &sampler);
-    rd->allocate_cmd_buffer(&scene_cmd_buffer);
 
-    _create_scene_texture(width, height);
+    target_pool = memnew(RenderTargetPool, rd, VK_FORMAT_R8G8B8A8_UNORM, depth_format, sampler);
+    target = target_pool->acquire(width, height, depth_resolve);
 }
 
 void RenderingScene::set_scene_extent(uint32_t v_width, uint32_t v_height)
 {
-    width  = v_width;
-    height = v_height;
-}
-
-void RenderingScene::cmd_begin_scene_rendering(VkCommandBuffer *p_cmd_buffer)
-{
-    if (texture->width != width || texture->height != height) {
-        _clean_up_scene_texture();
-        _create_scene_texture(width, height);
+    v_width = std::max(v_width, 1u);
+    v_height = std::max(v_height, 1u);
+
+    if (v_width != requested_width || v_height != requested_height) {
+        requested_width = v_width;
+        requested_height = v_height;
+        stable_frames = 0;
+    } else if (stable_frames < RENDERING_SCENE_STABLE_FRAMES) {
+        stable_frames++;
     }
 
-    rd->cmd_buffer_begin(scene_cmd_buffer, VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+    // keep the current size class while the viewport is still being dragged, the
+    // rendered extent is clamped to it and the editor stretches the image.
+    uint32_t target_width = target->width;
+    uint32_t target_height = target->height;
+    if (stable_frames >= RENDERING_SCENE_STABLE_FRAMES) {
+        target_width = RenderTargetPool::get_size_class(requested_width);
+        target_height = RenderTargetPool::get_size_class(requested_height);
+    }
 
-    std::array<VkClearValue, 3> clear_values = {};
-    clear_values[0].color = { 0.1f, 0.1f, 0.1f, 1.0f };
-    clear_values[1].depthStencil = { 1.0f, 0 };
-    clear_values[2].color = { 0.1f, 0.1f, 0.1f, 1.0f };;
+    target = target_pool->acquire(target_width, target_height, depth_resolve);
 
-    VkRect2D rect = {};
-    rect.offset = { 0, 0 };
-    rect.extent = { texture->width, texture->height };
-    rd->cmd_begin_render_pass(scene_cmd_buffer, render_pass, std::size(clear_values), std::data(clear_values), framebuffer, &rect);
+    width = std::min(requested_width, target->width);
+    height = std::min(requested_height, target->height);
+}
 
-    *p_cmd_buffer = scene_cmd_buffer;
+void RenderingScene::enable_depth_resolve(bool is_enable)
+{
+    depth_resolve = is_enable;
 }
 
-void RenderingScene::cmd_end_scene_rendering()
+void RenderingScene::get_scene_msaa_create_info(RenderDevice::TextureCreateInfo *p_color, RenderDevice::TextureCreateInfo *p_depth)
 {
-    rd->cmd_end_render_pass(scene_cmd_buffer);
-    rd->cmd_buffer_end(scene_cmd_buffer);
-
-    // submit
-    rd->cmd_buffer_submit(scene_cmd_buffer,
-                          0, nullptr,
-                          0, nullptr,
-                          nullptr,
-                          graph_queue,
-                          nullptr);
+    // sized to the target and not the rendered extent, the graph keeps its transient
+    // memory while the viewport stays in one size class.
+    *p_color = {};
+    p_color->width = target->width;
+    p_color->height = target->height;
+    p_color->samples = rd->get_msaa_samples();
+    p_color->format = framebuffer_format.color_format;
+    p_color->aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
+    p_color->image_type = VK_IMAGE_TYPE_2D;
+    p_color->image_view_type = VK_IMAGE_VIEW_TYPE_2D;
+    p_color->usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+    *p_depth = *p_color;
+    p_depth->format = depth_format;
+    p_depth->aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    p_depth->usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
 }
 
-void RenderingScene::_create_scene_texture(uint32_t width, uint32_t height)
+void RenderingScene::cmd_begin_scene_rendering(VkCommandBuffer cmd_buffer, RenderDevice::Texture2D *v_msaa, RenderDevice::Texture2D *v_msaa_depth)
 {
-    RenderDevice::TextureCreateInfo texture_create_info = {};
-    texture_create_info.width = width;
-    texture_create_info.height = height;
-    texture_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-    texture_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
-    texture_create_info.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
-    texture_create_info.image_type = VK_IMAGE_TYPE_2D;
-    texture_create_info.image_view_type = VK_IMAGE_VIEW_TYPE_2D;
-    texture_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    texture = rd->create_texture(&texture_create_info);
-
-    texture_create_info.samples = rd->get_msaa_samples();
-    texture_create_info.format = depth_format;
-    texture_create_info.aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    texture_create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    depth = rd->create_texture(&texture_create_info);
-
-    texture_create_info.samples = rd->get_msaa_samples();
-    texture_create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
-    texture_create_info.aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;
-    texture_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    msaa = rd->create_texture(&texture_create_info);
-
-    rd->bind_texture_sampler(texture, sampler);
-    rd->bind_texture_sampler(depth, sampler);
-    rd->bind_texture_sampler(msaa, sampler);
-
-    VkCommandBuffer cmd_buffer;
-
-    rd->cmd_buffer_one_time_begin(&cmd_buffer);
-
-    RenderDevice::PipelineMemoryBarrier texture_barrier;
-    texture_barrier.image.texture = texture;
-    texture_barrier.image.old_image_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-    texture_barrier.image.new_image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    texture_barrier.image.src_access_mask = 0;
-    texture_barrier.image.dst_access_mask = VK_ACCESS_HOST_READ_BIT | VK_ACCESS_HOST_WRITE_BIT;
-    rd->cmd_pipeline_barrier(cmd_buffer, &texture_barrier);
-
-    rd->cmd_buffer_one_time_end(cmd_buffer);
-
-    VkImageView attachments[] = {
-            msaa->image_view,
-            depth->image_view,
-            texture->image_view,
+    VkRect2D rect = {};
+    rect.offset = { 0, 0 };
+    rect.extent = { width, height };
+
+    // the msaa contents are dropped once resolved and the depth is only resolved
+    // for the preview.
+    RenderDevice::RenderingAttachment color_attachment = {
+            /* image_view= */ v_msaa->image_view,
+            /* image_layout= */ VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            /* load_op= */ VK_ATTACHMENT_LOAD_OP_CLEAR,
+            /* store_op= */ VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            /* clear_value= */ { .color = { 0.1f, 0.1f, 0.1f, 1.0f } },
+            /* resolve_mode= */ VK_RESOLVE_MODE_AVERAGE_BIT,
+            /* resolve_image_view= */ target->texture->image_view,
+            /* resolve_image_layout= */ VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
     };
 
-    rd->create_framebuffer(texture->width, texture->height, ARRAY_SIZE(attachments), attachments, render_pass, &framebuffer);
-}
+    RenderDevice::RenderingAttachment depth_attachment = {
+            /* image_view= */ v_msaa_depth->image_view,
+            /* image_layout= */ VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            /* load_op= */ VK_ATTACHMENT_LOAD_OP_CLEAR,
+            /* store_op= */ VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            /* clear_value= */ { .depthStencil = { 1.0f, 0 } },
+    };
 
-void RenderingScene::_clean_up_scene_texture()
-{
-    rd->destroy_texture(msaa);
-    rd->destroy_texture(depth);
-    rd->destroy_texture(texture);
-    texture = VK_NULL_HANDLE;
-    rd->destroy_framebuffer(framebuffer);
-    framebuffer = VK_NULL_HANDLE;
-}
\ No newline at end of file
+    // sample zero is the one depth resolve mode every device has to support.
+    if (target->depth_resolve != NULL) {
+        depth_attachment.resolve_mode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+        depth_attachment.resolve_image_view = target->depth_resolve->image_view;
+        depth_attachment.resolve_image_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    }
+
+    bool stencil = framebuffer_format.stencil_format != VK_FORMAT_UNDEFINED;
+    rd->cmd_begin_rendering(cmd_buffer, &rect, 1, &color_attachment, &depth_attachment, stencil ? &depth_attachment : NULL, VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT);
+}
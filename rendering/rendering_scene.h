@@ -24,6 +24,11 @@
 #define _RENDERING_SCENE_H_
 
 #include "drivers/render_device.h"
+#include "render_target_pool.h"
+
+// frames a new viewport size has to stay unchanged before the scene switches to
+// another render target size class.
+#define RENDERING_SCENE_STABLE_FRAMES 4
 
 class RenderingScene {
 public:
@@ -32,34 +37,44 @@ public:
 
     void initialize();
 
+    // the scene renders into the top left sub-rectangle of a pooled target, the
+    // width and height are the rendered extent and may lag behind the requested
+    // extent while a resize settles.
     void set_scene_extent(uint32_t v_width, uint32_t v_height);
     uint32_t get_scene_width() { return width; }
     uint32_t get_scene_height() { return height; }
-    VkRenderPass get_render_pass() { return render_pass; }
-    RenderDevice::Texture2D *get_scene_texture() { return texture; }
-    RenderDevice::Texture2D *get_scene_depth() { return depth; }
+    // the scene pipelines are built against it.
+    RenderDevice::FramebufferFormat *get_framebuffer_format() { return &framebuffer_format; }
+    // the msaa attachments the scene renders into before resolving are transient
+    // textures of the render graph, sized to the current target.
+    void get_scene_msaa_create_info(RenderDevice::TextureCreateInfo *p_color, RenderDevice::TextureCreateInfo *p_depth);
+    RenderDevice::Texture2D *get_scene_texture() { return target->texture; }
+    // NULL while the depth resolve is disabled.
+    RenderDevice::Texture2D *get_scene_depth() { return target->depth_resolve; }
+    // resolves the msaa depth into a sampled texture, only needed for the depth preview.
+    void enable_depth_resolve(bool is_enable);
 
-    void cmd_begin_scene_rendering(VkCommandBuffer *p_cmd_buffer);
-    void cmd_end_scene_rendering();
+    // the scene contents are recorded into secondary command buffers and executed
+    // between begin and end.
+    void cmd_begin_scene_rendering(VkCommandBuffer cmd_buffer, RenderDevice::Texture2D *v_msaa, RenderDevice::Texture2D *v_msaa_depth);
+    void cmd_end_scene_rendering(VkCommandBuffer cmd_buffer);
 
 private:
-    void _create_scene_texture(uint32_t width, uint32_t height);
-    void _clean_up_scene_texture();
 
     RenderDevice *rd;
     RenderDeviceContext *rdc;
-    VkRenderPass render_pass;
-    RenderDevice::Texture2D *texture = NULL;
-    RenderDevice::Texture2D *depth = NULL;
-    RenderDevice::Texture2D *msaa = NULL;
-    VkFramebuffer framebuffer;
+    RenderDevice::FramebufferFormat framebuffer_format;
+    RenderTargetPool *target_pool = NULL;
+    RenderTargetPool::RenderTarget *target = NULL;
     VkSampler sampler;
-    VkCommandBuffer scene_cmd_buffer;
-    VkQueue graph_queue;
     VkFormat depth_format;
 
     uint32_t width = 32;
     uint32_t height = 32;
+    uint32_t requested_width = 32;
+    uint32_t requested_height = 32;
+    uint32_t stable_frames = 0;
+    bool depth_resolve = true;
 };
 
 #endif /* _RENDERING_SCENE_H_ */
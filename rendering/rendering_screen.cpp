@@ -21,6 +21,7 @@
 /*                                                                          */
 /* ======================================================================== */
 #include "rendering_screen.h"
+#include "drivers/barrier_builder.h"
 #include <algorithm>
 
 RenderingScreen::RenderingScreen(RenderDevice *p_render_device)
@@ -30,17 +31,16 @@ RenderingScreen::RenderingScreen(RenderDevice *p_render_device)
     vk_physical_device = rd->get_device_context()->get_physical_device();
     vk_device = rd->get_device_context()->get_device();
     vk_graph_queue_family = rd->get_device_context()->get_graph_queue_family();
-    vk_cmd_pool = rd->get_device_context()->get_cmd_pool();
     vk_graph_queue = rd->get_device_context()->get_graph_queue();
 }
 
 RenderingScreen::~RenderingScreen()
 {
+    // the image views have to go before their swap chain.
+    _clean_up_swap_chain();
+    rd->wait_idle();
     vkDestroySemaphore(vk_device, window->image_available_semaphore, allocation_callbacks);
-    vkDestroySemaphore(vk_device, window->render_finished_semaphore, allocation_callbacks);
     vkDestroySwapchainKHR(vk_device, window->swap_chain, allocation_callbacks);
-    vkDestroyRenderPass(vk_device, window->render_pass, allocation_callbacks);
-    _clean_up_swap_chain();
     vkDestroySurfaceKHR(vk_instance, window->vk_surface, allocation_callbacks);
     free(window);
 }
@@ -87,9 +87,6 @@ void RenderingScreen::initialize(Window *v_focused_window)
     err = vkCreateSemaphore(vk_device, &semaphore_create_info, allocation_callbacks, &window->image_available_semaphore);
     assert(!err);
 
-    err = vkCreateSemaphore(vk_device, &semaphore_create_info, allocation_callbacks, &window->render_finished_semaphore);
-    assert(!err);
-
     _create_swap_chain();
 }
 
@@ -98,9 +95,8 @@ void RenderingScreen::cmd_begin_screen_render(VkCommandBuffer *p_cmd_buffer)
     _update_swap_chain();
     vkAcquireNextImageKHR(vk_device, window->swap_chain, UINT64_MAX, window->image_available_semaphore, nullptr, &acquire_next_index);
 
-    VkCommandBuffer cmd_buffer;
-    cmd_buffer = window->swap_chain_resources[acquire_next_index].cmd_buffer;
-    rd->cmd_buffer_begin(cmd_buffer, VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+    VkCommandBuffer cmd_buffer = rd->allocate_frame_cmd_buffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    rd->cmd_buffer_begin(cmd_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
     VkClearValue clear_color = {
             0.10f, 0.10f, 0.10f, 1.0f
@@ -108,19 +104,35 @@ void RenderingScreen::cmd_begin_screen_render(VkCommandBuffer *p_cmd_buffer)
 
     VkRect2D rect = {};
     rect.extent = { window->width, window->height };
-    rd->cmd_begin_render_pass(cmd_buffer, window->render_pass, 1, &clear_color, window->swap_chain_resources[acquire_next_index].framebuffer, &rect);
+
+    _cmd_transition_swap_chain_image(cmd_buffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    RenderDevice::RenderingAttachment color_attachment = {
+            /* image_view= */ window->swap_chain_resources[acquire_next_index].image_view,
+            /* image_layout= */ VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            /* load_op= */ VK_ATTACHMENT_LOAD_OP_CLEAR,
+            /* store_op= */ VK_ATTACHMENT_STORE_OP_STORE,
+            /* clear_value= */ clear_color,
+    };
+
+    rd->cmd_begin_rendering(cmd_buffer, &rect, 1, &color_attachment, NULL, NULL);
 
     *p_cmd_buffer = cmd_buffer;
 }
 
 void RenderingScreen::cmd_end_screen_render(VkCommandBuffer cmd_buffer)
 {
-    rd->cmd_end_render_pass(cmd_buffer);
+    rd->cmd_end_rendering(cmd_buffer);
+    _cmd_transition_swap_chain_image(cmd_buffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
     rd->cmd_buffer_end(cmd_buffer);
 
+    VkSemaphore render_finished_semaphore = window->swap_chain_resources[acquire_next_index].render_finished_semaphore;
     VkPipelineStageFlags mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    rd->cmd_buffer_submit(cmd_buffer, 1, &window->image_available_semaphore, 1, &window->render_finished_semaphore, &mask, vk_graph_queue, VK_NULL_HANDLE);
-    rd->present(vk_graph_queue, window->swap_chain, acquire_next_index, window->render_finished_semaphore);
+    rd->enqueue_submission(cmd_buffer, 1, &window->image_available_semaphore, 1, &render_finished_semaphore, &mask, vk_graph_queue);
+    // everything recorded for the frame goes out before the present waits on it.
+    rd->flush_submissions();
+    rd->present(window->swap_chain, acquire_next_index, render_finished_semaphore);
 }
 
 void RenderingScreen::_create_swap_chain()
@@ -135,51 +147,6 @@ void RenderingScreen::_create_swap_chain()
     window->width = capabilities.currentExtent.width;
     window->height = capabilities.currentExtent.height;
 
-    if (!old_swap_chain) {
-        // attachment
-        VkAttachmentDescription color_attachment = {
-                /* flags */ no_flag_bits,
-                /* format */ window->format,
-                /* samples */ VK_SAMPLE_COUNT_1_BIT,
-                /* loadOp */VK_ATTACHMENT_LOAD_OP_CLEAR,
-                /* storeOp */ VK_ATTACHMENT_STORE_OP_STORE,
-                /* stencilLoadOp */ VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                /* stencilStoreOp */ VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                /* initialLayout */ VK_IMAGE_LAYOUT_UNDEFINED,
-                /* finalLayout */ VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        };
-
-        VkAttachmentReference color_attachment_reference = {};
-        color_attachment_reference.attachment = 0;
-        color_attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-        VkSubpassDescription subpass = {};
-        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass.colorAttachmentCount = 1;
-        subpass.pColorAttachments = &color_attachment_reference;
-
-        VkSubpassDependency subpass_dependency = {};
-        subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        subpass_dependency.dstSubpass = 0;
-        subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpass_dependency.srcAccessMask = 0;
-        subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-        // create render pass
-        VkRenderPassCreateInfo render_pass_create_info = {};
-        render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        render_pass_create_info.attachmentCount = 1;
-        render_pass_create_info.pAttachments = &color_attachment;
-        render_pass_create_info.subpassCount = 1;
-        render_pass_create_info.pSubpasses = &subpass;
-        render_pass_create_info.dependencyCount = 1;
-        render_pass_create_info.pDependencies = &subpass_dependency;
-
-        err = vkCreateRenderPass(vk_device, &render_pass_create_info, allocation_callbacks, &window->render_pass);
-        assert(!err);
-    }
-
     /* create swap chain */
     VkSwapchainCreateInfoKHR swap_chain_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -205,8 +172,12 @@ void RenderingScreen::_create_swap_chain()
     err = vkCreateSwapchainKHR(vk_device, &swap_chain_create_info, allocation_callbacks, &window->swap_chain);
     assert(!err);
 
-    if (old_swap_chain)
-        vkDestroySwapchainKHR(vk_device, old_swap_chain, allocation_callbacks);
+    // the old images may still be presented, retire the swap chain with the frame.
+    if (old_swap_chain) {
+        rd->defer_deletion([this, old_swap_chain] {
+            vkDestroySwapchainKHR(vk_device, old_swap_chain, allocation_callbacks);
+        });
+    }
 
     /* initialize swap chain resources */
     window->swap_chain_resources = (SwapchainResource *) imalloc(sizeof(SwapchainResource) * window->image_buffer_count);
@@ -219,15 +190,10 @@ void RenderingScreen::_create_swap_chain()
     for (uint32_t i = 0; i < window->image_buffer_count; i++) {
         window->swap_chain_resources[i].image = swap_chain_images[i];
 
-        VkCommandBufferAllocateInfo cmd_allocate_info = {
-                /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-                /* pNext */ nextptr,
-                /* commandPool */ vk_cmd_pool,
-                /* level */ VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-                /* commandBufferCount */ 1
-        };
-
-        vkAllocateCommandBuffers(vk_device, &cmd_allocate_info, &(window->swap_chain_resources[i].cmd_buffer));
+        VkSemaphoreCreateInfo semaphore_create_info = {};
+        semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        err = vkCreateSemaphore(vk_device, &semaphore_create_info, allocation_callbacks, &(window->swap_chain_resources[i].render_finished_semaphore));
+        assert(!err);
 
         VkImageViewCreateInfo image_view_create_info = {
                 /* sType */ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -255,32 +221,18 @@ void RenderingScreen::_create_swap_chain()
 
         err = vkCreateImageView(vk_device, &image_view_create_info, allocation_callbacks, &(window->swap_chain_resources[i].image_view));
         assert(!err);
-
-        VkImageView framebuffer_attachments[] = { window->swap_chain_resources[i].image_view };
-
-        VkFramebufferCreateInfo framebuffer_create_info = {
-                /* sType */ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-                /* pNext */ nextptr,
-                /* flags */ no_flag_bits,
-                /* renderPass */ window->render_pass,
-                /* attachmentCount */ ARRAY_SIZE(framebuffer_attachments),
-                /* pAttachments */ framebuffer_attachments,
-                /* width */ window->width,
-                /* height */ window->height,
-                /* layers */ 1,
-        };
-
-        err = vkCreateFramebuffer(vk_device, &framebuffer_create_info, allocation_callbacks, &(window->swap_chain_resources[i].framebuffer));
-        assert(!err);
     }
 }
 
 void RenderingScreen::_clean_up_swap_chain()
 {
+    // released once the frames that used them have retired, no device wait on resize.
     for (uint32_t i = 0; i < window->image_buffer_count; i++) {
-        vkFreeCommandBuffers(vk_device, vk_cmd_pool, 1, &window->swap_chain_resources[i].cmd_buffer);
-        vkDestroyFramebuffer(vk_device, window->swap_chain_resources[i].framebuffer, allocation_callbacks);
-        vkDestroyImageView(vk_device, window->swap_chain_resources[i].image_view, allocation_callbacks);
+        SwapchainResource resource = window->swap_chain_resources[i];
+        rd->defer_deletion([this, resource] {
+            vkDestroyImageView(vk_device, resource.image_view, allocation_callbacks);
+            vkDestroySemaphore(vk_device, resource.render_finished_semaphore, allocation_callbacks);
+        });
     }
 
     free(window->swap_chain_resources);
@@ -294,8 +246,23 @@ void RenderingScreen::_update_swap_chain()
 
     /* is update */
     if ((extent.width != window->width || extent.height != window->height) && (extent.width != 0 || extent.height != 0)) {
-        vkDeviceWaitIdle(vk_device);
         _clean_up_swap_chain();
         _create_swap_chain();
     }
 }
+
+// the semaphore wait of the submit covers the acquire at the color attachment
+// output stage, the transitions only have to order against that stage.
+void RenderingScreen::_cmd_transition_swap_chain_image(VkCommandBuffer cmd_buffer, VkImageLayout old_layout, VkImageLayout new_layout)
+{
+    bool present = new_layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    BarrierBuilder barriers;
+    barriers.external_image(window->swap_chain_resources[acquire_next_index].image,
+                            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+                            old_layout, new_layout,
+                            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, present ? VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_2_NONE,
+                            present ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            present ? VK_ACCESS_2_NONE : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+    barriers.flush(cmd_buffer);
+}
@@ -31,7 +31,7 @@ public:
     RenderingScreen(RenderDevice *p_render_device);
    ~RenderingScreen();
 
-    VkRenderPass get_render_pass() { return window->render_pass; }
+    VkFormat get_format() { return window->format; }
     uint32_t get_image_buffer_count() { return window->image_buffer_count; }
     Window *get_focused_window() { return focused_window; }
 
@@ -42,10 +42,10 @@ public:
 
 private:
     struct SwapchainResource {
-        VkCommandBuffer cmd_buffer;
         VkImage image;
         VkImageView image_view;
-        VkFramebuffer framebuffer;
+        // per image, the presentation engine may still wait on it when the next frame is submitted.
+        VkSemaphore render_finished_semaphore;
     };
 
     struct _Window {
@@ -55,11 +55,9 @@ private:
         uint32_t image_buffer_count;
         VkCompositeAlphaFlagBitsKHR composite_alpha;
         VkPresentModeKHR present_mode;
-        VkRenderPass render_pass = VK_NULL_HANDLE;
         VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
         SwapchainResource *swap_chain_resources;
         VkSemaphore image_available_semaphore;
-        VkSemaphore render_finished_semaphore;
         uint32_t width;
         uint32_t height;
     };
@@ -67,13 +65,13 @@ private:
     void _create_swap_chain();
     void _clean_up_swap_chain();
     void _update_swap_chain();
+    void _cmd_transition_swap_chain_image(VkCommandBuffer cmd_buffer, VkImageLayout old_layout, VkImageLayout new_layout);
 
     RenderDevice *rd = VK_NULL_HANDLE;
     VkInstance vk_instance = VK_NULL_HANDLE;
     VkPhysicalDevice vk_physical_device = VK_NULL_HANDLE;
     VkDevice vk_device = VK_NULL_HANDLE;
     uint32_t vk_graph_queue_family = 0;
-    VkCommandPool vk_cmd_pool = VK_NULL_HANDLE;
     _Window *window = VK_NULL_HANDLE;
     VkQueue vk_graph_queue = VK_NULL_HANDLE;
     Window *focused_window = VK_NULL_HANDLE;
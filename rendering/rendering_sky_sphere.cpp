@@ -21,10 +21,7 @@
 /*                                                                          */
 /* ======================================================================== */
 #include "rendering_sky_sphere.h"
-#include <stb/stb_image.h>
-#include "modules/obj.h"
 #include <bright/debugger.h>
-#include <stb/stb_image.h>
 
 RenderingSkySphere::RenderingSkySphere(RenderDevice* v_rd, SceneRenderData* v_render_data)
     : rd(v_rd), render_data(v_render_data)
@@ -41,57 +38,24 @@ RenderingSkySphere::RenderingSkySphere(RenderDevice* v_rd, SceneRenderData* v_re
 
 RenderingSkySphere::~RenderingSkySphere()
 {
-    rd->destroy_texture(hdr);
     rd->destroy_sampler(hdr_sampler);
-    rd->destroy_buffer(index_buffer);
-    rd->destroy_buffer(vertex_buffer);
     rd->free_descriptor_set(descriptor_set);
     rd->destroy_descriptor_set_layout(descriptor_set_layout);
     rd->destroy_pipeline(pipeline);
 }
 
-void RenderingSkySphere::initialize(VkRenderPass v_render_pass)
+void RenderingSkySphere::initialize(RenderDevice::FramebufferFormat *p_framebuffer_format)
 {
-    // obj
-    ObjLoader *loader = ObjLoader::load(_CURDIR("resource/obj/sphere.obj"));
-    std::vector<ObjLoader::Vertex> vertices = loader->get_vertices();
-    std::vector<uint32_t> indices = loader->get_indices();
-
-    size_t vertices_size = std::size(vertices) * sizeof(ObjLoader::Vertex);
-    vertex_buffer = rd->create_buffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices_size);
-    rd->write_buffer(vertex_buffer, 0, vertices_size, std::data(vertices));
-
-    index_count = std::size(indices);
-    size_t indices_size = index_count * sizeof(uint32_t);
-    index_buffer = rd->create_buffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices_size);
-    rd->write_buffer(index_buffer, 0, indices_size, std::data(indices));
-
-    ObjLoader::destroy(loader);
-
-    // hdr
-    int width, height, channels;
-    float* pixels = stbi_loadf(_CURDIR("resource/hdr/puresky_2k.hdr"), &width, &height, &channels, STBI_rgb_alpha);
-
-    RenderDevice::TextureCreateInfo texture_create_info = {
-        /* width= */ (uint32_t) width,
-        /* height= */ (uint32_t) height,
-        /* samples= */ VK_SAMPLE_COUNT_1_BIT,
-        /* format= */ VK_FORMAT_R32G32B32A32_SFLOAT,
-        /* aspect_mask= */ VK_IMAGE_ASPECT_COLOR_BIT,
-        /* image_type= */ VK_IMAGE_TYPE_2D,
-        /* image_view_type= */ VK_IMAGE_VIEW_TYPE_2D,
-        /* usage= */ VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-    };
+    // loaded in background, the sphere is not drawn until the mesh is resident.
+    mesh = AssetLoader::load_mesh(_CURDIR("resource/obj/sphere.obj"));
 
-    hdr = rd->create_texture(&texture_create_info);
     RenderDevice::SamplerCreateInfo sampler_create_info = {};
     sampler_create_info.u = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     sampler_create_info.v = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     sampler_create_info.w = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     sampler_create_info.border_color = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    sampler_create_info.max_anisotropy = 16.0f;
     rd->create_sampler(&sampler_create_info, &hdr_sampler);
-    rd->bind_texture_sampler(hdr, hdr_sampler);
-    rd->write_texture(hdr, width * height * 16, pixels);
 
     // pipeline
     VkVertexInputBindingDescription binds[] = {
@@ -107,13 +71,16 @@ void RenderingSkySphere::initialize(VkRenderPass v_render_pass)
     VkDescriptorSetLayoutBinding desciprotr_layout_binds[] = {
         SceneRenderData::GetPerspectiveDescriptorBindZero(),
         SceneRenderData::GetLightDescriptorBindOne(),
-        { 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, VK_NULL_HANDLE },
     };
 
     rd->create_descriptor_set_layout(ARRAY_SIZE(desciprotr_layout_binds), desciprotr_layout_binds, &descriptor_set_layout);
     rd->allocate_descriptor_set(descriptor_set_layout, &descriptor_set);
     render_data->set_descriptor_buffers(descriptor_set);
-    rd->update_descriptor_set_image(hdr, 2, descriptor_set);
+
+    // the hdr is sampled from the bindless table, the placeholder until it is resident.
+    hdr = AssetLoader::load_texture(_CURDIR("resource/hdr/puresky_2k.hdr"), [this](RenderDevice::Texture2D *texture) {
+        rd->bind_texture_sampler(texture, hdr_sampler);
+    });
 
     VkPushConstantRange range = {
         /* stageFlags= */ VK_SHADER_STAGE_VERTEX_BIT,
@@ -121,6 +88,11 @@ void RenderingSkySphere::initialize(VkRenderPass v_render_pass)
         /* size= */ sizeof(PushConst)
     };
 
+    VkDescriptorSetLayout descriptor_set_layouts[] = {
+        descriptor_set_layout,
+        rd->get_bindless_descriptor_set_layout(), /* RENDER_DEVICE_BINDLESS_SET */
+    };
+
     RenderDevice::ShaderInfo shader_info = {
         /* vertex= */ "sky_sphere",
         /* fragment= */ "sky_sphere",
@@ -128,14 +100,14 @@ void RenderingSkySphere::initialize(VkRenderPass v_render_pass)
         /* attributes= */ attributes,
         /* bind_count= */ ARRAY_SIZE(binds),
         /* binds= */ binds,
-        /* descriptor_set_layout_count= */ 1,
-        /* p_descriptor_set_layouts= */ &descriptor_set_layout,
+        /* descriptor_set_layout_count= */ ARRAY_SIZE(descriptor_set_layouts),
+        /* p_descriptor_set_layouts= */ descriptor_set_layouts,
         /* push_const_count= */ 1,
         /* p_push_const_range= */ &range,
     };
 
     RenderDevice::PipelineCreateInfo create_info = {
-        /* render_pass= */ v_render_pass,
+        /* framebuffer_format= */ *p_framebuffer_format,
         /* polygon= */ VK_POLYGON_MODE_FILL,
         /* topology= */ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
         /* cull_mode= */ VK_CULL_MODE_NONE,
@@ -147,9 +119,14 @@ void RenderingSkySphere::initialize(VkRenderPass v_render_pass)
 
 void RenderingSkySphere::cmd_draw_sky_sphere(VkCommandBuffer cmd_buffer)
 {
+    const AssetLoader::Mesh *resident = AssetLoader::get_mesh(mesh);
+    if (!resident)
+        return;
+
     rd->cmd_bind_pipeline(cmd_buffer, pipeline);
     rd->cmd_setval_viewport(cmd_buffer, render_data->get_scene_width(), render_data->get_scene_height());
     rd->cmd_bind_descriptor_set(cmd_buffer, pipeline, descriptor_set);
+    rd->cmd_bind_bindless_descriptor_set(cmd_buffer, pipeline);
 
     mat4 mat(1.0f);
 
@@ -170,13 +147,14 @@ void RenderingSkySphere::cmd_draw_sky_sphere(VkCommandBuffer cmd_buffer)
         /* transform= */ mat,
         /* exposure= */ exposure,
         /* gamma= */ gamma,
+        /* texture_index= */ rd->get_bindless_texture_index(AssetLoader::get_texture(hdr)),
     };
 
     rd->cmd_push_const(cmd_buffer, pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConst), &push_const);
 
-    rd->cmd_bind_vertex_buffer(cmd_buffer, vertex_buffer);
-    rd->cmd_bind_index_buffer(cmd_buffer, VK_INDEX_TYPE_UINT32, index_buffer);
-    rd->cmd_draw_indexed(cmd_buffer, index_count);
+    rd->cmd_bind_vertex_buffer(cmd_buffer, resident->vertex_buffer);
+    rd->cmd_bind_index_buffer(cmd_buffer, VK_INDEX_TYPE_UINT32, resident->index_buffer);
+    rd->cmd_draw_indexed(cmd_buffer, resident->index_count);
 }
 
 
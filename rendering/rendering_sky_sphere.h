@@ -25,6 +25,7 @@
 
 #include "drivers/render_device.h"
 #include "scene_render_data.h"
+#include "asset_loader.h"
 #include <bright/properties.h>
 
 class RenderingSkySphere : public NodeProperties {
@@ -32,7 +33,7 @@ public:
     U_MEMNEW_ONLY RenderingSkySphere(RenderDevice* v_rd, SceneRenderData* v_render_data);
    ~RenderingSkySphere();
 
-    void initialize(VkRenderPass v_render_pass);
+    void initialize(RenderDevice::FramebufferFormat *p_framebuffer_format);
     void cmd_draw_sky_sphere(VkCommandBuffer cmd_buffer);
 
 private:
@@ -46,6 +47,7 @@ private:
         mat4 transform;
         float exposure;
         float gamma;
+        uint32_t texture_index;
     };
 
     RenderDevice* rd;
@@ -54,11 +56,9 @@ private:
     RenderDevice::Pipeline* pipeline;
     VkDescriptorSetLayout descriptor_set_layout;
     VkDescriptorSet descriptor_set;
-    RenderDevice::Texture2D* hdr;
+    AssetLoader::TextureHandle hdr;
     VkSampler hdr_sampler;
-    RenderDevice::Buffer* vertex_buffer;
-    RenderDevice::Buffer* index_buffer;
-    uint32_t index_count;
+    AssetLoader::MeshHandle mesh;
 
     float exposure = 0.5f;
     float gamma = 2.02f;
@@ -0,0 +1,32 @@
+/* ======================================================================== */
+/* bindless.h                                                               */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#extension GL_EXT_nonuniform_qualifier : require
+
+// the bindless table, see drivers/bindless_table.h. resources are addressed by
+// the indices RenderDevice hands out, indices that differ within a draw need
+// to be wrapped in nonuniformEXT.
+layout(set = 1, binding = 0) uniform sampler2D bindless_textures[];
+
+layout(std430, set = 1, binding = 1) readonly buffer BindlessBuffer {
+    uint words[];
+} bindless_buffers[];
@@ -37,6 +37,10 @@ goto :eof
 glslc -fshader-stage=frag ./%1.frag -o ./%1.frag.spv
 goto :eof
 
+:makecomp
+glslc -fshader-stage=comp ./%1.comp -o ./%1.comp.spv
+goto :eof
+
 :makeall
 call :makevert %1
 call :makefrag %1
@@ -23,6 +23,7 @@
 #version 450
 #extension GL_GOOGLE_include_directive : enable
 
+#include "bindless.h"
 #include "light.h"
 
 layout(location = 0) in vec2 texcoord;
@@ -31,13 +32,12 @@ layout(location = 2) in vec3 world_position;
 layout(location = 3) in vec3 camera_position;
 layout(location = 4) in float exposure;
 layout(location = 5) in float gamma;
+layout(location = 6) flat in uint texture_index;
 
 layout(set = 0, binding = 1) uniform DescriptorSetBlock {
     DirectionalLight light;
 };
 
-layout(set = 0, binding = 2) uniform sampler2D hdr;
-
 // outf
 layout(location = 0) out vec4 final_color;
 
@@ -47,7 +47,7 @@ void main()
     // vec4 tex = texture(hdr, texcoord);
     // final_color = vec4(light * tex.rgb, tex.a);
 
-    vec3 hdr_color = texture(hdr, texcoord).rgb;
+    vec3 hdr_color = texture(bindless_textures[texture_index], texcoord).rgb;
     vec3 color = hdr_color * exposure;
     vec3 gamma_corrected = pow(color, vec3(1.0f / gamma));
 
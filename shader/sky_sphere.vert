@@ -36,6 +36,7 @@ layout(push_constant) uniform PushConst {
     mat4 model;
     float exposure;
     float gamma;
+    uint texture_index;
 } push_const;
 
 // out
@@ -45,6 +46,7 @@ layout(location = 2) out vec3 v_world_position;
 layout(location = 3) out vec3 v_camera_position;
 layout(location = 4) out float v_exposure;
 layout(location = 5) out float v_gamma;
+layout(location = 6) flat out uint v_texture_index;
 
 void main()
 {
@@ -56,4 +58,5 @@ void main()
     v_camera_position = scene.camera_pos.xyz;
     v_exposure = push_const.exposure;
     v_gamma = push_const.gamma;
+    v_texture_index = push_const.texture_index;
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+/* ======================================================================== */
+/* test.h                                                                   */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, e1ither express or implied */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <bright/error.h>
+#include <math.h>
+
+#define TEST_CHECK(cond) \
+    EXIT_FAIL_COND_V(cond, "-test failed: %s:%d: %s\n", __FILE__, __LINE__, #cond)
+
+#define TEST_CHECK_NEAR(a, b, eps) \
+    TEST_CHECK(fabs((double) (a) - (double) (b)) <= (eps))
+
+#endif /* _TEST_H_ */
@@ -0,0 +1,281 @@
+/* ======================================================================== */
+/* test_bc.cpp                                                              */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, e1ither express or implied */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "test.h"
+#include "tools/texcompress/bc_encoder.h"
+#include "modules/hdr.h"
+#include <algorithm>
+#include <stdlib.h>
+
+// reference decoders of the block layouts the encoders emit, written from the
+// format specification rather than from the encoders.
+
+static const int weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const int weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct _BitReader {
+    const uint8_t *src;
+    int pos = 0;
+
+    uint32_t read(int bits)
+      {
+        uint32_t value = 0;
+        for (int i = 0; i < bits; i++, pos++)
+            value |= (uint32_t) ((src[pos >> 3] >> (pos & 7)) & 1) << i;
+        return value;
+      }
+};
+
+static void _decode_bc1(const uint8_t *block, uint8_t *rgba)
+{
+    uint16_t c[2] = { (uint16_t) (block[0] | block[1] << 8), (uint16_t) (block[2] | block[3] << 8) };
+
+    int palette[4][4];
+    for (int e = 0; e < 2; e++) {
+        int r = (c[e] >> 11) & 31, g = (c[e] >> 5) & 63, b = c[e] & 31;
+        palette[e][0] = (r << 3) | (r >> 2);
+        palette[e][1] = (g << 2) | (g >> 4);
+        palette[e][2] = (b << 3) | (b >> 2);
+        palette[e][3] = 255;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        if (c[0] > c[1]) {
+            palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+            palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+        } else {
+            palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+            palette[3][k] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = c[0] > c[1] ? 255 : 0;
+
+    uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t) block[7] << 24;
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < 4; k++)
+            rgba[i * 4 + k] = (uint8_t) palette[(indices >> (i * 2)) & 3][k];
+    }
+}
+
+static void _decode_bc4(const uint8_t *block, uint8_t *values)
+{
+    int palette[8] = { block[0], block[1] };
+    for (int p = 2; p < 8; p++) {
+        if (block[0] > block[1])
+            palette[p] = ((8 - p) * block[0] + (p - 1) * block[1]) / 7;
+        else
+            palette[p] = p < 6 ? ((6 - p) * block[0] + (p - 1) * block[1]) / 5 : (p == 6 ? 0 : 255);
+    }
+
+    _BitReader reader = { block + 2 };
+    for (int i = 0; i < 16; i++)
+        values[i] = (uint8_t) palette[reader.read(3)];
+}
+
+static void _decode_bc7_mode6(const uint8_t *block, uint8_t *rgba)
+{
+    _BitReader reader = { block };
+    TEST_CHECK(reader.read(7) == 0x40);
+
+    int endpoints[2][4];
+    for (int k = 0; k < 4; k++) {
+        endpoints[0][k] = (int) reader.read(7);
+        endpoints[1][k] = (int) reader.read(7);
+    }
+    for (int e = 0; e < 2; e++) {
+        int p = (int) reader.read(1);
+        for (int k = 0; k < 4; k++)
+            endpoints[e][k] = endpoints[e][k] << 1 | p;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        int w = weights4[reader.read(i == 0 ? 3 : 4)];
+        for (int k = 0; k < 4; k++)
+            rgba[i * 4 + k] = (uint8_t) (((64 - w) * endpoints[0][k] + w * endpoints[1][k] + 32) >> 6);
+    }
+}
+
+static int _bc6h_unquantize(int value)
+{
+    if (value == 0)
+        return 0;
+    if (value == 1023)
+        return 0xFFFF;
+    return ((value << 16) + 0x8000) >> 10;
+}
+
+static float _half_to_float(int half)
+{
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    return exponent ? ldexpf((float) (mantissa | 0x400), exponent - 25) : ldexpf((float) mantissa, -24);
+}
+
+static void _decode_bc6h_mode11(const uint8_t *block, float *rgb)
+{
+    _BitReader reader = { block };
+    TEST_CHECK(reader.read(5) == 0x03);
+
+    int endpoints[2][3];
+    for (int e = 0; e < 2; e++) {
+        for (int k = 0; k < 3; k++)
+            endpoints[e][k] = _bc6h_unquantize((int) reader.read(10));
+    }
+
+    for (int i = 0; i < 16; i++) {
+        int w = weights4[reader.read(i == 0 ? 3 : 4)];
+        for (int k = 0; k < 3; k++)
+            rgb[i * 3 + k] = _half_to_float((((64 - w) * endpoints[0][k] + w * endpoints[1][k] + 32) >> 6) * 31 >> 6);
+    }
+}
+
+// colors along one line, which a single pair of end points can follow.
+static void _gradient_block(uint8_t *rgba)
+{
+    for (int i = 0; i < 16; i++) {
+        rgba[i * 4 + 0] = (uint8_t) (10 + i * 15);
+        rgba[i * 4 + 1] = (uint8_t) (5 + i * 8);
+        rgba[i * 4 + 2] = (uint8_t) (250 - i * 12);
+        rgba[i * 4 + 3] = (uint8_t) (i * 17);
+    }
+}
+
+static int _max_error(const uint8_t *a, const uint8_t *b, int channels)
+{
+    int error = 0;
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < channels; k++)
+            error = std::max(error, abs(a[i * 4 + k] - b[i * 4 + k]));
+    }
+    return error;
+}
+
+static void test_bc1()
+{
+    uint8_t rgba[64], decoded[64], block[8];
+
+    // a solid block is off by the 565 rounding at most.
+    for (int i = 0; i < 16; i++) {
+        rgba[i * 4 + 0] = 200;
+        rgba[i * 4 + 1] = 100;
+        rgba[i * 4 + 2] = 50;
+        rgba[i * 4 + 3] = 255;
+    }
+    bc1_encode_block(rgba, block);
+    _decode_bc1(block, decoded);
+    TEST_CHECK(_max_error(rgba, decoded, 3) <= 4);
+    TEST_CHECK(_max_error(rgba, decoded, 4) <= 4); /* never the transparent mode */
+
+    // four colors for sixteen texels.
+    _gradient_block(rgba);
+    bc1_encode_block(rgba, block);
+    _decode_bc1(block, decoded);
+    TEST_CHECK(_max_error(rgba, decoded, 3) <= 28);
+}
+
+static void test_bc4()
+{
+    uint8_t rgba[64], values[16], block[8];
+    _gradient_block(rgba);
+
+    // eight values between the end points, every texel is within half a step.
+    for (int channel = 0; channel < 4; channel++) {
+        int range = abs(rgba[15 * 4 + channel] - rgba[channel]);
+        bc4_encode_block(rgba, channel, block);
+        _decode_bc4(block, values);
+        for (int i = 0; i < 16; i++)
+            TEST_CHECK(abs(values[i] - rgba[i * 4 + channel]) <= range / 14 + 1);
+    }
+
+    // the end points are exact.
+    bc4_encode_block(rgba, 1, block);
+    _decode_bc4(block, values);
+    TEST_CHECK(values[0] == 5 && values[15] == 125);
+}
+
+static void test_bc7()
+{
+    uint8_t rgba[64], decoded[64], block[16];
+
+    for (int i = 0; i < 16; i++) {
+        rgba[i * 4 + 0] = 255;
+        rgba[i * 4 + 1] = 0;
+        rgba[i * 4 + 2] = 127;
+        rgba[i * 4 + 3] = 64;
+    }
+    bc7_encode_block(rgba, block);
+    _decode_bc7_mode6(block, decoded);
+    TEST_CHECK(_max_error(rgba, decoded, 4) <= 1);
+
+    // sixteen steps for sixteen texels, alpha included.
+    _gradient_block(rgba);
+    bc7_encode_block(rgba, block);
+    _decode_bc7_mode6(block, decoded);
+    TEST_CHECK(_max_error(rgba, decoded, 4) <= 8);
+}
+
+static void test_bc6h()
+{
+    float rgba[64], decoded[48];
+    uint8_t block[16];
+
+    // a solid block only loses the 10 bit end point precision, negative values
+    // are clamped to zero.
+    for (int i = 0; i < 16; i++) {
+        rgba[i * 4 + 0] = -1.0f;
+        rgba[i * 4 + 1] = 0.5f;
+        rgba[i * 4 + 2] = 100.0f;
+        rgba[i * 4 + 3] = 1.0f;
+    }
+
+    bc6h_encode_block(rgba, block);
+    _decode_bc6h_mode11(block, decoded);
+    for (int i = 0; i < 16; i++) {
+        TEST_CHECK(fabsf(decoded[i * 3 + 0]) <= 0.001f);
+        TEST_CHECK(fabsf(decoded[i * 3 + 1] - 0.5f) <= 0.5f * 0.05f);
+        TEST_CHECK(fabsf(decoded[i * 3 + 2] - 100.0f) <= 100.0f * 0.05f);
+    }
+
+    // a few stops of red, sixteen indices spread over the half bits.
+    for (int i = 0; i < 16; i++) {
+        rgba[i * 4 + 0] = 0.25f + i * 0.5f;
+        rgba[i * 4 + 1] = 1.0f;
+        rgba[i * 4 + 2] = 2.0f;
+    }
+
+    bc6h_encode_block(rgba, block);
+    _decode_bc6h_mode11(block, decoded);
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < 3; k++)
+            TEST_CHECK(fabsf(decoded[i * 3 + k] - rgba[i * 4 + k]) <= 0.15f * std::max(rgba[i * 4 + k], 0.5f));
+    }
+}
+
+int main()
+{
+    test_bc1();
+    test_bc4();
+    test_bc7();
+    test_bc6h();
+    return 0;
+}
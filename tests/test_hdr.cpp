@@ -0,0 +1,190 @@
+/* ======================================================================== */
+/* test_hdr.cpp                                                             */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, e1ither express or implied */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "test.h"
+#include "modules/hdr.h"
+#include <string.h>
+
+// not a multiple of 8, so the vector loop and the scalar tail both run.
+#define TEST_HDR_TEXEL_COUNT 1001
+
+static uint32_t _random_state = 0x12345678;
+
+static uint32_t _random()
+{
+    _random_state = _random_state * 1664525 + 1013904223;
+    return _random_state >> 8;
+}
+
+// random sign and magnitude between 2^-20 and 2^17, beyond the half range.
+static float _random_float()
+{
+    float value = ldexpf((float) (_random() & 0xFFFF) / 65536.0f + 1.0f, (int) (_random() % 38) - 20);
+    return (_random() & 1) ? -value : value;
+}
+
+static float _half_to_float(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    float value = exponent ? ldexpf((float) (mantissa | 0x400), exponent - 25) : ldexpf((float) mantissa, -24);
+    return (half & 0x8000) ? -value : value;
+}
+
+// a single texel never reaches the vector loop, two texels of rgba16f fill it.
+static void _pack_half(float value, uint16_t *p_single, uint16_t *p_batch)
+{
+    float src[8];
+    uint16_t dst[8];
+    for (float &texel: src)
+        texel = value;
+
+    hdr_pack_rgba16f(src, dst, 1);
+    *p_single = dst[0];
+    hdr_pack_rgba16f(src, dst, 2);
+    *p_batch = dst[7];
+}
+
+static void test_rgba16f_values()
+{
+    struct { float value; uint16_t half; } cases[] = {
+        { 0.0f, 0x0000 },
+        { -0.0f, 0x8000 },
+        { 1.0f, 0x3C00 },
+        { -2.0f, 0xC000 },
+        { 0.5f, 0x3800 },
+        { 65504.0f, 0x7BFF },
+        { 65520.0f, 0x7C00 }, /* rounds up to inf */
+        { 1.0e6f, 0x7C00 },
+        { -INFINITY, 0xFC00 },
+        { ldexpf(1.0f, -24), 0x0001 }, /* smallest subnormal */
+        { ldexpf(1.0f, -14), 0x0400 }, /* smallest normal */
+        { 1.0f + ldexpf(1.0f, -11), 0x3C00 }, /* tie to even */
+        { 1.0f + ldexpf(3.0f, -11), 0x3C02 },
+    };
+
+    for (const auto &c: cases) {
+        uint16_t single, batch;
+        _pack_half(c.value, &single, &batch);
+        TEST_CHECK(single == c.half);
+        TEST_CHECK(batch == c.half);
+    }
+
+    uint16_t single, batch;
+    _pack_half(NAN, &single, &batch);
+    TEST_CHECK((single & 0x7C00) == 0x7C00 && (single & 0x03FF) != 0);
+    TEST_CHECK((batch & 0x7C00) == 0x7C00 && (batch & 0x03FF) != 0);
+}
+
+static void test_rgba16f_random()
+{
+    std::vector<float> src(TEST_HDR_TEXEL_COUNT * 4);
+    for (float &value: src)
+        value = _random_float();
+
+    std::vector<uint16_t> batch(src.size());
+    hdr_pack_rgba16f(src.data(), batch.data(), TEST_HDR_TEXEL_COUNT);
+
+    for (size_t i = 0; i < TEST_HDR_TEXEL_COUNT; i++) {
+        uint16_t single[4];
+        hdr_pack_rgba16f(&src[i * 4], single, 1);
+        TEST_CHECK(!memcmp(single, &batch[i * 4], sizeof(single)));
+    }
+
+    // normal halves keep 11 significant bits.
+    for (size_t i = 0; i < src.size(); i++) {
+        float magnitude = fabsf(src[i]);
+        if (magnitude < ldexpf(1.0f, -14) || magnitude > 65504.0f)
+            continue;
+        TEST_CHECK(fabsf(_half_to_float(batch[i]) - src[i]) <= magnitude * ldexpf(1.0f, -11));
+    }
+}
+
+static void _decode_rgb9e5(uint32_t packed, float *p_rgb)
+{
+    float scale = ldexpf(1.0f, (int) (packed >> 27) - 15 - 9);
+    p_rgb[0] = (float) (packed & 0x1FF) * scale;
+    p_rgb[1] = (float) ((packed >> 9) & 0x1FF) * scale;
+    p_rgb[2] = (float) ((packed >> 18) & 0x1FF) * scale;
+}
+
+static void test_rgb9e5_values()
+{
+    struct { float r, g, b; uint32_t packed; } cases[] = {
+        { 0.0f, 0.0f, 0.0f, 0x00000000 },
+        { 1.0f, 1.0f, 1.0f, 256u | (256u << 9) | (256u << 18) | (16u << 27) },
+        { 65408.0f, 65408.0f, 65408.0f, 0xFFFFFFFF }, /* largest value */
+        { INFINITY, 1.0e9f, 70000.0f, 0xFFFFFFFF },
+        { -1.0f, NAN, 0.0f, 0x00000000 },
+    };
+
+    for (const auto &c: cases) {
+        float src[32];
+        uint32_t dst[8];
+        for (uint32_t i = 0; i < 8; i++) {
+            src[i * 4 + 0] = c.r;
+            src[i * 4 + 1] = c.g;
+            src[i * 4 + 2] = c.b;
+            src[i * 4 + 3] = 1.0f;
+        }
+
+        hdr_pack_rgb9e5(src, dst, 1);
+        TEST_CHECK(dst[0] == c.packed);
+        hdr_pack_rgb9e5(src, dst, 8);
+        for (uint32_t packed: dst)
+            TEST_CHECK(packed == c.packed);
+    }
+}
+
+static void test_rgb9e5_random()
+{
+    std::vector<float> src(TEST_HDR_TEXEL_COUNT * 4);
+    for (float &value: src)
+        value = _random_float();
+
+    std::vector<uint32_t> batch(TEST_HDR_TEXEL_COUNT);
+    hdr_pack_rgb9e5(src.data(), batch.data(), TEST_HDR_TEXEL_COUNT);
+
+    for (size_t i = 0; i < TEST_HDR_TEXEL_COUNT; i++) {
+        uint32_t single;
+        hdr_pack_rgb9e5(&src[i * 4], &single, 1);
+        TEST_CHECK(single == batch[i]);
+
+        // the channels share the exponent, every one is within half a step of it.
+        float rgb[3];
+        _decode_rgb9e5(batch[i], rgb);
+        float step = ldexpf(1.0f, (int) (batch[i] >> 27) - 15 - 9);
+        for (uint32_t k = 0; k < 3; k++) {
+            float expected = fminf(fmaxf(src[i * 4 + k], 0.0f), 65408.0f);
+            TEST_CHECK(fabsf(rgb[k] - expected) <= step * 0.5f);
+        }
+    }
+}
+
+int main()
+{
+    test_rgba16f_values();
+    test_rgba16f_random();
+    test_rgb9e5_values();
+    test_rgb9e5_random();
+    return 0;
+}
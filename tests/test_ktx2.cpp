@@ -0,0 +1,143 @@
+/* ======================================================================== */
+/* test_ktx2.cpp                                                            */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, e1ither express or implied */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "test.h"
+#include "modules/ktx2.h"
+#include <algorithm>
+#include <string.h>
+
+static const uint8_t ktx2_identifier[KTX2_IDENTIFIER_SIZE] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// every level filled with its own byte pattern.
+static Ktx2Image::WriteInfo _write_info(VkFormat format, uint32_t width, uint32_t height, uint32_t layers, uint32_t level_count)
+{
+    Ktx2FormatInfo info;
+    TEST_CHECK(ktx2_get_format_info(format, &info));
+
+    Ktx2Image::WriteInfo write_info = {};
+    write_info.format = format;
+    write_info.width = width;
+    write_info.height = height;
+    write_info.layers = layers;
+
+    for (uint32_t level = 0; level < level_count; level++) {
+        uint32_t blocks_x = (std::max(width >> level, 1u) + info.block_width - 1) / info.block_width;
+        uint32_t blocks_y = (std::max(height >> level, 1u) + info.block_height - 1) / info.block_height;
+        std::vector<char> data((size_t) blocks_x * blocks_y * info.block_size * std::max(layers, 1u));
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = (char) (i * 7 + level * 31);
+        write_info.levels.push_back(std::move(data));
+    }
+
+    return write_info;
+}
+
+static void _check_round_trip(const char *path, const Ktx2Image::WriteInfo &write_info)
+{
+    TEST_CHECK(Ktx2Image::save(path, &write_info) == OK);
+
+    Ktx2Image *image = Ktx2Image::load(path);
+    TEST_CHECK(image != NULL);
+    TEST_CHECK(!memcmp(image->get_data(), ktx2_identifier, KTX2_IDENTIFIER_SIZE));
+    TEST_CHECK(image->get_format() == write_info.format);
+    TEST_CHECK(image->get_width() == write_info.width);
+    TEST_CHECK(image->get_height() == write_info.height);
+    TEST_CHECK(image->get_layers() == std::max(write_info.layers, 1u));
+    TEST_CHECK(image->get_mip_levels() == write_info.levels.size());
+
+    Ktx2FormatInfo info;
+    ktx2_get_format_info(write_info.format, &info);
+
+    for (uint32_t level = 0; level < image->get_mip_levels(); level++) {
+        const Ktx2Image::Level *p_level = image->get_level(level);
+        TEST_CHECK(p_level->byte_offset % info.block_size == 0);
+        TEST_CHECK(p_level->byte_length == write_info.levels[level].size());
+        TEST_CHECK(!memcmp(image->get_data() + p_level->byte_offset, write_info.levels[level].data(), p_level->byte_length));
+    }
+
+    Ktx2Image::destroy(image);
+}
+
+static void test_round_trip()
+{
+    // partial blocks at the edges, an array and the full mip chain.
+    _check_round_trip("test_bc7.ktx2", _write_info(VK_FORMAT_BC7_UNORM_BLOCK, 10, 6, 2, 4));
+    _check_round_trip("test_bc1.ktx2", _write_info(VK_FORMAT_BC1_RGB_UNORM_BLOCK, 16, 16, 1, 5));
+    _check_round_trip("test_rgba8.ktx2", _write_info(VK_FORMAT_R8G8B8A8_UNORM, 3, 3, 1, 1));
+}
+
+static void test_invalid()
+{
+    // level sizes have to match the format.
+    Ktx2Image::WriteInfo write_info = _write_info(VK_FORMAT_BC7_UNORM_BLOCK, 8, 8, 1, 1);
+    write_info.levels[0].pop_back();
+    TEST_CHECK(Ktx2Image::save("test_invalid.ktx2", &write_info) == FAIL);
+
+    write_info = _write_info(VK_FORMAT_BC7_UNORM_BLOCK, 8, 8, 1, 1);
+    write_info.format = VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+    TEST_CHECK(Ktx2Image::save("test_invalid.ktx2", &write_info) == FAIL);
+
+    // a 4x4 image has 3 levels at most.
+    write_info = _write_info(VK_FORMAT_BC7_UNORM_BLOCK, 4, 4, 1, 4);
+    TEST_CHECK(Ktx2Image::save("test_invalid.ktx2", &write_info) == FAIL);
+
+    TEST_CHECK(Ktx2Image::load("test_missing.ktx2") == NULL);
+
+    // a truncated file and a file without the identifier are rejected.
+    write_info = _write_info(VK_FORMAT_BC7_UNORM_BLOCK, 8, 8, 1, 1);
+    TEST_CHECK(Ktx2Image::save("test_truncated.ktx2", &write_info) == OK);
+
+    IOMapping mapping;
+    TEST_CHECK(io_map_file("test_truncated.ktx2", &mapping) == OK);
+    std::vector<char> blob(mapping.data, mapping.data + mapping.size);
+    io_unmap_file(&mapping);
+
+    TEST_CHECK(io_write_file("test_truncated.ktx2", blob.data(), blob.size() - 1) == OK);
+    TEST_CHECK(Ktx2Image::load("test_truncated.ktx2") == NULL);
+
+    char identifier = blob[1];
+    blob[1] = 'X';
+    TEST_CHECK(io_write_file("test_truncated.ktx2", blob.data(), blob.size()) == OK);
+    TEST_CHECK(Ktx2Image::load("test_truncated.ktx2") == NULL);
+    blob[1] = identifier;
+
+    // more levels than the 8x8 extent allows.
+    Ktx2Image::Header *header = (Ktx2Image::Header *) blob.data();
+    header->level_count = 5;
+    TEST_CHECK(io_write_file("test_truncated.ktx2", blob.data(), blob.size()) == OK);
+    TEST_CHECK(Ktx2Image::load("test_truncated.ktx2") == NULL);
+    header->level_count = 1;
+
+    // a level range that wraps around.
+    Ktx2Image::Level *level = (Ktx2Image::Level *) (blob.data() + sizeof(Ktx2Image::Header));
+    level->byte_offset = UINT64_MAX - 15;
+    level->byte_length = 64;
+    TEST_CHECK(io_write_file("test_truncated.ktx2", blob.data(), blob.size()) == OK);
+    TEST_CHECK(Ktx2Image::load("test_truncated.ktx2") == NULL);
+}
+
+int main()
+{
+    test_round_trip();
+    test_invalid();
+    return 0;
+}
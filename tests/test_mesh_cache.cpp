@@ -0,0 +1,168 @@
+/* ======================================================================== */
+/* test_mesh_cache.cpp                                                      */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, e1ither express or implied */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "test.h"
+#include "modules/mesh_cache.h"
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string.h>
+
+// enough triangles for several meshlets and a coarser lod.
+#define TEST_MESH_GRID_SIZE 32
+
+static void _write_grid(const char *path, int n)
+{
+    std::string text;
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++)
+            text += "v " + std::to_string(c) + " " + std::to_string(r) + " 0\n";
+    }
+
+    for (int r = 1; r < n; r++) {
+        for (int c = 0; c + 1 < n; c++) {
+            int a = (r - 1) * n + c + 1;
+            text += "f " + std::to_string(a) + " " + std::to_string(a + 1) + " " +
+                    std::to_string(a + n + 1) + " " + std::to_string(a + n) + "\n";
+        }
+    }
+
+    TEST_CHECK(io_write_file(path, text.data(), text.size()) == OK);
+}
+
+static std::vector<std::array<uint32_t, 3>> _sorted_triangles(std::vector<std::array<uint32_t, 3>> triangles)
+{
+    for (auto &triangle: triangles)
+        std::sort(triangle.begin(), triangle.end());
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+static void _check_cache(const MeshCache *cache, const ObjLoader *loader)
+{
+    const MeshCache::Header *header = cache->get_header();
+    TEST_CHECK(header->magic == MESH_CACHE_MAGIC);
+    TEST_CHECK(header->version == MESH_CACHE_VERSION);
+    TEST_CHECK(header->vertex_stride == sizeof(ObjLoader::Vertex));
+
+    uint64_t offsets[] = { header->vertex_offset, header->index_offset, header->lod_offset,
+                           header->meshlet_offset, header->meshlet_vertex_offset, header->meshlet_triangle_offset };
+    for (uint64_t offset: offsets)
+        TEST_CHECK(offset % MESH_CACHE_ALIGNMENT == 0);
+
+    // lod 0 is the imported mesh as is.
+    const auto &vertices = loader->get_vertices();
+    const auto &indices = loader->get_indices();
+    TEST_CHECK(cache->get_vertex_count() == vertices.size());
+    TEST_CHECK(cache->get_index_count(0) == indices.size());
+    TEST_CHECK(!memcmp(cache->get_vertices(), vertices.data(), cache->get_vertex_buffer_size()));
+    TEST_CHECK(!memcmp(cache->get_indices(0), indices.data(), cache->get_index_buffer_size(0)));
+
+    TEST_CHECK(cache->get_lod_count() >= 1 && cache->get_lod_count() <= MESH_CACHE_MAX_LODS);
+    for (uint32_t lod = 1; lod < cache->get_lod_count(); lod++) {
+        TEST_CHECK(cache->get_index_count(lod) % 3 == 0);
+        TEST_CHECK(cache->get_index_count(lod) <= cache->get_index_count(lod - 1));
+        for (uint32_t i = 0; i < cache->get_index_count(lod); i++)
+            TEST_CHECK(cache->get_indices(lod)[i] < cache->get_vertex_count());
+    }
+
+    const MeshCache::Bounds &bounds = cache->get_bounds();
+    TEST_CHECK(bounds.min[0] == 0.0f && bounds.min[1] == 0.0f && bounds.min[2] == 0.0f);
+    TEST_CHECK(bounds.max[0] == TEST_MESH_GRID_SIZE - 1 && bounds.max[1] == TEST_MESH_GRID_SIZE - 1 && bounds.max[2] == 0.0f);
+
+    // the meshlets hold every triangle of lod 0 exactly once.
+    std::vector<std::array<uint32_t, 3>> expected, meshlet_triangles;
+    for (size_t i = 0; i < indices.size(); i += 3)
+        expected.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+
+    TEST_CHECK(cache->get_meshlet_count() > 1);
+    for (uint32_t i = 0; i < cache->get_meshlet_count(); i++) {
+        const MeshCache::Meshlet &meshlet = cache->get_meshlets()[i];
+        TEST_CHECK(meshlet.vertex_count <= MESH_CACHE_MESHLET_MAX_VERTICES);
+        TEST_CHECK(meshlet.triangle_count <= MESH_CACHE_MESHLET_MAX_TRIANGLES);
+
+        const uint32_t *meshlet_vertices = cache->get_meshlet_vertices() + meshlet.vertex_offset;
+        const uint8_t *triangles = cache->get_meshlet_triangles() + meshlet.triangle_offset;
+        for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+            std::array<uint32_t, 3> triangle;
+            for (uint32_t k = 0; k < 3; k++) {
+                TEST_CHECK(triangles[t * 3 + k] < meshlet.vertex_count);
+                triangle[k] = meshlet_vertices[triangles[t * 3 + k]];
+            }
+            meshlet_triangles.push_back(triangle);
+        }
+    }
+
+    TEST_CHECK(_sorted_triangles(meshlet_triangles) == _sorted_triangles(expected));
+}
+
+static void test_round_trip()
+{
+    remove("test_mesh_grid.obj" MESH_CACHE_EXTENSION);
+    _write_grid("test_mesh_grid.obj", TEST_MESH_GRID_SIZE);
+
+    ObjLoader *loader = ObjLoader::load("test_mesh_grid.obj");
+    TEST_CHECK(loader != NULL);
+
+    // the first load imports the model and writes the cache, the second maps it.
+    for (int pass = 0; pass < 2; pass++) {
+        MeshCache *cache = MeshCache::load("test_mesh_grid.obj");
+        TEST_CHECK(cache != NULL);
+        _check_cache(cache, loader);
+        MeshCache::destroy(cache);
+    }
+
+    ObjLoader::destroy(loader);
+
+    IOMapping mapping;
+    TEST_CHECK(io_map_file("test_mesh_grid.obj" MESH_CACHE_EXTENSION, &mapping) == OK);
+    TEST_CHECK(((const MeshCache::Header *) mapping.data)->file_size == mapping.size);
+    io_unmap_file(&mapping);
+}
+
+static void test_stale_cache()
+{
+    _write_grid("test_mesh_stale.obj", 4);
+    MeshCache *cache = MeshCache::load("test_mesh_stale.obj");
+    TEST_CHECK(cache != NULL && cache->get_vertex_count() == 16);
+    MeshCache::destroy(cache);
+
+    // a changed source rebuilds the cache.
+    _write_grid("test_mesh_stale.obj", 5);
+    cache = MeshCache::load("test_mesh_stale.obj");
+    TEST_CHECK(cache != NULL && cache->get_vertex_count() == 25);
+    MeshCache::destroy(cache);
+}
+
+static void test_missing_file()
+{
+    remove("test_mesh_missing.obj" MESH_CACHE_EXTENSION);
+    TEST_CHECK(MeshCache::load("test_mesh_missing.obj") == NULL);
+}
+
+int main()
+{
+    test_round_trip();
+    test_stale_cache();
+    test_missing_file();
+    return 0;
+}
@@ -0,0 +1,131 @@
+/* ======================================================================== */
+/* test_obj.cpp                                                             */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, e1ither express or implied */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "test.h"
+#include "modules/obj.h"
+#include <bright/ioutils.h>
+#include <string>
+
+// large enough to be split into several chunks parsed in parallel.
+#define TEST_OBJ_GRID_SIZE 400
+
+static void _write_text(const char *path, const std::string &text)
+{
+    TEST_CHECK(io_write_file(path, text.data(), text.size()) == OK);
+}
+
+static void _check_quad(const char *path)
+{
+    ObjLoader *loader = ObjLoader::load(path);
+    TEST_CHECK(loader != NULL);
+
+    // the quad is a fan of two triangles sharing four vertices.
+    const auto &vertices = loader->get_vertices();
+    const auto &indices = loader->get_indices();
+    TEST_CHECK(vertices.size() == 4);
+    TEST_CHECK(indices.size() == 6);
+
+    uint32_t expected[] = { 0, 1, 2, 0, 2, 3 };
+    for (uint32_t i = 0; i < 6; i++)
+        TEST_CHECK(indices[i] == expected[i]);
+
+    TEST_CHECK(vertices[2].position == vec3(1.0f, 1.0f, 0.0f));
+    TEST_CHECK(vertices[2].texcoord == vec2(1.0f, 1.0f));
+    TEST_CHECK(vertices[2].normal == vec3(0.0f, 0.0f, 1.0f));
+
+    ObjLoader::destroy(loader);
+}
+
+static void test_quad()
+{
+    _write_text("test_quad.obj",
+                "# quad\n"
+                "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+                "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+                "vn 0 0 1\n"
+                "f 1/1/1 2/2/1 3/3/1 4/4/1\n");
+    _check_quad("test_quad.obj");
+
+    // the same quad through relative indices.
+    _write_text("test_quad_relative.obj",
+                "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+                "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+                "vn 0 0 1\n"
+                "f -4/-4/-1 -3/-3/-1 -2/-2/-1 -1/-1/-1\n");
+    _check_quad("test_quad_relative.obj");
+}
+
+static void test_grid()
+{
+    const int n = TEST_OBJ_GRID_SIZE;
+
+    // rows of vertices, each followed by the faces to the row above it through
+    // relative indices, so faces reference vertices of the previous chunk.
+    std::string text;
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++)
+            text += "v " + std::to_string(c) + " " + std::to_string(r) + " 0\n";
+        if (r == 0)
+            continue;
+        for (int c = 0; c + 1 < n; c++) {
+            text += "f " + std::to_string(c - 2 * n) + " " + std::to_string(c + 1 - 2 * n) + " " +
+                    std::to_string(c + 1 - n) + " " + std::to_string(c - n) + "\n";
+        }
+    }
+    _write_text("test_grid.obj", text);
+
+    ObjLoader *loader = ObjLoader::load("test_grid.obj");
+    TEST_CHECK(loader != NULL);
+
+    const auto &vertices = loader->get_vertices();
+    const auto &indices = loader->get_indices();
+    TEST_CHECK(vertices.size() == (size_t) n * n);
+    TEST_CHECK(indices.size() == (size_t) 6 * (n - 1) * (n - 1));
+
+    size_t i = 0;
+    for (int r = 1; r < n; r++) {
+        for (int c = 0; c + 1 < n; c++) {
+            vec3 a((float) c, (float) (r - 1), 0.0f);
+            vec3 b((float) (c + 1), (float) (r - 1), 0.0f);
+            vec3 d((float) (c + 1), (float) r, 0.0f);
+            vec3 e((float) c, (float) r, 0.0f);
+            vec3 expected[] = { a, b, d, a, d, e };
+            for (const vec3 &position: expected)
+                TEST_CHECK(vertices[indices[i++]].position == position);
+        }
+    }
+
+    ObjLoader::destroy(loader);
+}
+
+static void test_missing_file()
+{
+    TEST_CHECK(ObjLoader::load("test_missing.obj") == NULL);
+}
+
+int main()
+{
+    test_quad();
+    test_grid();
+    test_missing_file();
+    return 0;
+}
@@ -0,0 +1,162 @@
+/* ======================================================================== */
+/* test_resource_pool.cpp                                                   */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, e1ither express or implied */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "test.h"
+#include "drivers/resource_pool.h"
+#include <algorithm>
+#include <thread>
+
+#define TEST_POOL_THREADS 4
+#define TEST_POOL_OBJECTS_PER_THREAD 1000
+
+struct _Object {
+    uint32_t value = 7;
+    bool flag = false;
+};
+
+typedef ResourceHandle<_Object> _ObjectHandle;
+
+static void test_handles()
+{
+    ResourcePool<_Object> pool;
+
+    _ObjectHandle null_handle;
+    TEST_CHECK(null_handle.is_null());
+    TEST_CHECK(!pool.is_valid(null_handle));
+
+    _ObjectHandle handle;
+    _Object *object = pool.allocate(&handle);
+    TEST_CHECK(!handle.is_null());
+    TEST_CHECK(handle.get_generation() == 1);
+    TEST_CHECK(pool.is_valid(handle));
+    TEST_CHECK(pool.get(handle) == object);
+    TEST_CHECK(pool.get_alive_count() == 1);
+
+    object->value = 42;
+    object->flag = true;
+    pool.free(handle);
+    TEST_CHECK(!pool.is_valid(handle));
+    TEST_CHECK(pool.get_alive_count() == 0);
+
+    // the slot comes back with the next generation and a reset object, the
+    // stale handle stays invalid.
+    _ObjectHandle reused;
+    _Object *reused_object = pool.allocate(&reused);
+    TEST_CHECK(reused_object == object);
+    TEST_CHECK(reused.get_index() == handle.get_index());
+    TEST_CHECK(reused.get_generation() == handle.get_generation() + 1);
+    TEST_CHECK(reused != handle);
+    TEST_CHECK(!pool.is_valid(handle));
+    TEST_CHECK(reused_object->value == 7 && !reused_object->flag);
+}
+
+static void test_generation_wrap()
+{
+    ResourcePool<_Object> pool;
+
+    // generation 0 marks the null handle, the slot goes from the last generation
+    // back to 1.
+    _ObjectHandle handle;
+    for (uint32_t i = 0; i < RESOURCE_HANDLE_GENERATION_MASK; i++) {
+        pool.allocate(&handle);
+        TEST_CHECK(handle.get_generation() != 0);
+        pool.free(handle);
+    }
+
+    pool.allocate(&handle);
+    TEST_CHECK(handle.get_generation() == 1);
+}
+
+static void test_stable_pointers()
+{
+    ResourcePool<_Object> pool;
+
+    // several chunks, earlier objects never move.
+    std::vector<std::pair<_ObjectHandle, _Object *>> objects;
+    for (uint32_t i = 0; i < RESOURCE_POOL_CHUNK_SIZE * 3 + 1; i++) {
+        _ObjectHandle handle;
+        _Object *object = pool.allocate(&handle);
+        object->value = i;
+        objects.push_back({ handle, object });
+    }
+
+    for (uint32_t i = 0; i < (uint32_t) objects.size(); i++) {
+        TEST_CHECK(pool.get(objects[i].first) == objects[i].second);
+        TEST_CHECK(objects[i].second->value == i);
+    }
+
+    // every other object freed, for_each visits the rest in slot order.
+    for (uint32_t i = 0; i < (uint32_t) objects.size(); i += 2)
+        pool.free(objects[i].first);
+
+    std::vector<uint32_t> visited;
+    pool.for_each([&](_Object *object) { visited.push_back(object->value); });
+    TEST_CHECK(visited.size() == pool.get_alive_count());
+    TEST_CHECK(visited.size() == objects.size() / 2);
+    for (uint32_t i = 0; i < (uint32_t) visited.size(); i++)
+        TEST_CHECK(visited[i] == i * 2 + 1);
+}
+
+static void test_threads()
+{
+    ResourcePool<_Object> pool;
+    std::vector<_ObjectHandle> handles[TEST_POOL_THREADS];
+
+    // allocations and frees from several threads never hand out a live slot twice.
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < TEST_POOL_THREADS; t++) {
+        threads.emplace_back([&pool, &handles, t] {
+            for (uint32_t i = 0; i < TEST_POOL_OBJECTS_PER_THREAD; i++) {
+                _ObjectHandle handle;
+                pool.allocate(&handle)->value = t;
+                if (i % 3 == 0)
+                    pool.free(handle);
+                else
+                    handles[t].push_back(handle);
+            }
+        });
+    }
+
+    for (auto &thread: threads)
+        thread.join();
+
+    std::vector<uint32_t> indices;
+    for (uint32_t t = 0; t < TEST_POOL_THREADS; t++) {
+        for (_ObjectHandle handle: handles[t]) {
+            TEST_CHECK(pool.get(handle)->value == t);
+            indices.push_back(handle.get_index());
+        }
+    }
+
+    std::sort(indices.begin(), indices.end());
+    TEST_CHECK(std::adjacent_find(indices.begin(), indices.end()) == indices.end());
+    TEST_CHECK(pool.get_alive_count() == indices.size());
+}
+
+int main()
+{
+    test_handles();
+    test_generation_wrap();
+    test_stable_pointers();
+    test_threads();
+    return 0;
+}
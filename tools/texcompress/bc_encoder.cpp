@@ -0,0 +1,482 @@
+/* ======================================================================== */
+/* bc_encoder.cpp                                                           */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "bc_encoder.h"
+#include "modules/hdr.h"
+#include <algorithm>
+#include <cmath>
+#include <float.h>
+#include <string.h>
+
+#define BLOCK_TEXELS 16
+
+// interpolation weights of 4 bit indices, bc6h and bc7.
+static const int weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct _BitWriter {
+    uint8_t *dst;
+    int pos = 0;
+
+    void write(uint32_t value, int bits)
+      {
+        for (int i = 0; i < bits; i++, pos++) {
+            if ((value >> i) & 1)
+                dst[pos >> 3] |= (uint8_t) (1 << (pos & 7));
+        }
+      }
+};
+
+// least squares line through the points by power iteration on the covariance.
+// the axis is zero for a solid block.
+static void _principal_axis(const float (*points)[4], int channels, float *mean, float *axis)
+{
+    float lo[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[4] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for (int c = 0; c < 4; c++)
+        mean[c] = axis[c] = 0.0f;
+
+    for (int i = 0; i < BLOCK_TEXELS; i++) {
+        for (int c = 0; c < channels; c++) {
+            mean[c] += points[i][c];
+            lo[c] = std::min(lo[c], points[i][c]);
+            hi[c] = std::max(hi[c], points[i][c]);
+        }
+    }
+
+    for (int c = 0; c < channels; c++)
+        mean[c] /= BLOCK_TEXELS;
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < BLOCK_TEXELS; i++) {
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++)
+                covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+        }
+    }
+
+    float v[4] = {};
+    for (int c = 0; c < channels; c++)
+        v[c] = hi[c] - lo[c];
+
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        float length = 0.0f;
+
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++)
+                next[a] += covariance[a][b] * v[b];
+            length += next[a] * next[a];
+        }
+
+        if (length < 1e-12f)
+            return;
+
+        length = 1.0f / sqrtf(length);
+        for (int c = 0; c < channels; c++)
+            v[c] = next[c] * length;
+    }
+
+    for (int c = 0; c < channels; c++)
+        axis[c] = v[c];
+}
+
+// end points on the principal axis, pulled in by 1 / inset of the range.
+static void _axis_end_points(const float (*points)[4], int channels, float inset, float *p_lo, float *p_hi)
+{
+    float mean[4], axis[4];
+    _principal_axis(points, channels, mean, axis);
+
+    float t_lo = FLT_MAX, t_hi = -FLT_MAX;
+    for (int i = 0; i < BLOCK_TEXELS; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++)
+            t += (points[i][c] - mean[c]) * axis[c];
+        t_lo = std::min(t_lo, t);
+        t_hi = std::max(t_hi, t);
+    }
+
+    float pull = (t_hi - t_lo) / inset;
+    t_lo += pull;
+    t_hi -= pull;
+
+    for (int c = 0; c < channels; c++) {
+        p_lo[c] = mean[c] + axis[c] * t_lo;
+        p_hi[c] = mean[c] + axis[c] * t_hi;
+    }
+}
+
+static void _load_points(const uint8_t *rgba, float (*points)[4])
+{
+    for (int i = 0; i < BLOCK_TEXELS; i++) {
+        for (int c = 0; c < 4; c++)
+            points[i][c] = rgba[i * 4 + c];
+    }
+}
+
+/* bc1 */
+
+static uint16_t _pack565(const float *color)
+{
+    int r = std::clamp((int) lroundf(color[0] * 31.0f / 255.0f), 0, 31);
+    int g = std::clamp((int) lroundf(color[1] * 63.0f / 255.0f), 0, 63);
+    int b = std::clamp((int) lroundf(color[2] * 31.0f / 255.0f), 0, 31);
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static void _unpack565(uint16_t value, int *color)
+{
+    int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// four color mode indices, returns the squared error.
+static int _bc1_indices(const uint8_t *rgba, uint16_t c0, uint16_t c1, uint32_t *p_indices)
+{
+    int palette[4][3];
+    _unpack565(c0, palette[0]);
+    _unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    int error = 0;
+    uint32_t indices = 0;
+
+    for (int i = 0; i < BLOCK_TEXELS; i++) {
+        int best = 0, best_error = INT32_MAX;
+        for (int p = 0; p < 4; p++) {
+            int dr = rgba[i * 4 + 0] - palette[p][0];
+            int dg = rgba[i * 4 + 1] - palette[p][1];
+            int db = rgba[i * 4 + 2] - palette[p][2];
+            int e = dr * dr + dg * dg + db * db;
+            if (e < best_error) {
+                best = p;
+                best_error = e;
+            }
+        }
+        indices |= (uint32_t) best << (i * 2);
+        error += best_error;
+    }
+
+    *p_indices = indices;
+    return error;
+}
+
+static int _bc1_try(const uint8_t *rgba, const float *lo, const float *hi, uint16_t *p_c0, uint16_t *p_c1, uint32_t *p_indices)
+{
+    uint16_t c0 = _pack565(hi);
+    uint16_t c1 = _pack565(lo);
+
+    // c0 > c1 selects the four color mode, equal end points decode the same in both modes.
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    *p_c0 = c0;
+    *p_c1 = c1;
+
+    if (c0 == c1) {
+        int palette[3], error = 0;
+        _unpack565(c0, palette);
+        for (int i = 0; i < BLOCK_TEXELS; i++) {
+            for (int c = 0; c < 3; c++)
+                error += (rgba[i * 4 + c] - palette[c]) * (rgba[i * 4 + c] - palette[c]);
+        }
+        *p_indices = 0;
+        return error;
+    }
+
+    return _bc1_indices(rgba, c0, c1, p_indices);
+}
+
+void bc1_encode_block(const uint8_t *rgba, uint8_t *dst)
+{
+    float points[BLOCK_TEXELS][4];
+    _load_points(rgba, points);
+
+    float lo[4], hi[4];
+    _axis_end_points(points, 3, 16.0f, lo, hi);
+
+    uint16_t c0, c1;
+    uint32_t indices;
+    int error = _bc1_try(rgba, lo, hi, &c0, &c1, &indices);
+
+    // one least squares refit of the end points to the chosen indices.
+    static const float t_of_index[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {}, bx[3] = {};
+
+    for (int i = 0; i < BLOCK_TEXELS; i++) {
+        float t = t_of_index[(indices >> (i * 2)) & 3];
+        float s = 1.0f - t;
+        aa += s * s;
+        ab += s * t;
+        bb += t * t;
+        for (int c = 0; c < 3; c++) {
+            ax[c] += s * points[i][c];
+            bx[c] += t * points[i][c];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) > 1e-6f) {
+        float refit_hi[3], refit_lo[3];
+        for (int c = 0; c < 3; c++) {
+            refit_hi[c] = (bb * ax[c] - ab * bx[c]) / det;
+            refit_lo[c] = (aa * bx[c] - ab * ax[c]) / det;
+        }
+
+        uint16_t refit_c0, refit_c1;
+        uint32_t refit_indices;
+        int refit_error = _bc1_try(rgba, refit_lo, refit_hi, &refit_c0, &refit_c1, &refit_indices);
+        if (refit_error < error) {
+            c0 = refit_c0;
+            c1 = refit_c1;
+            indices = refit_indices;
+        }
+    }
+
+    memcpy(dst + 0, &c0, 2);
+    memcpy(dst + 2, &c1, 2);
+    memcpy(dst + 4, &indices, 4);
+}
+
+/* bc4 / bc5 / bc3 alpha */
+
+void bc4_encode_block(const uint8_t *rgba, int channel, uint8_t *dst)
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < BLOCK_TEXELS; i++) {
+        lo = std::min(lo, (int) rgba[i * 4 + channel]);
+        hi = std::max(hi, (int) rgba[i * 4 + channel]);
+    }
+
+    dst[0] = (uint8_t) hi;
+    dst[1] = (uint8_t) lo;
+
+    // a0 > a1 selects eight interpolated values, a solid block keeps index 0.
+    uint64_t indices = 0;
+    if (hi > lo) {
+        int palette[8] = { hi, lo };
+        for (int p = 2; p < 8; p++)
+            palette[p] = ((8 - p) * hi + (p - 1) * lo + 3) / 7;
+
+        for (int i = 0; i < BLOCK_TEXELS; i++) {
+            int value = rgba[i * 4 + channel];
+            int best = 0, best_error = INT32_MAX;
+            for (int p = 0; p < 8; p++) {
+                int e = abs(value - palette[p]);
+                if (e < best_error) {
+                    best = p;
+                    best_error = e;
+                }
+            }
+            indices |= (uint64_t) best << (i * 3);
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+        dst[2 + i] = (uint8_t) (indices >> (i * 8));
+}
+
+void bc5_encode_block(const uint8_t *rgba, uint8_t *dst)
+{
+    bc4_encode_block(rgba, 0, dst);
+    bc4_encode_block(rgba, 1, dst + 8);
+}
+
+void bc3_encode_block(const uint8_t *rgba, uint8_t *dst)
+{
+    bc4_encode_block(rgba, 3, dst);
+    bc1_encode_block(rgba, dst + 8);
+}
+
+/* bc6h, mode 11: one region, 10 bit end points, 4 bit indices. */
+
+// inverse of the unsigned finish_unquantize, half bits to the interpolation domain.
+static V_FORCEINLINE float _bc6h_unfinish(uint16_t half)
+{
+    return half * (64.0f / 31.0f);
+}
+
+static V_FORCEINLINE int _bc6h_unquantize(int value)
+{
+    if (value == 0)
+        return 0;
+    if (value == 1023)
+        return 0xFFFF;
+    return ((value << 16) + 0x8000) >> 10;
+}
+
+static V_FORCEINLINE int _bc6h_quantize(float value)
+{
+    return std::clamp((int) lroundf(value / 64.0f - 0.5f), 0, 1023);
+}
+
+void bc6h_encode_block(const float *rgba, uint8_t *dst)
+{
+    float clamped[BLOCK_TEXELS * 4];
+    for (int i = 0; i < BLOCK_TEXELS * 4; i++)
+        clamped[i] = std::min(std::max(0.0f, rgba[i]), 65504.0f);
+
+    uint16_t halfs[BLOCK_TEXELS * 4];
+    hdr_pack_rgba16f(clamped, halfs, BLOCK_TEXELS);
+
+    float points[BLOCK_TEXELS][4] = {};
+    for (int i = 0; i < BLOCK_TEXELS; i++) {
+        for (int c = 0; c < 3; c++)
+            points[i][c] = _bc6h_unfinish(halfs[i * 4 + c]);
+    }
+
+    float lo[4], hi[4];
+    _axis_end_points(points, 3, 32.0f, lo, hi);
+
+    int endpoints[2][3];
+    int palette[16][3];
+    for (int c = 0; c < 3; c++) {
+        endpoints[0][c] = _bc6h_quantize(lo[c]);
+        endpoints[1][c] = _bc6h_quantize(hi[c]);
+
+        int e0 = _bc6h_unquantize(endpoints[0][c]);
+        int e1 = _bc6h_unquantize(endpoints[1][c]);
+        for (int p = 0; p < 16; p++)
+            palette[p][c] = ((((64 - weights4[p]) * e0 + weights4[p] * e1 + 32) >> 6) * 31) >> 6;
+    }
+
+    // errors are measured on the half bits, roughly logarithmic like the eye.
+    int indices[BLOCK_TEXELS];
+    for (int i = 0; i < BLOCK_TEXELS; i++) {
+        int64_t best_error = INT64_MAX;
+        for (int p = 0; p < 16; p++) {
+            int64_t e = 0;
+            for (int c = 0; c < 3; c++) {
+                int64_t d = (int64_t) halfs[i * 4 + c] - palette[p][c];
+                e += d * d;
+            }
+            if (e < best_error) {
+                indices[i] = p;
+                best_error = e;
+            }
+        }
+    }
+
+    // the anchor index is stored with 3 bits, its top bit has to be zero.
+    if (indices[0] & 8) {
+        std::swap(endpoints[0], endpoints[1]);
+        for (int i = 0; i < BLOCK_TEXELS; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    memset(dst, 0, 16);
+    _BitWriter writer = { dst };
+    writer.write(0x03, 5);
+    for (int e = 0; e < 2; e++) {
+        for (int c = 0; c < 3; c++)
+            writer.write(endpoints[e][c], 10);
+    }
+
+    writer.write(indices[0], 3);
+    for (int i = 1; i < BLOCK_TEXELS; i++)
+        writer.write(indices[i], 4);
+}
+
+/* bc7, mode 6: one subset, rgba 7 bit end points with a p bit each, 4 bit indices. */
+
+void bc7_encode_block(const uint8_t *rgba, uint8_t *dst)
+{
+    float points[BLOCK_TEXELS][4];
+    _load_points(rgba, points);
+
+    float lo[4], hi[4];
+    _axis_end_points(points, 4, 32.0f, lo, hi);
+
+    int best_error = INT32_MAX;
+    int best_endpoints[2][4] = {}, best_pbits[2] = {};
+    int best_indices[BLOCK_TEXELS];
+
+    // the p bit is the shared low bit of every channel, try all four pairs.
+    for (int pbits = 0; pbits < 4; pbits++) {
+        int p[2] = { pbits & 1, pbits >> 1 };
+        int endpoints[2][4];
+        int palette[16][4];
+
+        for (int c = 0; c < 4; c++) {
+            endpoints[0][c] = std::clamp((int) lroundf((lo[c] - p[0]) * 0.5f), 0, 127);
+            endpoints[1][c] = std::clamp((int) lroundf((hi[c] - p[1]) * 0.5f), 0, 127);
+
+            int e0 = (endpoints[0][c] << 1) | p[0];
+            int e1 = (endpoints[1][c] << 1) | p[1];
+            for (int w = 0; w < 16; w++)
+                palette[w][c] = ((64 - weights4[w]) * e0 + weights4[w] * e1 + 32) >> 6;
+        }
+
+        int error = 0;
+        int indices[BLOCK_TEXELS];
+        for (int i = 0; i < BLOCK_TEXELS && error < best_error; i++) {
+            int texel_error = INT32_MAX;
+            for (int w = 0; w < 16; w++) {
+                int e = 0;
+                for (int c = 0; c < 4; c++) {
+                    int d = rgba[i * 4 + c] - palette[w][c];
+                    e += d * d;
+                }
+                if (e < texel_error) {
+                    indices[i] = w;
+                    texel_error = e;
+                }
+            }
+            error += texel_error;
+        }
+
+        if (error < best_error) {
+            best_error = error;
+            memcpy(best_endpoints, endpoints, sizeof(endpoints));
+            memcpy(best_indices, indices, sizeof(indices));
+            best_pbits[0] = p[0];
+            best_pbits[1] = p[1];
+        }
+    }
+
+    if (best_indices[0] & 8) {
+        std::swap(best_endpoints[0], best_endpoints[1]);
+        std::swap(best_pbits[0], best_pbits[1]);
+        for (int i = 0; i < BLOCK_TEXELS; i++)
+            best_indices[i] = 15 - best_indices[i];
+    }
+
+    memset(dst, 0, 16);
+    _BitWriter writer = { dst };
+    writer.write(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.write(best_endpoints[0][c], 7);
+        writer.write(best_endpoints[1][c], 7);
+    }
+
+    writer.write(best_pbits[0], 1);
+    writer.write(best_pbits[1], 1);
+
+    writer.write(best_indices[0], 3);
+    for (int i = 1; i < BLOCK_TEXELS; i++)
+        writer.write(best_indices[i], 4);
+}
@@ -0,0 +1,48 @@
+/* ======================================================================== */
+/* bc_encoder.h                                                             */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _BC_ENCODER_H_
+#define _BC_ENCODER_H_
+
+#include <stdint.h>
+
+/*
+ * cpu block compression for the offline texture compressor. every function
+ * takes one 4x4 block of 16 texels in row order and writes a single block,
+ * the encoders aim at fast and predictable results, not the best quality:
+ * bc6h only uses mode 11 and bc7 only uses mode 6 (one subset, 4 bit indices).
+ */
+
+// rgba8 texels, alpha ignored. 8 bytes.
+void bc1_encode_block(const uint8_t *rgba, uint8_t *dst);
+// rgba8 texels. 16 bytes.
+void bc3_encode_block(const uint8_t *rgba, uint8_t *dst);
+// one channel of rgba8 texels, channel in [0, 4). 8 bytes.
+void bc4_encode_block(const uint8_t *rgba, int channel, uint8_t *dst);
+// red and green of rgba8 texels, e.g. tangent space normals. 16 bytes.
+void bc5_encode_block(const uint8_t *rgba, uint8_t *dst);
+// rgba32f texels, alpha ignored and negative values clamped to zero. 16 bytes.
+void bc6h_encode_block(const float *rgba, uint8_t *dst);
+// rgba8 texels. 16 bytes.
+void bc7_encode_block(const uint8_t *rgba, uint8_t *dst);
+
+#endif /* _BC_ENCODER_H_ */
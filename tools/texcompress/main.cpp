@@ -0,0 +1,303 @@
+/* ======================================================================== */
+/* main.cpp                                                                 */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "bc_encoder.h"
+#include "modules/ktx2.h"
+#include "modules/hdr.h"
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <thread>
+
+/*
+ * offline texture compressor, png/jpg/tga/hdr sources to ktx2 with a box
+ * filtered mip chain. filtering runs in linear float, srgb sources are
+ * decoded before and encoded after.
+ *
+ *   texcompress <input> <output.ktx2> [-f bc1|bc3|bc4|bc5|bc6h|bc7|rgba8|rgba16f] [-srgb] [-nomips]
+ */
+
+enum TargetFormat {
+    TARGET_FORMAT_BC1,
+    TARGET_FORMAT_BC3,
+    TARGET_FORMAT_BC4,
+    TARGET_FORMAT_BC5,
+    TARGET_FORMAT_BC6H,
+    TARGET_FORMAT_BC7,
+    TARGET_FORMAT_RGBA8,
+    TARGET_FORMAT_RGBA16F,
+};
+
+struct Target {
+    const char *name;
+    VkFormat format;
+    VkFormat srgb_format; /* VK_FORMAT_UNDEFINED when there is none */
+    void (*encode)(const uint8_t *, uint8_t *);
+};
+
+static void _bc4_encode_red(const uint8_t *rgba, uint8_t *dst)
+{
+    bc4_encode_block(rgba, 0, dst);
+}
+
+static const Target targets[] = {
+    { "bc1", VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK, bc1_encode_block },
+    { "bc3", VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, bc3_encode_block },
+    { "bc4", VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_UNDEFINED, _bc4_encode_red },
+    { "bc5", VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_UNDEFINED, bc5_encode_block },
+    { "bc6h", VK_FORMAT_BC6H_UFLOAT_BLOCK, VK_FORMAT_UNDEFINED, NULL },
+    { "bc7", VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK, bc7_encode_block },
+    { "rgba8", VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB, NULL },
+    { "rgba16f", VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_UNDEFINED, NULL },
+};
+
+static float _srgb_to_linear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float _linear_to_srgb(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static void _downsample(const float *src, uint32_t width, uint32_t height, float *dst)
+{
+    uint32_t dst_width = std::max(width >> 1, 1u);
+    uint32_t dst_height = std::max(height >> 1, 1u);
+
+    for (uint32_t y = 0; y < dst_height; y++) {
+        const float *row0 = src + (size_t) std::min(y * 2, height - 1) * width * 4;
+        const float *row1 = src + (size_t) std::min(y * 2 + 1, height - 1) * width * 4;
+
+        for (uint32_t x = 0; x < dst_width; x++) {
+            uint32_t x0 = std::min(x * 2, width - 1) * 4;
+            uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+
+            float *texel = dst + ((size_t) y * dst_width + x) * 4;
+            for (int c = 0; c < 4; c++)
+                texel[c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+        }
+    }
+}
+
+// runs fn(row) for every row on all cores.
+template<typename Fn>
+static void _parallel_rows(uint32_t row_count, Fn fn)
+{
+    std::atomic<uint32_t> next_row = 0;
+    std::vector<std::thread> threads;
+    uint32_t thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (uint32_t i = 0; i < thread_count; i++) {
+        threads.emplace_back([&] {
+            for (uint32_t row = next_row++; row < row_count; row = next_row++)
+                fn(row);
+        });
+    }
+
+    for (auto &thread: threads)
+        thread.join();
+}
+
+static std::vector<char> _encode_level(const Target &target, bool srgb, const float *pixels, uint32_t width, uint32_t height)
+{
+    size_t texel_count = (size_t) width * height;
+
+    if (target.format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+        std::vector<char> level(texel_count * sizeof(uint16_t) * 4);
+        hdr_pack_rgba16f(pixels, (uint16_t *) level.data(), texel_count);
+        return level;
+    }
+
+    // every ldr target is encoded from 8 bit texels.
+    std::vector<uint8_t> texels;
+    if (target.format != VK_FORMAT_BC6H_UFLOAT_BLOCK) {
+        texels.resize(texel_count * 4);
+        for (size_t i = 0; i < texel_count * 4; i++) {
+            float value = std::clamp(pixels[i], 0.0f, 1.0f);
+            if (srgb && (i & 3) != 3)
+                value = _linear_to_srgb(value);
+            texels[i] = (uint8_t) lroundf(value * 255.0f);
+        }
+
+        if (target.format == VK_FORMAT_R8G8B8A8_UNORM)
+            return std::vector<char>(texels.begin(), texels.end());
+    }
+
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t blocks_y = (height + 3) / 4;
+    size_t block_size = (target.format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || target.format == VK_FORMAT_BC4_UNORM_BLOCK) ? 8 : 16;
+    std::vector<char> level(blocks_x * blocks_y * block_size);
+
+    // partial blocks at the right and bottom edge repeat the last texel.
+    _parallel_rows(blocks_y, [&](uint32_t by) {
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+            uint8_t *dst = (uint8_t *) level.data() + ((size_t) by * blocks_x + bx) * block_size;
+            uint8_t block[16 * 4];
+            float block_hdr[16 * 4];
+
+            for (uint32_t y = 0; y < 4; y++) {
+                for (uint32_t x = 0; x < 4; x++) {
+                    size_t src = ((size_t) std::min(by * 4 + y, height - 1) * width + std::min(bx * 4 + x, width - 1)) * 4;
+                    for (int c = 0; c < 4; c++) {
+                        if (target.encode)
+                            block[(y * 4 + x) * 4 + c] = texels[src + c];
+                        else
+                            block_hdr[(y * 4 + x) * 4 + c] = pixels[src + c];
+                    }
+                }
+            }
+
+            if (target.encode)
+                target.encode(block, dst);
+            else
+                bc6h_encode_block(block_hdr, dst);
+        }
+    });
+
+    return level;
+}
+
+static void _usage()
+{
+    fprintf(stderr, "usage: texcompress <input> <output.ktx2> [-f bc1|bc3|bc4|bc5|bc6h|bc7|rgba8|rgba16f] [-srgb] [-nomips]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        _usage();
+        return 1;
+    }
+
+    const char *input = argv[1];
+    const char *output = argv[2];
+    const char *format_name = NULL;
+    bool srgb = false;
+    bool mipmaps = true;
+
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            format_name = argv[++i];
+        } else if (strcmp(argv[i], "-srgb") == 0) {
+            srgb = true;
+        } else if (strcmp(argv[i], "-nomips") == 0) {
+            mipmaps = false;
+        } else {
+            _usage();
+            return 1;
+        }
+    }
+
+    bool hdr = stbi_is_hdr(input);
+    if (!format_name)
+        format_name = hdr ? "bc6h" : "bc7";
+
+    const Target *target = NULL;
+    for (const Target &candidate: targets) {
+        if (strcmp(candidate.name, format_name) == 0)
+            target = &candidate;
+    }
+
+    if (!target) {
+        fprintf(stderr, "texcompress: unknown format %s\n", format_name);
+        return 1;
+    }
+
+    if (srgb && target->srgb_format == VK_FORMAT_UNDEFINED) {
+        fprintf(stderr, "texcompress: %s has no srgb variant, writing linear data\n", target->name);
+        srgb = false;
+    }
+
+    int width, height, channels;
+    float *pixels = stbi_loadf(input, &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        fprintf(stderr, "texcompress: can not load %s: %s\n", input, stbi_failure_reason());
+        return 1;
+    }
+
+    // stb returns ldr sources gamma expanded with its own 2.2 curve, reload them exact.
+    if (!hdr) {
+        stbi_image_free(pixels);
+        stbi_uc *ldr = stbi_load(input, &width, &height, &channels, STBI_rgb_alpha);
+        if (!ldr) {
+            fprintf(stderr, "texcompress: can not load %s: %s\n", input, stbi_failure_reason());
+            return 1;
+        }
+
+        size_t count = (size_t) width * height * 4;
+        pixels = (float *) malloc(count * sizeof(float));
+        for (size_t i = 0; i < count; i++) {
+            float value = ldr[i] / 255.0f;
+            pixels[i] = srgb && (i & 3) != 3 ? _srgb_to_linear(value) : value;
+        }
+        stbi_image_free(ldr);
+    }
+
+    Ktx2Image::WriteInfo write_info = {};
+    write_info.format = srgb ? target->srgb_format : target->format;
+    write_info.width = (uint32_t) width;
+    write_info.height = (uint32_t) height;
+    write_info.layers = 1;
+    write_info.srgb = srgb;
+
+    uint32_t level_count = 1;
+    if (mipmaps) {
+        for (uint32_t size = std::max(write_info.width, write_info.height); size > 1; size >>= 1)
+            level_count++;
+    }
+
+    std::vector<float> scratch;
+    const float *level_pixels = pixels;
+
+    for (uint32_t i = 0; i < level_count; i++) {
+        uint32_t level_width = std::max(write_info.width >> i, 1u);
+        uint32_t level_height = std::max(write_info.height >> i, 1u);
+
+        write_info.levels.push_back(_encode_level(*target, srgb, level_pixels, level_width, level_height));
+
+        if (i + 1 < level_count) {
+            std::vector<float> next((size_t) std::max(level_width >> 1, 1u) * std::max(level_height >> 1, 1u) * 4);
+            _downsample(level_pixels, level_width, level_height, next.data());
+            scratch.swap(next);
+            level_pixels = scratch.data();
+        }
+    }
+
+    // both loaders allocate with malloc.
+    free(pixels);
+
+    if (Ktx2Image::save(output, &write_info) != OK) {
+        fprintf(stderr, "texcompress: can not write %s\n", output);
+        return 1;
+    }
+
+    size_t size = 0;
+    for (const auto &level: write_info.levels)
+        size += level.size();
+
+    printf("%s: %dx%d %s, %u levels, %zu bytes\n", output, width, height, target->name, level_count, size);
+    return 0;
+}
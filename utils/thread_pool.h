@@ -0,0 +1,116 @@
+/* ======================================================================== */
+/* thread_pool.h                                                            */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    explicit ThreadPool(uint32_t v_thread_count)
+      {
+        for (uint32_t i = 0; i < v_thread_count; i++)
+            threads.emplace_back([this] { _worker(); });
+      }
+
+    ~ThreadPool()
+      {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        cv.notify_all();
+        for (auto &thread: threads)
+            thread.join();
+      }
+
+    void push(std::function<void()> v_job)
+      {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobs.push_back(std::move(v_job));
+            pending_count++;
+        }
+
+        cv.notify_one();
+      }
+
+    // blocks until every pushed job has completed.
+    void wait_idle()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle_cv.wait(lock, [this] { return pending_count == 0; });
+      }
+
+    // worker count for background jobs, leave one core for the main thread.
+    static uint32_t default_thread_count()
+      {
+        uint32_t count = std::thread::hardware_concurrency();
+        return count > 1 ? count - 1 : 1;
+      }
+
+private:
+    void _worker()
+      {
+        for (;;) {
+            std::function<void()> job;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+                // drain the queue before stopping, so every pushed job completes.
+                if (jobs.empty())
+                    return;
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job();
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (--pending_count == 0)
+                    idle_cv.notify_all();
+            }
+        }
+      }
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable idle_cv;
+    uint32_t pending_count = 0;
+    bool stopping = false;
+};
+
+#endif /* _THREAD_POOL_H_ */